@@ -0,0 +1,59 @@
+import fs from "fs";
+
+const HEADER_SIZE = 12;
+
+/**
+ * Loader for page compressed SVO files (PageCoder in the voxelizer):
+ * <pageSize:32><totalNodes:64><pageOffset:64 for every page + end offset><pages>
+ * The pages are sent compressed, the client decodes them.
+ */
+export default class PageFileLoader{
+    private _file: Buffer;
+    private _pageSize: number;
+    private _totalNodes: number;
+    private _totalPages: number;
+
+    constructor(path: string){
+        this._file = fs.readFileSync(path);
+        this._pageSize = this._file.readUInt32BE(0);
+        this._totalNodes = Number(this._file.readBigUInt64BE(4));
+        this._totalPages = Math.ceil(this._totalNodes/this._pageSize);
+
+        console.log("Compressed pages of", this._pageSize, "nodes:", this._totalPages);
+    }
+
+    public pageSize(): number{
+        return this._pageSize;
+    }
+
+    public totalPages(): number{
+        return this._totalPages;
+    }
+
+    public fileSize(): number{
+        return this._file.length;
+    }
+
+    /**
+     * @param pagePointer: number of the page
+     * @returns the total nodes in the page, the last page can be smaller
+     */
+    public pageNodes(pagePointer: number): number{
+        return Math.min(this._pageSize, this._totalNodes - pagePointer*this._pageSize);
+    }
+
+    /**
+     * Get a compressed page from the file
+     * @param pagePointer position of the page
+     * @returns the compressed bytes of the page on position <pagePointer>
+     */
+    public loadCompressedPage(pagePointer: number): Buffer{
+        if (pagePointer < 0 || pagePointer >= this._totalPages){
+            throw new Error("Page out of range: " + pagePointer);
+        }
+        const begin = Number(this._file.readBigUInt64BE(HEADER_SIZE + 8*pagePointer));
+        const end = Number(this._file.readBigUInt64BE(HEADER_SIZE + 8*(pagePointer + 1)));
+        const dataStart = HEADER_SIZE + 8*(this._totalPages + 1);
+        return this._file.subarray(dataStart + begin, dataStart + end);
+    }
+}
@@ -1,22 +1,33 @@
 import SVOFileLoader from "./SVOFileLoader";
+import PageFileLoader from "./PageFileLoader";
 
 
 export default class Producer
 {
 
-    private _loader;
+    private _loader: SVOFileLoader | null = null;
+    private _pageLoader: PageFileLoader | null = null;
     private _pageSize;
 
 
-    public constructor(path: string, pageSize: number, optimizedSVO: boolean){
+    public constructor(path: string, pageSize: number, optimizedSVO: boolean, compressedPages = false){
         this._pageSize = pageSize;
-        this._loader = new SVOFileLoader(path,optimizedSVO);
-
-        console.log("File size:", this._loader.fileSize());
+        if (compressedPages){
+            this._pageLoader = new PageFileLoader(path);
+            // the page numbers and the padding of the client depend on the page size
+            if (this._pageLoader.pageSize() !== pageSize){
+                throw new Error("Page size of the file is " + this._pageLoader.pageSize() + " not " + pageSize);
+            }
+            console.log("File size:", this._pageLoader.fileSize());
+        } else{
+            this._loader = new SVOFileLoader(path,optimizedSVO);
+            console.log("File size:", this._loader.fileSize());
+        }
     }
 
     public totalPages(): number{
-        return this._loader.totalPages(this._pageSize);
+        if (this._pageLoader) return this._pageLoader.totalPages();
+        return (this._loader as SVOFileLoader).totalPages(this._pageSize);
     }
 
     /**
@@ -25,6 +36,20 @@ export default class Producer
      * @returns the page with number <pagePointer>
      */
     public request(pagePointer: number): BigUint64Array{
-        return this._loader.loadPage(pagePointer, this._pageSize);
+        return (this._loader as SVOFileLoader).loadPage(pagePointer, this._pageSize);
+    }
+
+    /**
+     * Get a compressed page by number, it is sent as it is stored
+     * @param pagePointer: number of the page
+     * @returns <total nodes:32><size:32><compressed page>, little endian
+     */
+    public requestCompressed(pagePointer: number): Buffer{
+        const loader = this._pageLoader as PageFileLoader;
+        const page = loader.loadCompressedPage(pagePointer);
+        const header = Buffer.alloc(8);
+        header.writeUInt32LE(loader.pageNodes(pagePointer), 0);
+        header.writeUInt32LE(page.length, 4);
+        return Buffer.concat([header, page]);
     }
-}
\ No newline at end of file
+}
@@ -3,16 +3,116 @@ import cors from 'cors';
 import ws from 'ws';
 import Producer from './Producer';
 import * as fs from "fs";
-import { FILENAME, OPTIMIZED_SVO, PAGESIZE, PORT, TROTTLE } from './constants';
+import { BOOTSTRAP, COMPRESSED_PAGES, FAR_POINTERS, FILENAME, LEVEL_ORDERED, OPTIMIZED_SVO, PAGESIZE, PORT, PREFETCH, TROTTLE } from './constants';
 
 const app = express();
 app.use(cors());
 app.use(express.raw({type: 'application/octet-stream'}));
 
-const producer = new Producer(FILENAME, PAGESIZE, OPTIMIZED_SVO);
+const producer = new Producer(FILENAME, PAGESIZE, OPTIMIZED_SVO, COMPRESSED_PAGES);
 
 const wss = new ws.Server({noServer: true});
 
+/**
+ * Load the far pointer table of the SVO file: <total entries:64><offset:64 for every entry>, big endian
+ * @param path of the table
+ * @returns the offsets as 32 bit little endian numbers, the client addresses nodes with 32 bits
+ */
+function loadFarTable(path: string): Buffer{
+    const file = fs.readFileSync(path);
+    const entries = Number(file.readBigUInt64BE(0));
+    const table = Buffer.alloc(4*entries);
+    for (let i = 0; i < entries;++i){
+        table.writeUInt32LE(Number(file.readBigUInt64BE(8 + 8*i) & BigInt(0xFFFFFFFF)), 4*i);
+    }
+    console.log("Far pointers:", entries - 1);
+    return table;
+}
+const farTable = FAR_POINTERS? loadFarTable(FILENAME + ".far") : Buffer.alloc(0);
+
+/**
+ * Load the depth table of a level ordered SVO file: <levels:32><levelOffset:64 for every level + end offset>, big endian
+ * @param path of the table
+ * @returns the node where every level starts and the end of the last level
+ */
+function loadLevelTable(path: string): number[]{
+    const file = fs.readFileSync(path);
+    const levels = file.readUInt32BE(0);
+    const offsets = [];
+    for (let i = 0; i <= levels;++i){
+        offsets.push(Number(file.readBigUInt64BE(4 + 8*i)));
+    }
+    console.log("Level offsets:", offsets);
+    return offsets;
+}
+const levelOffsets = LEVEL_ORDERED? loadLevelTable(FILENAME + ".levels") : [];
+
+/**
+ * Load the bootstrap bundle: <pageSize:32><depth:32><pages:64><page number:64 for every page><nodes:64 for every page>, big endian
+ * @param path of the bundle
+ * @returns <pages:32><page number:32 for every page><nodes:64 for every page>, little endian like the other pages
+ */
+function loadBootstrap(path: string): Buffer{
+    const file = fs.readFileSync(path);
+    const pageSize = file.readUInt32BE(0);
+    const pages = Number(file.readBigUInt64BE(8));
+    if (pageSize !== PAGESIZE){
+        throw new Error("Page size of the bootstrap bundle is " + pageSize + " not " + PAGESIZE);
+    }
+
+    const bundle = Buffer.alloc(4 + 4*pages + 8*pages*pageSize);
+    bundle.writeUInt32LE(pages, 0);
+    for (let i = 0; i < pages;++i){
+        bundle.writeUInt32LE(Number(file.readBigUInt64BE(16 + 8*i)), 4 + 4*i);
+    }
+    const nodeStart = 16 + 8*pages;
+    for (let i = 0; i < pages*pageSize;++i){
+        bundle.writeBigUInt64LE(file.readBigUInt64BE(nodeStart + 8*i), 4 + 4*pages + 8*i);
+    }
+    console.log("Bootstrap bundle of depth", file.readUInt32BE(4) + ":", pages, "pages");
+    return bundle;
+}
+const bootstrap = BOOTSTRAP? loadBootstrap(FILENAME + ".boot") : Buffer.alloc(0);
+
+/**
+ * Load the prefetch manifest: <pageSize:32><pages:64><entryOffset:64 for every page + end><page:64><voxels:64 for every entry>, big endian
+ * @param path of the manifest
+ * @returns the manifest as it is stored, the pages are read on request
+ */
+function loadPrefetchManifest(path: string): Buffer{
+    const file = fs.readFileSync(path);
+    const pageSize = file.readUInt32BE(0);
+    const pages = Number(file.readBigUInt64BE(4));
+    if (pageSize !== PAGESIZE){
+        throw new Error("Page size of the prefetch manifest is " + pageSize + " not " + PAGESIZE);
+    }
+    console.log("Prefetch manifest:", pages, "pages,", Number(file.readBigUInt64BE(12 + 8*pages)), "entries");
+    return file;
+}
+const prefetchManifest = PREFETCH? loadPrefetchManifest(FILENAME + ".prefetch") : Buffer.alloc(0);
+
+/**
+ * Get the pages the children of a page lead into
+ * @param page number
+ * @returns the pages with the voxels behind them, the most voxels first
+ */
+function prefetchPages(page: number){
+    const result = [] as {page: number, voxels: number}[];
+    const pages = prefetchManifest.length > 0? Number(prefetchManifest.readBigUInt64BE(4)) : 0;
+    if (!(page >= 0 && page < pages)) return result;
+
+    const entryStart = 12 + 8*(pages + 1);
+    const begin = Number(prefetchManifest.readBigUInt64BE(12 + 8*page));
+    const end = Number(prefetchManifest.readBigUInt64BE(12 + 8*(page + 1)));
+    for (let i = begin; i < end;++i){
+        result.push({
+            page: Number(prefetchManifest.readBigUInt64BE(entryStart + 16*i)),
+            voxels: Number(prefetchManifest.readBigUInt64BE(entryStart + 16*i + 8))
+        });
+    }
+    return result;
+}
+
 function sleep(ms: number) {
     return new Promise(resolve => setTimeout(resolve, ms));
 }
@@ -35,6 +135,25 @@ function sendPages(socket: WebSocket, pages: BigUint64Array[]){
     socket.send(buffer);
 }
 
+/**
+ * Get the compressed pages of requests, they are sent as they are stored
+ * @param view: 32 bit little endian page numbers
+ * @returns the compressed pages or null if a page doesn't exist
+ */
+function compressedPages(view: DataView): Buffer | null{
+    const pages = [];
+    for (let i = 0; i < view.byteLength;i+=4){
+        const req = view.getUint32(i, true);
+        try{
+            pages.push(producer.requestCompressed(req));
+        } catch(e){
+            console.log("Error retreiving page:", req);
+            return null;
+        }
+    }
+    return Buffer.concat(pages);
+}
+
 wss.on("connection", (socket: WebSocket)=>{
     socket.binaryType = 'arraybuffer';
 
@@ -45,6 +164,12 @@ wss.on("connection", (socket: WebSocket)=>{
         const data = message.data as ArrayBuffer;
         const view = new DataView(data);
 
+        if (COMPRESSED_PAGES){
+            const buffer = compressedPages(view);
+            if (buffer !== null && buffer.length > 0) socket.send(buffer);
+            return;
+        }
+
         const pages = [];
 
         for (let i = 0; i < view.byteLength;i+=4){
@@ -68,6 +193,16 @@ app.post("/xmlhttpreq", async (req, res) => {
     await sleep(TROTTLE);
 
     const view = Buffer.from(req.body) ;
+
+    if (COMPRESSED_PAGES){
+        const buffer = compressedPages(new DataView(view.buffer, view.byteOffset, view.byteLength));
+        if (buffer === null || buffer.length <= 0) return;
+        res.type('application/octet-stream');
+        res.write(buffer);
+        res.end();
+        return;
+    }
+
     const pages = [];
 
     for (let i = 0; i < view.byteLength;i+=4){
@@ -109,6 +244,26 @@ app.get("/node/:nodeNumber", (req, res) => {
     }
 });
 
+app.get("/fartable", (req, res)=>{
+    res.type('application/octet-stream');
+    res.write(farTable);
+    res.end();
+});
+
+app.get("/bootstrap", (req, res)=>{
+    res.type('application/octet-stream');
+    res.write(bootstrap);
+    res.end();
+});
+
+app.get("/prefetch/:pageNumber", (req, res)=>{
+    res.json(prefetchPages(Number(req.params.pageNumber as string)));
+});
+
+app.get("/levels", (req, res)=>{
+    res.json(levelOffsets);
+});
+
 app.get("/totalpages", (req, res)=>{
     res.type("text/plain")
     res.write(producer.totalPages().toString());
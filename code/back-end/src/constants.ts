@@ -3,4 +3,9 @@ export const PORT = 5001;
 export const FILENAME = "assets/SVOfiles/armour11.svo";
 export const PAGESIZE = 32;
 export const TROTTLE = 0;
-export const OPTIMIZED_SVO = false;
\ No newline at end of file
+export const OPTIMIZED_SVO = false;
+export const COMPRESSED_PAGES = false;  // FILENAME is compressed with ./main page-encode, the client decodes the pages
+export const FAR_POINTERS = false;      // FILENAME is converted with ./main far-pointers, the table is FILENAME + ".far"
+export const LEVEL_ORDERED = false;     // FILENAME is written with ./main level-order, the depth table is FILENAME + ".levels"
+export const BOOTSTRAP = false;         // FILENAME + ".boot" is written with ./main bootstrap, the client loads it at the start
+export const PREFETCH = false;          // FILENAME + ".prefetch" is written with ./main prefetch, the pages behind a page are served on /prefetch
@@ -30,6 +30,9 @@ export enum SendType{
 export const SENDTYPE: SendType = SendType.ajax;
 export const MAX_REQUEST_SIZE = 10000;
 export const MAX_INFLIGHT = 10*MAX_REQUEST_SIZE;
+export const COMPRESSED_PAGES = false;   // pages are sent compressed, also change in back-end
+export const FAR_POINTERS = false;       // refer bits index the far pointer table of the back-end, also change in back-end
+export const BOOTSTRAP = false;          // the pages of the top levels are loaded in one response at the start, also change in back-end
 
 
 // object constants
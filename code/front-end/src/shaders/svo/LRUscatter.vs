@@ -66,6 +66,9 @@ uniform uint uPageSize;
 uniform uint uMaxDepth;
 uniform Camera uCamera;
 uniform float uPixelSize;
+uniform usampler2D uFarTable;   // texture containing the far pointer table
+uniform uint uFarTableWidth;
+uniform bool uFarPointers;      // the refer bit indexes the far pointer table
 
 //////////////////////////
 // Globals
@@ -179,6 +182,13 @@ uint getReferPointer(uint pointer){
     return (info.b << 16u) | info.a;
 }
 
+uint getFarPointer(uint index){
+    // 0 if the table is not loaded yet
+    if (index >= uFarTableWidth*uFarTableWidth) return 0u;
+    ivec2 coord = ivec2(index%uFarTableWidth, index/uFarTableWidth);
+    return texelFetch(uFarTable, coord, 0).r;
+}
+
 /**
 * Get the child of a node
 * @param node: the parent node
@@ -197,7 +207,13 @@ Node getChild(Node node,uint childIndex){
     // count the children of the node with a smaller index
     int n = int(node.children);
     uint p = node.pointer + node.childPointer;
-    if (node.refer){
+    if (node.refer && uFarPointers){
+        uint r = getFarPointer(node.childPointer);
+        if (r == 0u){
+            return SOLID_NODE(p);
+        }
+        p = node.pointer + r;
+    } else if (node.refer){
         uint r = getReferPointer(p);
         if (r == 0u){
             return SOLID_NODE(p);
@@ -9,7 +9,7 @@ import Framebuffer from "../webgl/framebuffer";
 import { ptimer } from "../ptimer";
 import LRUCollector from "./LRUCollector";
 import Texture from "../webgl/texture";
-import { BACK_END_PORT, LUT_SIZE, NODE_DATA_POOL_SIZE, PAGESIZE } from "../../constants";
+import { BACK_END_PORT, FAR_POINTERS, LUT_SIZE, NODE_DATA_POOL_SIZE, PAGESIZE } from "../../constants";
 
 
 export type RenderOptions ={
@@ -79,6 +79,10 @@ export class SVORender{
         this._LRUCol = new LRUCollector(gl, this._canvas, this._camera, this._SVOCache);
 
         this.createPBO(this._SVOCache.requestFrame());
+
+        if (FAR_POINTERS){
+            this._SVOCache.setFarTable(await this.getFarTable());
+        }
     }
 
     /**
@@ -224,6 +228,18 @@ export class SVORender{
         return true;
     }
 
+    private async getFarTable(): Promise<Uint32Array>{
+        try{
+            const response = await fetch('//localhost:' + BACK_END_PORT +'/fartable', {
+                method: "GET"
+            });
+            return new Uint32Array(await response.arrayBuffer());
+        } catch(e){
+            console.error("Error retreiving far pointer table: ", e);
+            throw e;
+        }
+    }
+
     private async getLUTSIZE(): Promise<number>{
         try{
             const response = await fetch('//localhost:' + BACK_END_PORT +'/totalPages', {
@@ -1,5 +1,6 @@
 import { ptimer } from "../../ptimer";
 import Shader from "../../webgl/shader";
+import { FAR_POINTERS } from "../../../constants";
 
 const LUT_ELEMENT_SIZE = 3;     // amount of UI32 for each LUT element
 
@@ -12,6 +13,8 @@ export default class CacheTexture{
     private _LUTHeight: number;
     private _svoTex: WebGLTexture | null = null;
     private _svoLUTTex: WebGLTexture | null = null;
+    private _farTableTex: WebGLTexture | null = null;
+    private _farTableWidth = 0;
     private _pageSize: number;
 
     private _dataPoolPBO: WebGLBuffer | null = null;
@@ -30,6 +33,7 @@ export default class CacheTexture{
         this.createPBO();
         this.createSVOTex();
         this.createSVOLUTTex();
+        this.setFarTable(new Uint32Array(1));
 
         console.debug("Created data pool with size:", this.dataPoolSize());
         console.debug("Created lookup table with size:", this.lutSize());
@@ -62,10 +66,43 @@ export default class CacheTexture{
         shader.bindUniform1ui("uLUTWidth", this._LUTWidth);
         shader.bindUniform1ui("uLUTHeight", this._LUTHeight);
         shader.bindUniform1ui("uPageSize", this._pageSize);
+        shader.bindUniform1i("uFarTable", 4);
+        shader.bindUniform1ui("uFarTableWidth", this._farTableWidth);
+        shader.bindUniform1i("uFarPointers", FAR_POINTERS? 1 : 0);
         gl.activeTexture(gl.TEXTURE1);
         gl.bindTexture(gl.TEXTURE_2D, this._svoTex);
         gl.activeTexture(gl.TEXTURE2);
         gl.bindTexture(gl.TEXTURE_2D, this._svoLUTTex);
+        gl.activeTexture(gl.TEXTURE4);
+        gl.bindTexture(gl.TEXTURE_2D, this._farTableTex);
+    }
+
+    /**
+     * Upload the far pointer table, until then the children behind far pointers are not found
+     * @param table offsets of the far pointers, index 0 is unused
+     * @post far pointer texture contains <table>
+     */
+    public setFarTable(table: Uint32Array){
+        const gl = this._gl;
+
+        this._farTableWidth = Math.max(1, Math.ceil(Math.sqrt(table.length)));
+        const data = new Uint32Array(this._farTableWidth*this._farTableWidth);
+        data.set(table);
+
+        if (this._farTableTex !== null) gl.deleteTexture(this._farTableTex);
+        this._farTableTex = gl.createTexture();
+        gl.activeTexture(gl.TEXTURE4);
+        gl.bindTexture(gl.TEXTURE_2D, this._farTableTex);
+
+        // format texture
+        gl.pixelStorei(gl.UNPACK_ALIGNMENT, 1);
+        gl.texImage2D(gl.TEXTURE_2D, 0, gl.R32UI, this._farTableWidth, this._farTableWidth, 0, gl.RED_INTEGER, gl.UNSIGNED_INT, data);
+
+        // set texture parameters
+        gl.texParameteri(gl.TEXTURE_2D, gl.TEXTURE_MAG_FILTER, gl.NEAREST);
+        gl.texParameteri(gl.TEXTURE_2D, gl.TEXTURE_MIN_FILTER, gl.NEAREST);
+        gl.texParameteri(gl.TEXTURE_2D, gl.TEXTURE_WRAP_S, gl.CLAMP_TO_EDGE);
+        gl.texParameteri(gl.TEXTURE_2D, gl.TEXTURE_WRAP_T, gl.CLAMP_TO_EDGE);
     }
 
     /**
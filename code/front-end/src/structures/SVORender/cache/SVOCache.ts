@@ -84,6 +84,10 @@ export default class SVOCache {
         this._cacheTex.bind(shader);
     }
 
+    public setFarTable(table: Uint32Array){
+        this._cacheTex.setFarTable(table);
+    }
+
     public cachePointer(): number{
         return this._recvData.cachePointer[0];
     }
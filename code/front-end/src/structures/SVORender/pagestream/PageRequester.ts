@@ -1,5 +1,5 @@
 import { ptimer } from "../../ptimer";
-import { MAX_INFLIGHT } from "../../../constants";
+import { BACK_END_PORT, BOOTSTRAP, MAX_INFLIGHT } from "../../../constants";
 import { LUTFind } from "../LUToperations";
 import Mutex from "../worker/mutex";
 import { RecvData } from "../worker/requestworkertypes";
@@ -11,6 +11,7 @@ const NOREQUEST_NUMBER = 0;
 export default class PageRequester{
     private _requester: Requester;
     private _onload: (page: PageData) => void;
+    private _pageSize: number;
 
     private _lut: Uint32Array;
     private _requestFrame: Uint32Array;
@@ -24,13 +25,18 @@ export default class PageRequester{
 
     constructor(lut: Uint32Array, requestFrame: Uint32Array, pageSize: number, onLoad: (page: PageData) => void, recvData: RecvData){
         this._onload = onLoad;
+        this._pageSize = pageSize;
         this._lut = lut;
         this._requestMap = new Uint8Array(lut.length);
         this._requestFrame = requestFrame;
         this._recvData = recvData;
 
         const onready = () => {
-            this.requestRoot();
+            if (BOOTSTRAP){
+                this.requestBootstrap();
+            } else{
+                this.requestRoot();
+            }
         };
         const loadPage = (page: PageData) => {
             // remove in-flight bit for the page
@@ -152,4 +158,35 @@ export default class PageRequester{
         // update total pages requested
         this._recvData.pagesRequested[0] += 1;
     }
+
+    /**
+     * Load the bootstrap bundle of the back-end, the pages of the top levels in one response
+     * @post the pages of the bundle are loaded with the root page first, the root is requested if there is no bundle
+     */
+    private async requestBootstrap(){
+        try{
+            const response = await fetch('//localhost:' + BACK_END_PORT + '/bootstrap', {
+                method: "GET"
+            });
+            // <pages:32><page number:32 for every page><nodes:64 for every page>, little endian
+            const view = new DataView(await response.arrayBuffer());
+            const totalPages = view.byteLength >= 4? view.getUint32(0, true) : 0;
+            if (totalPages <= 0) throw new Error("Empty bootstrap bundle");
+
+            this._recvData.pagesRequested[0] += totalPages;
+            let nodePointer = 4 + 4*totalPages;
+            for (let p = 0; p < totalPages;++p){
+                const page = [] as bigint[];
+                for (let i = 0; i < this._pageSize;++i){
+                    page.push(view.getBigUint64(nodePointer, true));
+                    nodePointer += 8;
+                }
+                this._recvData.pagesReceived[0] += 1;
+                this._onload({pageNumber: view.getUint32(4 + 4*p, true), data: page});
+            }
+        } catch(e){
+            console.error("Error retreiving bootstrap bundle: ", e);
+            this.requestRoot();
+        }
+    }
 }
\ No newline at end of file
@@ -1,4 +1,5 @@
-import { BACK_END_PORT, MAX_REQUEST_SIZE } from "../../../../constants";
+import { BACK_END_PORT, COMPRESSED_PAGES, MAX_REQUEST_SIZE } from "../../../../constants";
+import { decodePages } from "./pagedecoder";
 import { PageData } from "./requester";
 
 const RETRY_TIME = 200;
@@ -50,6 +51,16 @@ export default class AjaxSend{
     }
 
     private onRecv(requests: number[], data: any){
+        if (COMPRESSED_PAGES){
+            const pages = decodePages(data, this._pageSize);
+            for (let p = 0; p < pages.length;++p){
+                const pageNumber = requests.shift();
+                if (pageNumber != undefined)
+                    this._onrecv({pageNumber: pageNumber, data: pages[p]});
+            }
+            return;
+        }
+
         const view = new DataView(data);
 
         let i = 0;
@@ -0,0 +1,112 @@
+/**
+ * Decoder for the compressed pages of the back-end (PageCoder in the voxelizer), a page is decoded
+ * without any other page.
+ * Message: <total nodes:32><size:32><page> for every page, little endian
+ * Page: <palette size:varint, 0 for raw colors><palette:32 each><masks:8 each>
+ *       <offset differences:varint each><color ids:8 each, none for 1 color, raw colors:32 each>
+ */
+
+type Reader = {view: DataView; pointer: number};
+
+function readVarint(reader: Reader): number{
+    let value = 0;
+    let shift = 0;
+    let byte = reader.view.getUint8(reader.pointer++);
+    while (byte & 0x80){
+        value += (byte & 0x7F)*2**shift;
+        shift += 7;
+        byte = reader.view.getUint8(reader.pointer++);
+    }
+    return value + byte*2**shift;
+}
+
+function unzigzag(value: number): number{
+    return (value % 2 == 1)? -(value + 1)/2 : value/2;
+}
+
+function popcount(bits: number): number{
+    let count = 0;
+    while (bits > 0){
+        count += bits & 1;
+        bits >>= 1;
+    }
+    return count;
+}
+
+/**
+ * Decode one page
+ * @param view: the compressed page
+ * @param totalNodes: nodes in the page
+ * @param pageSize: the page is filled up with empty nodes to <pageSize> nodes
+ * @returns the 64 bit nodes of the page
+ */
+export function decodePage(view: DataView, totalNodes: number, pageSize: number): bigint[]{
+    const reader = {view, pointer: 0};
+
+    const paletteSize = readVarint(reader);
+    const palette = [] as number[];
+    for (let i = 0; i < paletteSize;++i){
+        palette.push(view.getUint32(reader.pointer, false));
+        reader.pointer += 4;
+    }
+
+    const masks = [] as number[];
+    for (let i = 0; i < totalNodes;++i){
+        masks.push(view.getUint8(reader.pointer++));
+    }
+
+    // the children of a node are in front of the children of the node before it
+    const fields = [] as number[];
+    let lastChildren = -1;
+    for (let i = 0; i < totalNodes;++i){
+        let prediction = 0;
+        if (lastChildren >= 0){
+            const offset = lastChildren - popcount(masks[i]) - i;
+            prediction = (offset > 0 && offset < 2**23)? offset : 0;
+        }
+        const field = (prediction + unzigzag(readVarint(reader)) + 2**24) % 2**24;
+        fields.push(field);
+
+        const offset = field % 2**23;
+        const refer = field >= 2**23;
+        lastChildren = (offset == 0 && !refer)? -1 : i + offset;
+    }
+
+    const page = [] as bigint[];
+    for (let i = 0; i < totalNodes;++i){
+        let color = 0;
+        if (paletteSize == 0){
+            color = view.getUint32(reader.pointer, false);
+            reader.pointer += 4;
+        } else if (paletteSize == 1){
+            color = palette[0];
+        } else{
+            color = palette[view.getUint8(reader.pointer++)];
+        }
+        page.push((BigInt(masks[i]) << BigInt(56)) | (BigInt(fields[i]) << BigInt(32)) | BigInt(color));
+    }
+    while (page.length < pageSize){
+        page.push(BigInt(0));
+    }
+    return page;
+}
+
+/**
+ * Decode the pages of a message of the back-end
+ * @param data: the message
+ * @param pageSize: nodes per page
+ * @returns the pages in the order of the message
+ */
+export function decodePages(data: ArrayBuffer, pageSize: number): bigint[][]{
+    const view = new DataView(data);
+    const pages = [] as bigint[][];
+    let pointer = 0;
+    while (pointer + 8 <= view.byteLength){
+        const totalNodes = view.getUint32(pointer, true);
+        const size = view.getUint32(pointer + 4, true);
+        pointer += 8;
+        pages.push(decodePage(new DataView(data, pointer, size), totalNodes, pageSize));
+        pointer += size;
+    }
+    return pages;
+}
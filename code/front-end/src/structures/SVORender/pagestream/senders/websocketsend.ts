@@ -1,4 +1,5 @@
-import { BACK_END_PORT, MAX_REQUEST_SIZE } from "../../../../constants";
+import { BACK_END_PORT, COMPRESSED_PAGES, MAX_REQUEST_SIZE } from "../../../../constants";
+import { decodePages } from "./pagedecoder";
 import { PageData } from "./requester";
 
 export default class WebSocketSend{
@@ -46,6 +47,17 @@ export default class WebSocketSend{
 
 
     private onRecv(data: any){
+        if (COMPRESSED_PAGES){
+            // every message holds whole compressed pages
+            const pages = decodePages(data, this._pageSize);
+            for (let p = 0; p < pages.length;++p){
+                const pageNumber = this._inflightbuffer.shift();
+                if (pageNumber != undefined)
+                    this._onrecv({pageNumber: pageNumber, data: pages[p]});
+            }
+            return;
+        }
+
         const view = new DataView(data);
 
         let i = 0;
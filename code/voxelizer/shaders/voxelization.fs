@@ -7,14 +7,15 @@ layout(rgba8, binding = 0) uniform image3D outTex;
 layout(rgba32f, binding = 1) uniform image3D outNormals;
 
 uniform ivec3 uResolution;
-uniform sampler2D uTex;
-uniform bool uHasTex;
+// textures of all materials, a layer below 0 uses the vertex color
+uniform sampler2DArray uTextures;
 
 in GS_OUT{
 	vec3 pos;
     vec4 color;
     vec2 texCoord;
     vec3 normal;
+    flat float textureLayer;
 } fs_in;
 
 void main()
@@ -26,8 +27,8 @@ void main()
 
     vec4 color;
     
-    if (uHasTex){
-        color = texture(uTex,fs_in.texCoord);
+    if (fs_in.textureLayer >= 0.){
+        color = texture(uTextures,vec3(fs_in.texCoord, fs_in.textureLayer));
     }else{
         color = fs_in.color;
     }
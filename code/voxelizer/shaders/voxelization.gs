@@ -11,6 +11,7 @@ in VS_OUT{
 	vec4 color;
 	vec2 texCoord;
 	vec3 normal;
+	float textureLayer;
 } gs_in[];
 
 out GS_OUT{
@@ -18,6 +19,7 @@ out GS_OUT{
 	vec4 color;
 	vec2 texCoord;
 	vec3 normal;
+	flat float textureLayer;
 } gs_out;
 
 uniform ivec3 uResolution;
@@ -78,6 +80,7 @@ void emitVertex(uint index, vec3 v, vec4 pos){
 	gs_out.color = gs_in[index].color;
 	gs_out.texCoord = gs_in[index].texCoord;
 	gs_out.normal = gs_in[index].normal;
+	gs_out.textureLayer = gs_in[index].textureLayer;
 	EmitVertex();
 }
 
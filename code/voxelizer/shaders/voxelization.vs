@@ -4,6 +4,7 @@ layout(location = 0) in vec3 aPos;
 layout(location = 1) in vec4 aColor;
 layout(location = 2) in vec2 aTexCoord;
 layout (location = 3) in vec3 aNormal;
+layout (location = 4) in float aTextureLayer;
 
 uniform ivec3 uResolution;
 uniform mat4 uModel;
@@ -13,6 +14,7 @@ out VS_OUT {
     vec4 color;
     vec2 texCoord;
     vec3 normal;
+    float textureLayer;
 } vs_out;
 
 void main()
@@ -24,4 +26,5 @@ void main()
     vs_out.color = aColor;
     vs_out.texCoord = aTexCoord;
     vs_out.normal = aNormal;
+    vs_out.textureLayer = aTextureLayer;
 }
\ No newline at end of file
@@ -1,15 +1,33 @@
 
 #include <string.h>
+#include <cstdio>
 #include <GL/glew.h>
 #include <GL/freeglut.h>
 #include <iostream>
 #include <vector>
 #include <string>
+#include <fstream>
 #include <glm/gtc/matrix_transform.hpp>
 
 #include "voxelizer/SVOMaker.h"
 #include "window.h"
 #include "voxelizer/SVOSaver.h"
+#include "voxelizer/ColorDeltaCoder.h"
+#include "voxelizer/PageCoder.h"
+#include "voxelizer/SVOEditor.h"
+#include "voxelizer/SVOMerger.h"
+#include "voxelizer/ExternalSort.h"
+#include "voxelizer/CpuSVOMaker.h"
+#include "voxelizer/TriangleOverlap.h"
+#include "voxelizer/Profiler.h"
+#include "voxelizer/MemoryTracker.h"
+#include "voxelizer/Benchmark.h"
+#include "voxelizer/FormatBenchmark.h"
+#include "voxelizer/SVOInspector.h"
+#include "voxelizer/FarPointers.h"
+#include "voxelizer/LevelOrder.h"
+#include "voxelizer/BootstrapBundle.h"
+#include "voxelizer/PrefetchManifest.h"
 
 Window* window;
 SVOMaker* SVOmaker;
@@ -32,88 +50,464 @@ void initGL()
     std::cerr << "INFO: OpenGL Version: " << glGetString(GL_VERSION) << "\n";
 }
 
-void saveSVOfromModel(const char* output_file, ModelLoader::Result model, glm::vec3 offset, glm::vec3 size, unsigned int depth, bool optimize)
+void saveSVOfromModel(const char* output_file, const ModelLoader::Result& model, glm::vec3 offset, glm::vec3 size, unsigned int depth, bool optimize, unsigned int colorBits, float maxColorError)
 {
-    std::cout << "Creating SVO's from " << model.models.size() << " models\n";
-    SVO svo = SVOmaker->modelToSvo(offset, size,model.models[0], depth);
-    for (unsigned int i = 1; i < model.models.size(); ++i){
-        SVO s = SVOmaker->modelToSvo(offset, size,model.models[i], depth);
-        svo.addSVO(s);
-    }
+    // all materials are voxelized in the same pass
+    std::cout << "Creating SVO from " << model.store->materials.size() << " materials\n";
+    SVO svo = SVOmaker->modelToSvo(offset, size, model, depth);
 
     // save svo to file
     std::cout << "Saving SVO to file " << output_file << "...\n";
     if (optimize){
-        SVOSaver::saveOpt(output_file,svo);
+        SVOSaver::saveOpt(output_file,svo, colorBits, maxColorError);
     }else{
         SVOSaver::save(output_file,svo);
     }
     std::cout << "SVO saved to file\n";
 }
 
-void splitsave(const char* output_file, ModelLoader::Result model, glm::vec3 offset, glm::vec3 size, unsigned int depth, bool optimize)
+// false if a file couldn't be written or the memory budget was exceeded
+bool splitsave(const char* output_file, const ModelLoader::Result& model, glm::vec3 offset, glm::vec3 size, unsigned int depth, bool optimize, unsigned int colorBits, float maxColorError)
 {
     if (depth >= 12){
         size = size * glm::vec3(2,2,2);
         offset = offset * glm::vec3(2,2,2);
+        std::string octantFiles[8];
         for (uint8_t i = 0; i < 8;++i){
             float d = -1;
             glm::vec3 coffset = offset + glm::vec3(((i&1) > 0)*d,((i&2) > 0)*d,((i&4) > 0)*d);
-        
-            splitsave((std::to_string(i) + output_file).c_str(), model, coffset, size, depth-1, optimize);
+
+            octantFiles[i] = SVOMerger::octantFile(output_file, i);
+            if (!splitsave(octantFiles[i].c_str(), model, coffset, size, depth-1, optimize, colorBits, maxColorError)) return false;
         }
+
+        if (!optimize){
+            // join the octants in one file, the optimized format keeps the octant files
+            const char* files[8];
+            for (unsigned int i = 0; i < 8;++i) files[i] = octantFiles[i].c_str();
+            SVOMerger::mergeFiles(output_file, files);
+            for (unsigned int i = 0; i < 8;++i) std::remove(files[i]);
+        }
+    } else if (optimize){
+        saveSVOfromModel(output_file, model, offset, size, depth, optimize, colorBits, maxColorError);
+        return !MemoryTracker::exceeded();
     } else{
-        saveSVOfromModel(output_file, model, offset, size, depth, optimize);
+        std::ofstream out(output_file, std::ios_base::binary);
+        return SVOmaker->modelToSvoFile(out, offset, size, model, depth);
+    }
+    return true;
+}
+
+
+// the page size of an argument, 0 if the argument is not a valid page size
+unsigned int pageSizeArg(const char* arg)
+{
+    const int pageSize = std::stoi(arg);
+    if (pageSize <= 0){
+        std::cout << "The page size must be at least 1 node\n";
+        return 0;
     }
+    return pageSize;
+}
+
+// size of a file in bytes, 0 if it can't be opened
+uint64_t fileSize(const std::string& file)
+{
+    std::ifstream in(file, std::ios::binary | std::ios::ate);
+    return in.is_open()? (uint64_t)in.tellg() : 0;
 }
 
+// tools working on existing SVO files, they don't need a window
+bool runTool(int argc, char *argv[])
+{
+    if (argc < 2) return false;
+
+    if (strcmp(argv[1], "delta-encode") == 0 && argc > 3){
+        const unsigned int pageSize = argc > 4? pageSizeArg(argv[4]) : 32;
+        if (pageSize > 0) ColorDeltaCoder::encode(argv[2], argv[3], pageSize, argc > 5? std::stoi(argv[5]) : 0, (std::string(argv[2]) + ".far").c_str());
+        return true;
+    }
+    if (strcmp(argv[1], "delta-decode") == 0 && argc > 3){
+        ColorDeltaCoder::decode(argv[2], argv[3]);
+        return true;
+    }
+    if (strcmp(argv[1], "page-encode") == 0 && argc > 3){
+        const unsigned int pageSize = argc > 4? pageSizeArg(argv[4]) : 32;
+        if (pageSize > 0) PageCoder::encode(argv[2], argv[3], pageSize);
+        return true;
+    }
+    if (strcmp(argv[1], "page-decode") == 0 && argc > 3){
+        PageCoder::decode(argv[2], argv[3]);
+        return true;
+    }
+    if (strcmp(argv[1], "far-pointers") == 0 && argc > 3){
+        FarPointers::convert(argv[2], argv[3], (std::string(argv[3]) + ".far").c_str(), argc > 4? std::stoi(argv[4]) : 0);
+        return true;
+    }
+    if (strcmp(argv[1], "level-order") == 0 && argc > 3){
+        LevelOrder::write(argv[2], argv[3], (std::string(argv[3]) + ".levels").c_str(), argc > 4? std::stoi(argv[4]) : 0);
+        return true;
+    }
+    if (strcmp(argv[1], "bootstrap") == 0 && argc > 3){
+        const unsigned int pageSize = argc > 6? pageSizeArg(argv[6]) : 32;
+        if (pageSize == 0) return true;
+        BootstrapBundle::write(argv[2], argv[3], (std::string(argv[2]) + ".far").c_str(), pageSize,
+                               argc > 4? std::stoi(argv[4]) : 6, (argc > 5? std::stoull(argv[5]) : 1024)*1024, argc > 7? std::stoi(argv[7]) : 0);
+        return true;
+    }
+    if (strcmp(argv[1], "prefetch") == 0 && argc > 4){
+        const unsigned int pageSize = argc > 6? pageSizeArg(argv[6]) : 32;
+        if (pageSize == 0) return true;
+        PrefetchManifest::write(argv[2], argv[3], (std::string(argv[2]) + ".far").c_str(), pageSize,
+                                argc > 5? std::stoi(argv[5]) : 8, std::stoi(argv[4]), argc > 7 && std::stoi(argv[7]) != 0);
+        return true;
+    }
+    if (strcmp(argv[1], "edit") == 0 && argc > 6){
+        SVOEditor editor(argv[2], std::stoi(argv[3]));
+        const uint64_t mortonBegin = std::stoull(argv[5]);
+        const uint64_t mortonEnd = std::stoull(argv[6]);
+        RGBA8 color{0,0,0,255};
+        if (argc > 10){
+            color = {(uint8_t)std::stoi(argv[7]), (uint8_t)std::stoi(argv[8]), (uint8_t)std::stoi(argv[9]), (uint8_t)std::stoi(argv[10])};
+        }
+
+        if (strcmp(argv[4], "set") == 0){
+            editor.setVoxels(mortonBegin, mortonEnd, color);
+        } else if (strcmp(argv[4], "clear") == 0){
+            editor.clearVoxels(mortonBegin, mortonEnd);
+        } else if (strcmp(argv[4], "recolor") == 0){
+            editor.recolorVoxels(mortonBegin, mortonEnd, color);
+        } else{
+            std::cout << "Unknown edit operation: " << argv[4] << "\n";
+        }
+        return true;
+    }
+    if (strcmp(argv[1], "voxels-to-svo") == 0 && argc > 4){
+        const uint64_t maxMemory = (argc > 5? std::stoull(argv[5]) : 1024)*1024*1024;
+        if (!ExternalSort::buildFile(argv[2], argv[4], std::stoi(argv[3]), maxMemory, argc > 6 && std::stoi(argv[6]))){
+            std::cerr << "Error building " << argv[4] << "\n";
+        }
+        return true;
+    }
+    if (strcmp(argv[1], "sortbench") == 0 && argc > 2){
+        const uint64_t maxMemory = (argc > 3? std::stoull(argv[3]) : 1024)*1024*1024;
+        ExternalSort::benchmark(std::stoull(argv[2]), maxMemory, argc > 4? std::stoi(argv[4]) : 13, argc > 5 && std::stoi(argv[5]));
+        return true;
+    }
+    if (strcmp(argv[1], "overlapbench") == 0){
+        // the bundled models by default
+        std::vector<std::string> files;
+        for (int i = 3; i < argc;++i){
+            files.push_back(argv[i]);
+        }
+        if (files.empty()){
+            files = {"models/triangle.obj", "models/cube.obj", "models/house.obj", "models/viking_room.obj", "models/car/car.obj"};
+        }
+        TriangleOverlap::benchmark(files, argc > 2? std::stoi(argv[2]) : 9);
+        return true;
+    }
+    if (strcmp(argv[1], "benchmark") == 0){
+        // the bundled models by default, the GPU voxelizer needs a window for its OpenGL context
+        std::vector<std::string> files;
+        std::vector<const char*> args;
+        bool gpu = false;
+        for (int i = 2; i < argc;++i){
+            if (strcmp(argv[i], "--gpu") == 0){
+                gpu = true;
+            } else if (args.size() < 3){
+                args.push_back(argv[i]);
+            } else{
+                files.push_back(argv[i]);
+            }
+        }
+        if (files.empty()){
+            files = {"models/cube.obj", "models/triangle.obj", "models/house.obj", "models/viking_room.obj", "models/sponza.obj"};
+        }
+        if (gpu){
+            window = new Window(WINDOW_TITLE, 1, 1);
+            initGL();
+        }
+        Benchmark::run(files, args.size() > 0? std::stoi(args[0]) : 6, args.size() > 1? std::stoi(args[1]) : 11,
+                       args.size() > 2? args[2] : "benchmark", gpu);
+        delete window;
+        return true;
+    }
+    if (strcmp(argv[1], "inspect") == 0 && argc > 2){
+        const unsigned int pageSize = argc > 3? pageSizeArg(argv[3]) : 32;
+        if (pageSize > 0) SVOInspector::inspect(argv[2], pageSize, argc > 4? std::stoi(argv[4]) : 0);
+        return true;
+    }
+    if (strcmp(argv[1], "formatbench") == 0 && argc > 3){
+        const unsigned int pageSize = argc > 4? pageSizeArg(argv[4]) : 32;
+        if (pageSize > 0) FormatBenchmark::run(argv[2], std::stoi(argv[3]), pageSize, argc > 5? std::stod(argv[5]) : 100);
+        return true;
+    }
+    if (strcmp(argv[1], "merge") == 0 && argc > 2){
+        // merges the octant files 0<outputfile>...7<outputfile>
+        std::string octantFiles[8];
+        const char* files[8];
+        for (unsigned int i = 0; i < 8;++i){
+            octantFiles[i] = SVOMerger::octantFile(argv[2], i);
+            files[i] = octantFiles[i].c_str();
+        }
+        SVOMerger::mergeFiles(argv[2], files);
+        return true;
+    }
+    return false;
+}
 
 int main(int argc, char *argv[])
 {
-    if (argc< 5){
-        std::cout << "Usage: ./main <inputpath> <inputfilename> <depth> <outputfile> <opt = 0> <fill = 0>";
+    if (runTool(argc, argv)) return 0;
+
+    // split the arguments in positional arguments and options
+    std::vector<const char*> args;
+    bool bricks = false;
+    unsigned int colorBits = 0;
+    float maxColorError = 0;
+    bool colorDelta = false;
+    bool compressPages = false;
+    bool farPointers = false;
+    bool levelOrder = false;
+    bool bootstrap = false;
+    unsigned int bootstrapDepth = 64;
+    uint64_t bootstrapSize = 1024*1024;
+    bool prefetch = false;
+    unsigned int prefetchEntries = 8;
+    unsigned int pageSize = 32;
+    uint64_t maxMemory = 0;
+    bool cpu = false;
+    bool coarseToFine = false;
+    unsigned int totalThreads = 0;
+    std::string profileFile = "";
+    std::string traceFile = "";
+    bool hardwareCounters = false;
+    for (int i = 1; i < argc;++i){
+        if (strcmp(argv[i], "--bricks") == 0){
+            bricks = true;
+        } else if (strcmp(argv[i], "--color-bits") == 0 && i + 1 < argc){
+            colorBits = std::stoi(argv[++i]);
+        } else if (strcmp(argv[i], "--max-color-error") == 0 && i + 1 < argc){
+            maxColorError = std::stof(argv[++i]);
+        } else if (strcmp(argv[i], "--color-delta") == 0){
+            colorDelta = true;
+        } else if (strcmp(argv[i], "--compress-pages") == 0){
+            compressPages = true;
+        } else if (strcmp(argv[i], "--far-pointers") == 0){
+            farPointers = true;
+        } else if (strcmp(argv[i], "--level-order") == 0){
+            levelOrder = true;
+        } else if (strcmp(argv[i], "--bootstrap") == 0 && i + 1 < argc){
+            bootstrap = true;
+            bootstrapDepth = std::stoi(argv[++i]);
+        } else if (strcmp(argv[i], "--bootstrap-size") == 0 && i + 1 < argc){
+            bootstrap = true;
+            bootstrapSize = std::stoull(argv[++i])*1024;
+        } else if (strcmp(argv[i], "--prefetch") == 0 && i + 1 < argc){
+            prefetch = true;
+            prefetchEntries = std::stoi(argv[++i]);
+        } else if (strcmp(argv[i], "--page-size") == 0 && i + 1 < argc){
+            pageSize = pageSizeArg(argv[++i]);
+            if (pageSize == 0) return 1;
+        } else if (strcmp(argv[i], "--max-memory") == 0 && i + 1 < argc){
+            maxMemory = std::stoull(argv[++i])*1024*1024;
+        } else if (strcmp(argv[i], "--cpu") == 0){
+            cpu = true;
+        } else if (strcmp(argv[i], "--coarse-to-fine") == 0){
+            coarseToFine = true;
+        } else if (strcmp(argv[i], "--threads") == 0 && i + 1 < argc){
+            totalThreads = std::stoi(argv[++i]);
+        } else if (strcmp(argv[i], "--profile") == 0 && i + 1 < argc){
+            profileFile = argv[++i];
+        } else if (strcmp(argv[i], "--trace") == 0 && i + 1 < argc){
+            traceFile = argv[++i];
+        } else if (strcmp(argv[i], "--hw-counters") == 0){
+            hardwareCounters = true;
+        } else{
+            args.push_back(argv[i]);
+        }
+    }
+
+    if (args.size() < 4){
+        std::cout << "Usage: ./main <inputpath> <inputfilename> <depth> <outputfile> <opt = 0> <fill = 0> [--bricks] [--color-bits <bits>] [--max-color-error <error>] [--color-delta] [--compress-pages] [--page-size <nodes>] [--max-memory <MB>] [--cpu] [--coarse-to-fine] [--threads <threads>]\n"
+                  << "              [--far-pointers] [--level-order] [--bootstrap <depth>] [--bootstrap-size <KB>] [--prefetch <pages>] [--profile <jsonfile>] [--trace <tracefile>] [--hw-counters]\n"
+                  << "       ./main delta-encode <svofile> <outputfile> <pagesize = 32> <bricksdepth = 0>\n"
+                  << "       ./main delta-decode <inputfile> <svofile>\n"
+                  << "       ./main page-encode <svofile> <outputfile> <pagesize = 32>\n"
+                  << "       ./main page-decode <inputfile> <svofile>\n"
+                  << "       ./main far-pointers <svofile> <outputfile> <bricksdepth = 0>\n"
+                  << "       ./main level-order <svofile> <outputfile> <bricksdepth = 0>\n"
+                  << "       ./main bootstrap <svofile> <outputfile> <depth = 6> <maxKB = 1024> <pagesize = 32> <bricksdepth = 0>\n"
+                  << "       ./main prefetch <svofile> <outputfile> <depth> <pages = 8> <pagesize = 32> <bricks = 0>\n"
+                  << "       ./main inspect <svofile> <pagesize = 32> <bricksdepth = 0>\n"
+                  << "       ./main merge <outputfile>\n"
+                  << "       ./main voxels-to-svo <voxelfile> <depth> <outputfile> <maxmemoryMB = 1024> <bricks = 0>\n"
+                  << "       ./main sortbench <voxels> <maxmemoryMB = 1024> <depth = 13> <build = 0>\n"
+                  << "       ./main overlapbench <depth = 9> <objfiles...>\n"
+                  << "       ./main benchmark <mindepth = 6> <maxdepth = 11> <outputname = benchmark> [--gpu] <objfiles...>\n"
+                  << "       ./main formatbench <svofile> <depth> <pagesize = 32> <bandwidthMbit = 100>\n"
+                  << "       ./main edit <svofile> <depth> <set|clear|recolor> <mortonbegin> <mortonend> <R G B A>\n"
+                  << "SVO files with --bricks are for offline use, the front-end doesn't render bricks\n";
         return 1;
     }
-    const char* input_path = argv[1];
-    const char* input_file_name = argv[2];
-    const unsigned int depth = std::stoi(argv[3]);
-    const char* output_file = argv[4];
+    const char* input_path = args[0];
+    const char* input_file_name = args[1];
+    const unsigned int depth = std::stoi(args[2]);
+    const char* output_file = args[3];
     bool optimize = false;
-    if (argc > 5){
-        optimize = (bool)std::stoi(argv[5]);
+    if (args.size() > 4){
+        optimize = (bool)std::stoi(args[4]);
     }
     bool fill = false;
-    if (argc > 6){
-        fill = (bool)std::stoi(argv[6]);
+    if (args.size() > 5){
+        fill = (bool)std::stoi(args[5]);
     }
     const unsigned int resolution = 1 << depth;             // res = pow(2,depth)
+    if (colorDelta && compressPages){
+        std::cout << "--color-delta and --compress-pages can't be combined, the pages are compressed\n";
+        colorDelta = false;
+    }
+    if (levelOrder && farPointers){
+        std::cout << "--level-order and --far-pointers can't be combined, the refer nodes are kept\n";
+        farPointers = false;
+    }
+    const bool paged = colorDelta || compressPages;
+    // codes the plain SVO page by page
+    const auto encodePages = [&](const char* svoFile, const char* outputFile){
+        if (colorDelta){
+            ColorDeltaCoder::encode(svoFile, outputFile, pageSize, bricks? depth : 0, farPointers? (std::string(output_file) + ".far").c_str() : "");
+        } else{
+            PageCoder::encode(svoFile, outputFile, pageSize);
+        }
+    };
+    // the plain SVO is built in a temporary file when it's converted afterwards
+    const bool converted = paged || farPointers || levelOrder;
+    const auto convertPlain = [&](const char* svoFile){
+        if (levelOrder){
+            const char* levelFile = paged? "tmp/tmp_SVO_levels" : output_file;
+            if (!LevelOrder::write(svoFile, levelFile, (std::string(output_file) + ".levels").c_str(), bricks? depth : 0)) return;
+            svoFile = levelFile;
+        }
+        if (farPointers){
+            const char* farFile = paged? "tmp/tmp_SVO_far" : output_file;
+            if (!FarPointers::convert(svoFile, farFile, (std::string(output_file) + ".far").c_str(), bricks? depth : 0)) return;
+            svoFile = farFile;
+        }
+        if (bootstrap){
+            // the bundle holds plain pages, the node numbers are the same in a paged file
+            BootstrapBundle::write(svoFile, (std::string(output_file) + ".boot").c_str(), farPointers? (std::string(output_file) + ".far").c_str() : "",
+                                   pageSize, bootstrapDepth, bootstrapSize, bricks? depth : 0);
+        }
+        if (prefetch){
+            PrefetchManifest::write(svoFile, (std::string(output_file) + ".prefetch").c_str(), farPointers? (std::string(output_file) + ".far").c_str() : "",
+                                    pageSize, prefetchEntries, depth, bricks);
+        }
+        if (paged){
+            encodePages(svoFile, output_file);
+        }
+    };
 
-    // create window
-    window = new Window(WINDOW_TITLE, 1, 1);
-    initGL();
+    // the nodes of the final plain SVO and the bytes of the output files, the temporary files are not counted
+    const auto countOutput = [&](const char* plainFile){
+        if (!Profiler::enabled()) return;
+        if (!optimize) Profiler::add(Profiler::NODES, fileSize(plainFile)/8);
+        const std::string output(output_file);
+        uint64_t bytes = fileSize(output);
+        if (levelOrder) bytes += fileSize(output + ".levels");
+        if (farPointers) bytes += fileSize(output + ".far");
+        if (bootstrap) bytes += fileSize(output + ".boot");
+        if (prefetch) bytes += fileSize(output + ".prefetch");
+        Profiler::add(Profiler::BYTES_WRITTEN, bytes);
+    };
 
-    // create SVOMaker
-    SVOmaker = new SVOMaker(resolution, fill);
+    // the buffers of the build are counted, a build that needs more than the max memory stops early
+    MemoryTracker::setBudget(maxMemory);
+
+    // time the stages of the build
+    if (profileFile != "" || traceFile != "" || hardwareCounters){
+        if (profileFile == "" && traceFile == "") profileFile = "profile.json";
+        Profiler::enable(hardwareCounters);
+    }
 
     // load model
     std::cout << "Loading model...\n";
     ModelLoader::Result model = ModelLoader::loadModel(input_path, input_file_name);
     std::cout << "Model loaded\n";
     
-    if (model.models.size() <= 0){
+    if (model.store->triangles.empty()){
         std::cerr << "Error loading model\n";
         return -1;
     }
 
+    if (cpu){
+        // voxelize on all cores without a window, only the plain format is supported
+        if (optimize){
+            std::cerr << "The optimized format is not supported with --cpu\n";
+            return 1;
+        }
+        if (fill){
+            std::cout << "Filling is not supported with --cpu, the model is not filled\n";
+        }
+        CpuSVOMaker cpuSVOMaker(model, bricks, maxMemory, totalThreads);
+        const char* svoFile = converted? "tmp/tmp_SVO_plain" : output_file;
+        bool built = true;
+        if (coarseToFine){
+            built = cpuSVOMaker.coarseToFineSvoFile(svoFile, depth);
+        } else{
+            built = cpuSVOMaker.modelToSvoFile(svoFile, depth);
+        }
+        if (!built){
+            std::cerr << "Error building the SVO\n";
+            return 1;
+        }
+        if (converted || bootstrap || prefetch){
+            convertPlain(svoFile);
+        }
+        countOutput(svoFile);
+        MemoryTracker::report();
+        Profiler::write(profileFile, traceFile);
+        return 0;
+    }
+
+    if (coarseToFine){
+        std::cout << "Coarse to fine is only supported with --cpu, the SVO is built brick by brick\n";
+    }
+
+    // create window
+    window = new Window(WINDOW_TITLE, 1, 1);
+    initGL();
+
+    // create SVOMaker
+    SVOmaker = new SVOMaker(resolution, fill, bricks, maxMemory);
+
     glm::vec3 offset(0,0,0);
     glm::vec3 size(1,1,1);
-    // splitsave(output_file, model, offset, size, depth, optimize);
+    bool built = true;
+    if ((farPointers || levelOrder || bootstrap || prefetch) && optimize){
+        std::cout << "Far pointers, the level order, the bootstrap bundle and the prefetch manifest are only used in the plain format\n";
+    }
+    if (converted && !optimize){
+        // create the plain SVO first, then convert it
+        built = splitsave("tmp/tmp_SVO_plain", model, offset, size, depth, optimize, colorBits, maxColorError);
+        if (built) convertPlain("tmp/tmp_SVO_plain");
+    } else{
+        // deep models are built octant by octant, the plain octant files are merged afterwards
+        built = splitsave(output_file, model, offset, size, depth, optimize, colorBits, maxColorError);
+        if (built && (bootstrap || prefetch) && !optimize){
+            convertPlain(output_file);
+        }
+    }
+    if (built){
+        countOutput(converted && !optimize? "tmp/tmp_SVO_plain" : output_file);
+    } else{
+        std::cerr << "Error building the SVO\n";
+    }
 
-    std::ofstream out(output_file, std::ios_base::binary);
-    SVOmaker->modelToSvoFile(out, offset, size, model.models[0], depth);
+    MemoryTracker::report();
+    Profiler::write(profileFile, traceFile);
 
     delete SVOmaker;
     delete window;
 
-    return 0;
+    return built? 0 : 1;
 }
\ No newline at end of file
@@ -0,0 +1,149 @@
+#include "meshcache.h"
+
+#include "../voxelizer/MappedFile.h"
+#include <iostream>
+#include <fstream>
+#include <sstream>
+#include <cstring>
+#include <cstdio>
+#include <algorithm>
+
+#define CACHE_MAGIC "SVOMESH3"
+#define HEADER_BYTES 48
+#define FNV_OFFSET 14695981039346656037ull
+#define FNV_PRIME 1099511628211ull
+
+static uint64_t fnv1a(uint64_t hash, const uint8_t* data, uint64_t size)
+{
+    for (uint64_t i = 0; i < size;++i){
+        hash ^= data[i];
+        hash *= FNV_PRIME;
+    }
+    return hash;
+}
+
+static uint64_t paddedSize(uint64_t size)
+{
+    return (size + 7) & ~(uint64_t)7;
+}
+
+uint64_t MeshCache::hashModel(const char* path, const char* filename)
+{
+    MappedFile obj((std::string(path) + filename).c_str());
+    if (!obj.isOpen()) return 0;
+
+    uint64_t hash = fnv1a(FNV_OFFSET, (const uint8_t*)CACHE_MAGIC, 8);
+    hash = fnv1a(hash, obj.data(), obj.size());
+
+    // add the MTL files named by the mtllib lines
+    const char* text = (const char*)obj.data();
+    const char* end = text + obj.size();
+    for (const char* line = text; line < end;){
+        const char* lineEnd = std::find(line, end, '\n');
+        if (lineEnd - line < 7 || strncmp(line, "mtllib ", 7) != 0){
+            line = lineEnd + 1;
+            continue;
+        }
+
+        std::istringstream names(std::string(line + 7, lineEnd));
+        line = lineEnd + 1;
+        std::string name;
+        while (names >> name){
+            MappedFile mtl((std::string(path) + name).c_str());
+            hash = fnv1a(hash, (const uint8_t*)name.c_str(), name.size());
+            if (mtl.isOpen()) hash = fnv1a(hash, mtl.data(), mtl.size());
+        }
+    }
+    return hash;
+}
+
+std::string MeshCache::cacheFile(uint64_t hash)
+{
+    char name[32];
+    snprintf(name, sizeof(name), "%016llx", (unsigned long long)hash);
+    return std::string("tmp/mesh_") + name + ".cache";
+}
+
+bool MeshCache::load(const char* cacheFile, uint64_t hash, const char* path, TriangleStore& store)
+{
+    MappedFile file(cacheFile);
+    if (!file.isOpen() || file.size() < HEADER_BYTES) return false;
+
+    const uint8_t* data = file.data();
+    uint64_t header[5];
+    memcpy(header, data + 8, sizeof(header));
+    if (memcmp(data, CACHE_MAGIC, 8) != 0 || header[0] != hash) return false;
+    const uint64_t totalPositions = header[1];
+    const uint64_t totalNormals = header[2];
+    const uint64_t totalTriangles = header[3];
+    const uint64_t totalMaterials = header[4];
+    if (totalPositions > file.size() || totalNormals > file.size() || totalTriangles > file.size() || totalMaterials > file.size()/16) return false;
+
+    // materials: <diffuse:3 floats><name length:32><texture name padded to 8 bytes>
+    uint64_t pos = HEADER_BYTES;
+    TriangleStore loaded;
+    loaded.materials.resize(totalMaterials);
+    for (uint64_t i = 0; i < totalMaterials;++i){
+        if (pos + 16 > file.size()) return false;
+        uint32_t nameLength;
+        memcpy(loaded.materials[i].diffuse, data + pos, 12);
+        memcpy(&nameLength, data + pos + 12, 4);
+        pos += 16;
+        if (pos + paddedSize(nameLength) > file.size()) return false;
+
+        const std::string name((const char*)data + pos, nameLength);
+        loaded.materials[i].textureFile = name == ""? "" : path + name;
+        pos += paddedSize(nameLength);
+    }
+
+    // the arrays of the store
+    const uint64_t positionBytes = 3*totalPositions*sizeof(float);
+    const uint64_t normalBytes = 3*totalNormals*sizeof(float);
+    const uint64_t triangleBytes = totalTriangles*sizeof(TriangleStore::Triangle);
+    if (pos + paddedSize(positionBytes) + paddedSize(normalBytes) + triangleBytes != file.size()) return false;
+    loaded.positions.resize(3*totalPositions);
+    memcpy(loaded.positions.data(), data + pos, positionBytes);
+    pos += paddedSize(positionBytes);
+    loaded.normals.resize(3*totalNormals);
+    memcpy(loaded.normals.data(), data + pos, normalBytes);
+    pos += paddedSize(normalBytes);
+    loaded.triangles.resize(totalTriangles);
+    memcpy(loaded.triangles.data(), data + pos, triangleBytes);
+
+    store = std::move(loaded);
+    return true;
+}
+
+void MeshCache::save(const char* cacheFile, uint64_t hash, const char* path, const TriangleStore& store)
+{
+    std::ofstream out(cacheFile, std::ios::binary | std::ios::out);
+    if (!out.is_open()){
+        std::cout << "Failed to create mesh cache " << cacheFile << "\n";
+        return;
+    }
+
+    out.write(CACHE_MAGIC, 8);
+    const uint64_t header[5] = {hash, store.positions.size()/3, store.normals.size()/3, store.triangles.size(), store.materials.size()};
+    out.write((const char*)header, sizeof(header));
+    const char padding[8] = {0};
+    for (unsigned int i = 0; i < store.materials.size();++i){
+        // texture names are stored without the model path
+        std::string name = store.materials[i].textureFile;
+        if (name.compare(0, strlen(path), path) == 0) name = name.substr(strlen(path));
+
+        const uint32_t nameLength = name.size();
+        out.write((const char*)store.materials[i].diffuse, 12);
+        out.write((const char*)&nameLength, 4);
+        out.write(name.c_str(), name.size());
+        out.write(padding, paddedSize(name.size()) - name.size());
+    }
+
+    const uint64_t positionBytes = store.positions.size()*sizeof(float);
+    const uint64_t normalBytes = store.normals.size()*sizeof(float);
+    out.write((const char*)store.positions.data(), positionBytes);
+    out.write(padding, paddedSize(positionBytes) - positionBytes);
+    out.write((const char*)store.normals.data(), normalBytes);
+    out.write(padding, paddedSize(normalBytes) - normalBytes);
+    out.write((const char*)store.triangles.data(), store.triangles.size()*sizeof(TriangleStore::Triangle));
+    std::cout << "Mesh cache saved in " << cacheFile << "\n";
+}
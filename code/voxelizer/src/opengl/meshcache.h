@@ -0,0 +1,29 @@
+#ifndef MESHCACHE_H
+#define MESHCACHE_H
+
+#include <string>
+#include <cstdint>
+#include "trianglestore.h"
+
+// Binary cache of loaded models: the triangle store with normalized positions, so later runs read
+// the cache file instead of parsing the OBJ text. The file is memory mapped and every array is
+// copied into the store with one memcpy, the store owns its data and the mapping is closed after
+// the load. The cache file is named after an FNV-1a hash of the OBJ file and its MTL files, a
+// changed model gets a new cache file.
+//
+// Cache file: <magic:8 bytes><hash:64><positions:64><normals:64><triangles:64><materials:64>,
+// the materials, then the positions, normals and triangles of the store, every part padded to
+// 8 bytes. The numbers are stored in the byte order of the machine, the cache is not meant to be
+// shared between machines.
+class MeshCache
+{
+public:
+    // 0 if the OBJ file can't be read
+    static uint64_t hashModel(const char* path, const char* filename);
+    static std::string cacheFile(uint64_t hash);
+
+    static bool load(const char* cacheFile, uint64_t hash, const char* path, TriangleStore& store);
+    static void save(const char* cacheFile, uint64_t hash, const char* path, const TriangleStore& store);
+};
+
+#endif
@@ -1,8 +1,16 @@
 #include "modelloader.h"
+#include "meshcache.h"
+#include "../voxelizer/MappedFile.h"
+#include "../voxelizer/Profiler.h"
 
 #include <iostream>
+#include <fstream>
+#include <sstream>
 #include <algorithm>
 #include <map>
+#include <cfloat>
+#include <cstdlib>
+#include <cstring>
 
 #define TINYOBJLOADER_IMPLEMENTATION
 #include <tiny_obj_loader.h>
@@ -11,138 +19,202 @@
 #include <glm/gtc/type_ptr.hpp>
 
 
-ModelLoader::Result ModelLoader::loadModel(const char* path, const char* filename)
+// the line at pos without the line end, pos moves to the next line
+static void nextLine(const char*& pos, const char* end, std::string& line)
 {
-    std::map<std::string, std::vector<Vertex>> models;
-    std::string activeTex = "";
+    const char* lineEnd = std::find(pos, end, '\n');
+    line.assign(pos, lineEnd);
+    if (!line.empty() && line.back() == '\r') line.pop_back();
+    pos = lineEnd < end? lineEnd + 1 : end;
+}
 
-    tinyobj::attrib_t attrib;
-    std::vector<tinyobj::shape_t> shapes;
-    std::vector<tinyobj::material_t> materials;
+static bool startsWith(const std::string& line, const char* prefix)
+{
+    return line.compare(0, strlen(prefix), prefix) == 0;
+}
 
-    std::string warn;
-    std::string err;
+// index of an OBJ index, negative indices count from the last element, -1 if there is no index
+static int64_t objIndex(long index, uint64_t total)
+{
+    if (index > 0) return index - 1;
+    if (index < 0) return (int64_t)total + index;
+    return -1;
+}
 
-    bool ret = tinyobj::LoadObj(&attrib, &shapes, &materials, &warn, &err, (std::string(path) + filename).c_str(), path);
+ModelLoader::Result ModelLoader::loadModel(const char* path, const char* filename)
+{
+    Profiler::Scope scope("load model");
+    const uint64_t hash = MeshCache::hashModel(path, filename);
+    const std::string cacheFile = MeshCache::cacheFile(hash);
 
-    if (!warn.empty())
-    {
-        std::cout << warn << std::endl;
-    }
-    if (!err.empty())
-    {
-        std::cerr << err << std::endl;
+    Result result;
+    result.store = std::make_shared<TriangleStore>();
+    if (hash != 0 && MeshCache::load(cacheFile.c_str(), hash, path, *result.store)){
+        std::cout << "Model loaded from mesh cache " << cacheFile << "\n";
+    } else{
+        result.store = loadObj(path, filename);
+        if (hash != 0 && !result.store->triangles.empty()){
+            MeshCache::save(cacheFile.c_str(), hash, path, *result.store);
+        }
     }
-    if (!ret)
+    result.mesh = MeshView{result.store.get(), 0, result.store->triangles.size()};
+    return result;
+}
+
+std::shared_ptr<TriangleStore> ModelLoader::loadObj(const char* path, const char* filename)
+{
+    // the OBJ file is streamed from a mapping, only the indexed mesh is kept in memory
+    MappedFile obj((std::string(path) + filename).c_str());
+    if (!obj.isOpen())
     {
+        std::cerr << "Failed to open " << path << filename << std::endl;
         exit(1);
     }
+    const char* begin = (const char*)obj.data();
+    const char* end = begin + obj.size();
+    std::string line;
+
+    // first pass: the size of every array
+    uint64_t totalPositions = 0, totalNormals = 0, totalTexcoords = 0, totalFaces = 0;
+    for (const char* pos = begin; pos < end;){
+        nextLine(pos, end, line);
+        if (startsWith(line, "v ")){
+            totalPositions += 1;
+        } else if (startsWith(line, "vn ")){
+            totalNormals += 1;
+        } else if (startsWith(line, "vt ")){
+            totalTexcoords += 1;
+        } else if (startsWith(line, "f ")){
+            totalFaces += 1;
+        }
+    }
 
-    // Loop over shapes
-    for (size_t s = 0; s < shapes.size(); s++)
-    {
-        // Loop over faces(polygon)
-        size_t index_offset = 0;
-        for (size_t f = 0; f < shapes[s].mesh.num_face_vertices.size(); f++)
-        {
-            int fv = shapes[s].mesh.num_face_vertices[f];
-
-            Vertex v0;
-            Vertex v1;
-
-            // Loop over vertices in the face.
-            for (size_t v = 0; v < fv; v++)
-            {
-                // access to vertex
-                tinyobj::index_t idx = shapes[s].mesh.indices[index_offset + v];
-                tinyobj::real_t vx = attrib.vertices[3 * idx.vertex_index + 0];
-                tinyobj::real_t vy = attrib.vertices[3 * idx.vertex_index + 1];
-                tinyobj::real_t vz = attrib.vertices[3 * idx.vertex_index + 2];
-
-                tinyobj::real_t nx = 0;
-                tinyobj::real_t ny = 0;
-                tinyobj::real_t nz = 0;
-                if (idx.normal_index >= 0) {
-                    nx = attrib.normals[3 * idx.normal_index + 0];
-                    ny = attrib.normals[3 * idx.normal_index + 1];
-                    nz = attrib.normals[3 * idx.normal_index + 2];
-                }
-                tinyobj::real_t tx = 0;
-                tinyobj::real_t ty = 0;
-                if (idx.texcoord_index >= 0){
-                    tx = attrib.texcoords[2 * idx.texcoord_index + 0];
-                    ty = attrib.texcoords[2 * idx.texcoord_index + 1];
+    std::shared_ptr<TriangleStore> store = std::make_shared<TriangleStore>();
+    store->positions.reserve(3*totalPositions);
+    store->normals.reserve(3*totalNormals);
+    store->triangles.reserve(totalFaces);
+    std::vector<float> texcoords;
+    texcoords.reserve(2*totalTexcoords);
+
+    // second pass: positions and triangulated faces
+    std::map<std::string, int> materialMap;
+    int material = -1;
+    int defaultMaterial = -1;
+    struct Corner{ int64_t position, texcoord, normal; };
+    std::vector<Corner> corners;
+    for (const char* pos = begin; pos < end;){
+        nextLine(pos, end, line);
+        if (startsWith(line, "v ")){
+            char* next = &line[2];
+            for (unsigned int a = 0; a < 3;++a) store->positions.push_back(strtof(next, &next));
+        } else if (startsWith(line, "vn ")){
+            char* next = &line[3];
+            for (unsigned int a = 0; a < 3;++a) store->normals.push_back(strtof(next, &next));
+        } else if (startsWith(line, "vt ")){
+            char* next = &line[3];
+            for (unsigned int a = 0; a < 2;++a) texcoords.push_back(strtof(next, &next));
+        } else if (startsWith(line, "f ")){
+            // corners as position/texcoord/normal, the texcoord and normal are optional
+            corners.clear();
+            char* next = &line[2];
+            while (true){
+                char* start = next;
+                const long p = strtol(start, &next, 10);
+                if (next == start) break;
+                long t = 0, n = 0;
+                if (*next == '/'){
+                    next += 1;
+                    if (*next != '/') t = strtol(next, &next, 10);
+                    if (*next == '/'){
+                        next += 1;
+                        n = strtol(next, &next, 10);
+                    }
                 }
-                // tinyobj::real_t red = attrib.colors[3 * idx.vertex_index + 0];
-                // tinyobj::real_t green = attrib.colors[3 * idx.vertex_index + 1];
-                // tinyobj::real_t blue = attrib.colors[3 * idx.vertex_index + 2];
-
-
-                int mat_id = shapes[s].mesh.material_ids[f];
-                tinyobj::real_t diffuse_r = 1;
-                tinyobj::real_t diffuse_g = 1;
-                tinyobj::real_t diffuse_b = 1;
+                corners.push_back({objIndex(p, store->positions.size()/3), objIndex(t, texcoords.size()/2), objIndex(n, store->normals.size()/3)});
+            }
 
-                if (mat_id >= 0){
-                    diffuse_r = materials[mat_id].diffuse[0];
-                    diffuse_g = materials[mat_id].diffuse[1];
-                    diffuse_b = materials[mat_id].diffuse[2];
-                    activeTex = materials[mat_id].diffuse_texname;
+            if (material < 0){
+                if (defaultMaterial < 0){
+                    defaultMaterial = store->materials.size();
+                    store->materials.push_back(TriangleStore::Material());
                 }
-    
-                Vertex vertex{{vx,vy,vz},{diffuse_r, diffuse_g, diffuse_b, 1}, {tx,ty}, {nx,ny,nz}};
-
-                if (v ==0) v0 = vertex;
-                if (v == 1) v1 = vertex;
+                material = defaultMaterial;
+            }
 
-                // triangulate mesh
-                if (v > 2){
-                    models[activeTex].push_back(v0);
-                    models[activeTex].push_back(v1);
+            // triangulate the face as a fan
+            for (unsigned int c = 2; c < corners.size();++c){
+                const Corner faceCorners[3] = {corners[0], corners[c - 1], corners[c]};
+                TriangleStore::Triangle triangle;
+                bool valid = true;
+                for (unsigned int v = 0; v < 3;++v){
+                    const Corner& corner = faceCorners[v];
+                    valid = valid && corner.position >= 0 && (uint64_t)corner.position < store->positions.size()/3;
+                    triangle.position[v] = corner.position;
+                    triangle.normal[v] = corner.normal >= 0 && (uint64_t)corner.normal < store->normals.size()/3? corner.normal : TriangleStore::NO_NORMAL;
+                    const bool hasTexcoord = corner.texcoord >= 0 && (uint64_t)corner.texcoord < texcoords.size()/2;
+                    triangle.texcoord[v][0] = TriangleStore::toHalf(hasTexcoord? texcoords[2*corner.texcoord] : 0);
+                    triangle.texcoord[v][1] = TriangleStore::toHalf(hasTexcoord? texcoords[2*corner.texcoord + 1] : 0);
+                }
+                triangle.material = material;
+                if (valid) store->triangles.push_back(triangle);
+            }
+        } else if (startsWith(line, "usemtl ")){
+            std::string name;
+            std::istringstream(line.substr(7)) >> name;
+            material = materialMap.count(name) > 0? materialMap[name] : -1;
+        } else if (startsWith(line, "mtllib ")){
+            std::istringstream names(line.substr(7));
+            std::string name;
+            while (names >> name){
+                std::ifstream mtl(std::string(path) + name);
+                if (!mtl.is_open()){
+                    std::cout << "Material file " << path << name << " not found\n";
+                    continue;
                 }
 
-                models[activeTex].push_back(vertex);
+                std::map<std::string, int> fileMap;
+                std::vector<tinyobj::material_t> fileMaterials;
+                std::string warn;
+                std::string err;
+                tinyobj::LoadMtl(&fileMap, &fileMaterials, &mtl, &warn, &err);
+                if (!warn.empty()) std::cout << warn << std::endl;
+                if (!err.empty()) std::cerr << err << std::endl;
+
+                for (auto it = fileMap.begin(); it != fileMap.end(); ++it){
+                    const tinyobj::material_t& m = fileMaterials[it->second];
+                    TriangleStore::Material storeMaterial;
+                    storeMaterial.diffuse[0] = m.diffuse[0];
+                    storeMaterial.diffuse[1] = m.diffuse[1];
+                    storeMaterial.diffuse[2] = m.diffuse[2];
+                    storeMaterial.textureFile = m.diffuse_texname == ""? "" : path + m.diffuse_texname;
+                    materialMap[it->first] = store->materials.size();
+                    store->materials.push_back(storeMaterial);
+                }
             }
-            index_offset += fv;
         }
     }
 
-    if (models.begin() == models.end()) return Result{};
-
-    // find min and max point
-    glm::vec3 minPoint = {models.begin()->second[0].XYZ[0], models.begin()->second[0].XYZ[1], models.begin()->second[0].XYZ[2]};
-    glm::vec3 maxPoint = glm::vec3(minPoint);
-    for (auto m = models.begin(); m != models.end(); m++){
-        for (unsigned int i = 0; i < m->second.size();++i){
-            minPoint.x = std::min(m->second[i].XYZ[0], minPoint.x);
-            minPoint.y = std::min(m->second[i].XYZ[1], minPoint.y);
-            minPoint.z = std::min(m->second[i].XYZ[2], minPoint.z);
-
-            maxPoint.x = std::max(m->second[i].XYZ[0], maxPoint.x);
-            maxPoint.y = std::max(m->second[i].XYZ[1], maxPoint.y);
-            maxPoint.z = std::max(m->second[i].XYZ[2], maxPoint.z);
+    // normalize with the bounding box of the positions of the triangles, positions no face uses don't count
+    glm::vec3 minPoint(FLT_MAX);
+    glm::vec3 maxPoint(-FLT_MAX);
+    for (const TriangleStore::Triangle& triangle : store->triangles){
+        for (unsigned int v = 0; v < 3;++v){
+            const float* p = &store->positions[3*(uint64_t)triangle.position[v]];
+            minPoint = glm::min(minPoint, glm::vec3(p[0], p[1], p[2]));
+            maxPoint = glm::max(maxPoint, glm::vec3(p[0], p[1], p[2]));
         }
     }
-
-
+    if (store->triangles.empty()) minPoint = maxPoint = glm::vec3(0);
     glm::vec3 diff = maxPoint - minPoint;
     float dMax = std::max(std::max(diff.x, diff.y), diff.z);
-    
-    // normalize vertices
-    for (auto m = models.begin(); m != models.end(); m++){
-        for (unsigned int i = 0; i < m->second.size();++i){
-            m->second[i].XYZ[0] = (m->second[i].XYZ[0] - minPoint.x)/dMax;
-            m->second[i].XYZ[1] = (m->second[i].XYZ[1] - minPoint.y)/dMax;
-            m->second[i].XYZ[2] = 1-(m->second[i].XYZ[2] - minPoint.z)/dMax;
-        }
+    if (dMax <= 0) dMax = 1;
+    for (uint64_t i = 0; i < store->positions.size();i+=3){
+        store->positions[i] = (store->positions[i] - minPoint.x)/dMax;
+        store->positions[i + 1] = (store->positions[i + 1] - minPoint.y)/dMax;
+        store->positions[i + 2] = 1-(store->positions[i + 2] - minPoint.z)/dMax;
     }
 
-    Result result;
-    for (auto i = models.begin(); i != models.end(); i++){
-        Model m;
-        m.textureFile = i->first == ""? "" : path + i->first;
-        m.vertices = i->second;
-        result.models.push_back(m);
-    }
-    return result;
-}
\ No newline at end of file
+    std::cout << "Model: " << store->triangles.size() << " triangles, " << store->positions.size()/3 << " positions, "
+              << store->materials.size() << " materials, " << store->memoryUsage()/(1024*1024) << " MB\n";
+    return store;
+}
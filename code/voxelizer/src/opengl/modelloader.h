@@ -3,22 +3,23 @@
 
 #include <vector>
 #include <string>
+#include <memory>
 #include "vertex.h"
+#include "trianglestore.h"
 
 class ModelLoader
 {
 public:
-    struct Model{
-        std::vector<Vertex> vertices = {};
-        std::string textureFile = "";
-    };
     struct  Result
     {
-        std::vector<Model> models;
+        std::shared_ptr<TriangleStore> store;
+        MeshView mesh;                  // all triangles
     };
-    
+
+    // the parsed model is kept in a binary mesh cache, later loads of the same OBJ and MTL files read the cache
     static Result loadModel(const char* path, const char* filename);
 private:
+    static std::shared_ptr<TriangleStore> loadObj(const char* path, const char* filename);
 };
 
-#endif
\ No newline at end of file
+#endif
@@ -0,0 +1,119 @@
+#include "texturearray.h"
+#include <iostream>
+#include <map>
+#include <string>
+#include <algorithm>
+#include <cmath>
+#include <GL/glew.h>
+#include "../voxelizer/TexelCache.h"
+
+#define MAX_LAYER_SIZE 4096
+
+typedef TexelCache::Image Image;
+
+// bilinear resize, the texture repeats at the edges like the sampler
+static std::vector<uint8_t> resize(const Image& image, int width, int height)
+{
+    std::vector<uint8_t> result(4*(uint64_t)width*height);
+    for (int y = 0; y < height;++y){
+        const float sy = (y + 0.5f)*image.height/height - 0.5f;
+        const int y0 = (int)std::floor(sy);
+        const float fy = sy - y0;
+        const int rows[2] = {(y0 + image.height) % image.height, (y0 + 1) % image.height};
+        for (int x = 0; x < width;++x){
+            const float sx = (x + 0.5f)*image.width/width - 0.5f;
+            const int x0 = (int)std::floor(sx);
+            const float fx = sx - x0;
+            const int columns[2] = {(x0 + image.width) % image.width, (x0 + 1) % image.width};
+            for (int c = 0; c < 4;++c){
+                float value = 0;
+                for (int j = 0; j < 2;++j){
+                    for (int i = 0; i < 2;++i){
+                        const float weight = (i? fx : 1 - fx)*(j? fy : 1 - fy);
+                        value += weight*image.rgba[4*((uint64_t)rows[j]*image.width + columns[i]) + c];
+                    }
+                }
+                result[4*((uint64_t)y*width + x) + c] = (uint8_t)std::min(value + 0.5f, 255.f);
+            }
+        }
+    }
+    return result;
+}
+
+TextureArray::TextureArray(const TriangleStore& store)
+{
+    static uint64_t generations = 0;
+    _generation = ++generations;
+
+    // decode every texture file once, all files on all cores
+    std::map<std::string, int> files;
+    std::vector<std::string> fileNames;
+    std::vector<int> materialFiles;
+    for (unsigned int i = 0; i < store.materials.size();++i){
+        const std::string& file = store.materials[i].textureFile;
+        int index = -1;
+        if (file != "" && files.count(file) > 0){
+            index = files[file];
+        } else if (file != ""){
+            std::cout << " Loading texture: " << file << "\n";
+            index = fileNames.size();
+            files[file] = index;
+            fileNames.push_back(file);
+        }
+        materialFiles.push_back(index);
+    }
+    std::vector<Image> decoded = TexelCache::decode(fileNames);
+
+    // a layer for every file that was decoded
+    std::vector<int> fileLayers(decoded.size(), -1);
+    std::vector<Image> images;
+    for (unsigned int i = 0; i < decoded.size();++i){
+        if (decoded[i].width == 0) continue;
+        fileLayers[i] = images.size();
+        images.push_back(std::move(decoded[i]));
+    }
+    for (unsigned int i = 0; i < materialFiles.size();++i){
+        _materialLayers.push_back(materialFiles[i] < 0? -1 : fileLayers[materialFiles[i]]);
+    }
+    _totalLayers = images.size();
+    if (_totalLayers == 0) return;
+
+    // every layer has the size of the largest texture
+    int width = 1, height = 1;
+    for (unsigned int i = 0; i < images.size();++i){
+        width = std::max(width, images[i].width);
+        height = std::max(height, images[i].height);
+    }
+    width = std::min(width, MAX_LAYER_SIZE);
+    height = std::min(height, MAX_LAYER_SIZE);
+    std::cout << " Texture array: " << _totalLayers << " layers of " << width << "x" << height << "\n";
+
+    glGenTextures(1, &_tex);
+    glBindTexture(GL_TEXTURE_2D_ARRAY, _tex);
+    glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+    glTexImage3D(GL_TEXTURE_2D_ARRAY, 0, GL_RGBA8, width, height, _totalLayers, 0, GL_RGBA, GL_UNSIGNED_BYTE, nullptr);
+    for (unsigned int i = 0; i < images.size();++i){
+        if (images[i].width == width && images[i].height == height){
+            glTexSubImage3D(GL_TEXTURE_2D_ARRAY, 0, 0, 0, i, width, height, 1, GL_RGBA, GL_UNSIGNED_BYTE, images[i].rgba.data());
+        } else{
+            const std::vector<uint8_t> resized = resize(images[i], width, height);
+            glTexSubImage3D(GL_TEXTURE_2D_ARRAY, 0, 0, 0, i, width, height, 1, GL_RGBA, GL_UNSIGNED_BYTE, resized.data());
+        }
+    }
+    glGenerateMipmap(GL_TEXTURE_2D_ARRAY);
+    glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
+    glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+    glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_WRAP_S, GL_REPEAT);
+    glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_WRAP_T, GL_REPEAT);
+}
+
+TextureArray::~TextureArray()
+{
+    glDeleteTextures(1, &_tex);
+}
+
+void TextureArray::bind(unsigned int slot)
+{
+    glActiveTexture(GL_TEXTURE0 + slot);
+    glBindTexture(GL_TEXTURE_2D_ARRAY, _tex);
+}
@@ -0,0 +1,32 @@
+#ifndef TEXTUREARRAY_H
+#define TEXTUREARRAY_H
+
+#include <vector>
+#include <cstdint>
+#include "trianglestore.h"
+
+// All textures of the materials of a model in one 2D texture array, so every material is
+// voxelized in the same draw. Every texture file is one layer, textures with another size than
+// the largest texture are resized to it.
+class TextureArray
+{
+public:
+    TextureArray(const TriangleStore& store);
+    ~TextureArray();
+
+    void bind(unsigned int slot);
+
+    // layer of the texture of every material, -1 is no texture
+    const std::vector<int>& materialLayers() const { return _materialLayers; }
+    unsigned int totalLayers() const { return _totalLayers; }
+    // new for every array, like TriangleStore::generation
+    uint64_t generation() const { return _generation; }
+
+private:
+    unsigned int _tex = 0;
+    unsigned int _totalLayers = 0;
+    std::vector<int> _materialLayers;
+    uint64_t _generation;
+};
+
+#endif
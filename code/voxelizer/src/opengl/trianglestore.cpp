@@ -0,0 +1,52 @@
+#include "trianglestore.h"
+
+#include <atomic>
+#include <glm/gtc/packing.hpp>
+
+Vertex TriangleStore::vertex(const Triangle& triangle, unsigned int corner) const
+{
+    const Material& material = materials[triangle.material];
+    const float* position = &positions[3*(uint64_t)triangle.position[corner]];
+
+    Vertex v{{position[0], position[1], position[2]}, {material.diffuse[0], material.diffuse[1], material.diffuse[2], 1},
+             {fromHalf(triangle.texcoord[corner][0]), fromHalf(triangle.texcoord[corner][1])}, {0, 0, 0}, -1};
+    if (triangle.normal[corner] != NO_NORMAL){
+        const float* normal = &normals[3*(uint64_t)triangle.normal[corner]];
+        v.normal[0] = normal[0];
+        v.normal[1] = normal[1];
+        v.normal[2] = normal[2];
+    }
+    return v;
+}
+
+uint64_t TriangleStore::memoryUsage() const
+{
+    return positions.capacity()*sizeof(float) + normals.capacity()*sizeof(float) +
+           triangles.capacity()*sizeof(Triangle) + materials.capacity()*sizeof(Material);
+}
+
+uint16_t TriangleStore::toHalf(float value)
+{
+    return glm::packHalf1x16(value);
+}
+
+float TriangleStore::fromHalf(uint16_t value)
+{
+    return glm::unpackHalf1x16(value);
+}
+
+uint64_t TriangleStore::nextGeneration()
+{
+    static std::atomic<uint64_t> generations{0};
+    return ++generations;
+}
+
+void MeshView::vertices(uint64_t first, uint64_t count, Vertex* out) const
+{
+    for (uint64_t i = 0; i < count;++i){
+        const TriangleStore::Triangle& t = triangle(first + i);
+        out[3*i] = store->vertex(t, 0);
+        out[3*i + 1] = store->vertex(t, 1);
+        out[3*i + 2] = store->vertex(t, 2);
+    }
+}
@@ -0,0 +1,59 @@
+#ifndef TRIANGLESTORE_H
+#define TRIANGLESTORE_H
+
+#include <vector>
+#include <string>
+#include <cstdint>
+#include "vertex.h"
+
+// Indexed, compact storage of a triangle mesh: a triangle refers to shared positions and normals
+// and stores its texture coordinates as half floats and its material as an index, 40 bytes per
+// triangle instead of 3 vertices of 48 bytes.
+class TriangleStore
+{
+public:
+    struct Triangle{
+        uint32_t position[3];
+        uint32_t normal[3];         // NO_NORMAL if the OBJ file has no normal
+        uint16_t texcoord[3][2];    // half floats
+        uint32_t material;
+    };
+    struct Material{
+        float diffuse[3] = {1, 1, 1};
+        std::string textureFile = "";
+    };
+
+    static const uint32_t NO_NORMAL = 0xffffffff;
+
+    std::vector<float> positions;   // x y z of every position
+    std::vector<float> normals;     // x y z of every normal
+    std::vector<Triangle> triangles;
+    std::vector<Material> materials;
+    // new for every store, caches key on it because a new store can get the address of a freed one
+    uint64_t generation = nextGeneration();
+
+    // the corner of a triangle as an interleaved vertex, like the vertex buffers of the voxelizer
+    Vertex vertex(const Triangle& triangle, unsigned int corner) const;
+
+    uint64_t memoryUsage() const;
+
+    static uint16_t toHalf(float value);
+    static float fromHalf(uint16_t value);
+
+private:
+    static uint64_t nextGeneration();
+};
+
+// Non-owning view of consecutive triangles of a store, the store must outlive the view.
+struct MeshView{
+    const TriangleStore* store = nullptr;
+    uint64_t firstTriangle = 0;
+    uint64_t totalTriangles = 0;
+
+    const TriangleStore::Triangle& triangle(uint64_t i) const { return store->triangles[firstTriangle + i]; }
+
+    // writes the 3 vertices of the triangles [first, first + count) of the view
+    void vertices(uint64_t first, uint64_t count, Vertex* out) const;
+};
+
+#endif
@@ -7,6 +7,7 @@ typedef struct
     float RGBA[4];
     float Texcoord[2];
     float normal[3];
+    float textureLayer;     // layer in the texture array, -1 is no texture
 } Vertex;
 
 #endif
\ No newline at end of file
@@ -0,0 +1,75 @@
+#include "AsyncWriter.h"
+
+AsyncWriter::AsyncWriter(const char* file, size_t blockSize, unsigned int totalBlocks)
+    : _out(file, std::ios::binary | std::ios::out), _blockSize{blockSize},
+      _fullBlocks(totalBlocks), _emptyBlocks(totalBlocks)
+{
+    for (unsigned int i = 1; i < totalBlocks;++i){
+        _emptyBlocks.push(std::vector<char>(_blockSize));
+    }
+    _block.resize(_blockSize);
+    setp(_block.data(), _block.data() + _block.size());
+
+    _writer = std::thread(&AsyncWriter::writeBlocks, this);
+}
+
+AsyncWriter::~AsyncWriter()
+{
+    close();
+}
+
+bool AsyncWriter::close()
+{
+    if (!_closed){
+        _closed = true;
+        sendBlock();
+        _fullBlocks.close();
+        _writer.join();
+        _out.close();
+        if (!_out) _failed = true;
+    }
+    return !_failed;
+}
+
+AsyncWriter::int_type AsyncWriter::overflow(int_type c)
+{
+    sendBlock();
+    if (_failed) return traits_type::eof();
+    if (!traits_type::eq_int_type(c, traits_type::eof())){
+        *pptr() = traits_type::to_char_type(c);
+        pbump(1);
+    }
+    return traits_type::not_eof(c);
+}
+
+int AsyncWriter::sync()
+{
+    sendBlock();
+    return _failed? -1 : 0;
+}
+
+void AsyncWriter::sendBlock()
+{
+    const size_t size = pptr() - pbase();
+    if (size == 0) return;
+
+    // send the filled part of the block and continue in an empty block
+    _block.resize(size);
+    _fullBlocks.push(std::move(_block));
+    _emptyBlocks.pop(_block);
+    _block.resize(_blockSize);
+    setp(_block.data(), _block.data() + _block.size());
+}
+
+void AsyncWriter::writeBlocks()
+{
+    std::vector<char> block;
+    while (_fullBlocks.pop(block)){
+        // after a failed write the blocks only go back, so the producer doesn't wait forever
+        if (!_failed){
+            _out.write(block.data(), block.size());
+            if (!_out) _failed = true;
+        }
+        _emptyBlocks.push(std::move(block));
+    }
+}
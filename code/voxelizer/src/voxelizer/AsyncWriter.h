@@ -0,0 +1,44 @@
+#ifndef ASYNCWRITER_H
+#define ASYNCWRITER_H
+
+#include <fstream>
+#include <streambuf>
+#include <thread>
+#include <atomic>
+#include <vector>
+#include "SPSCQueue.h"
+
+// Stream buffer that writes a file on its own thread. Full blocks go to the writer thread
+// through a bounded queue and come back empty through a second queue, so at most totalBlocks
+// blocks are in memory and the producer waits when the disk can't keep up.
+// Use it with std::ostream out(&writer). A failed write (full disk, I/O error) sets badbit on the
+// stream and close() returns false, the remaining blocks are dropped.
+class AsyncWriter : public std::streambuf
+{
+public:
+    AsyncWriter(const char* file, size_t blockSize = 1 << 22, unsigned int totalBlocks = 4);
+    ~AsyncWriter();
+
+    bool is_open() const { return _out.is_open(); }
+    // writes the remaining data and waits for the writer thread, false if a write failed
+    bool close();
+
+protected:
+    int_type overflow(int_type c) override;
+    int sync() override;
+
+private:
+    void sendBlock();
+    void writeBlocks();
+
+    std::ofstream _out;
+    size_t _blockSize;
+    std::vector<char> _block;
+    SPSCQueue<std::vector<char>> _fullBlocks;
+    SPSCQueue<std::vector<char>> _emptyBlocks;
+    std::thread _writer;
+    bool _closed = false;
+    std::atomic<bool> _failed{false};
+};
+
+#endif
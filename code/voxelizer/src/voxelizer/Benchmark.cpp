@@ -0,0 +1,264 @@
+#include "Benchmark.h"
+#include "CpuVoxelizer.h"
+#include "CpuSVOMaker.h"
+#include "TaskScheduler.h"
+#include "MemoryTracker.h"
+#include "ofcSVO.h"
+#include "SVO.h"
+#include "SVOSaver.h"
+#include "voxelizer.h"
+#include "../opengl/texturearray.h"
+#include "../opengl/meshcache.h"
+
+#include <iostream>
+#include <fstream>
+#include <chrono>
+#include <algorithm>
+#include <functional>
+#include <numeric>
+#include <iomanip>
+#include <cstdio>
+
+#define BRICK_SIZE 128          // voxels per side of the bricks of the CPU voxelize stage
+#define LEGACY_MAX_DEPTH 10     // the in memory SVO of deeper models doesn't fit in memory
+#define GPU_MAX_DEPTH 10        // the GPU voxelizes in one voxel image of at most 1024^3
+
+static const char* BACKWARDS_FILE = "tmp/tmp_bench_backwards";
+static const char* SVO_FILE = "tmp/tmp_bench.svo";
+
+static uint64_t fileSize(const char* file)
+{
+    std::ifstream in(file, std::ios::binary | std::ios::ate);
+    return in.is_open()? (uint64_t)in.tellg() : 0;
+}
+
+// position of a morton code
+static glm::uvec3 mortonDecode(uint64_t code)
+{
+    glm::uvec3 position(0);
+    for (unsigned int i = 0; i < 21;++i){
+        position.x |= (unsigned int)((code >> (3*i)) & 1) << i;
+        position.y |= (unsigned int)((code >> (3*i + 1)) & 1) << i;
+        position.z |= (unsigned int)((code >> (3*i + 2)) & 1) << i;
+    }
+    return position;
+}
+
+// voxelizes the whole grid in bricks on all cores, the voxels are in the order of the bricks
+static std::vector<Voxel> voxelizeCpu(const CpuVoxelizer& voxelizer, unsigned int depth)
+{
+    const unsigned int resolution = 1 << depth;
+    const unsigned int brickSize = std::min(resolution, (unsigned int)BRICK_SIZE);
+    const unsigned int bricksPerSide = resolution/brickSize;
+    std::vector<unsigned int> triangles(voxelizer.totalTriangles());
+    std::iota(triangles.begin(), triangles.end(), 0);
+
+    std::vector<std::vector<Voxel>> bricks((uint64_t)bricksPerSide*bricksPerSide*bricksPerSide);
+    TaskScheduler scheduler;
+    TaskScheduler::TaskGroup group;
+    for (uint64_t b = 0; b < bricks.size();++b){
+        scheduler.spawn(group, [&voxelizer, &triangles, &bricks, b, bricksPerSide, brickSize, resolution](){
+            const glm::uvec3 origin = glm::uvec3(b % bricksPerSide, (b/bricksPerSide) % bricksPerSide, b/bricksPerSide/bricksPerSide)*brickSize;
+            const float voxelSize = 1.f/resolution;
+            const std::vector<unsigned int> brickTriangles = voxelizer.overlappingTriangles(triangles,
+                glm::vec3(origin)*voxelSize - glm::vec3(voxelSize/2), (brickSize + 1)*voxelSize);
+            if (brickTriangles.empty()) return;
+
+            const std::vector<OfcSVO::MortonVoxel> voxels = voxelizer.voxelize(brickTriangles, origin, brickSize, resolution);
+            bricks[b].reserve(voxels.size());
+            for (uint64_t i = 0; i < voxels.size();++i){
+                const glm::uvec3 p = origin + mortonDecode(voxels[i].mortonCode);
+                bricks[b].push_back({{p.x, p.y, p.z}, voxels[i].voxel});
+            }
+        });
+    }
+    scheduler.wait(group);
+
+    uint64_t totalVoxels = 0;
+    for (uint64_t b = 0; b < bricks.size();++b) totalVoxels += bricks[b].size();
+    std::vector<Voxel> voxels;
+    voxels.reserve(totalVoxels);
+    MemoryTracker::Block memory(MemoryTracker::VOXELIZER, MemoryTracker::bytes(voxels));
+    for (uint64_t b = 0; b < bricks.size();++b){
+        voxels.insert(voxels.end(), bricks[b].begin(), bricks[b].end());
+        std::vector<Voxel>().swap(bricks[b]);
+    }
+    return voxels;
+}
+
+void Benchmark::run(const std::vector<std::string>& files, unsigned int minDepth, unsigned int maxDepth, const std::string& outputName, bool gpu)
+{
+    typedef std::chrono::steady_clock Clock;
+    std::vector<Result> results;
+
+    // runs a stage, the stage fills in its voxels, nodes and output bytes
+    const auto measure = [&results](const std::string& model, unsigned int depth, const char* stage, const std::function<void(Result&)>& function){
+        Result result{model, depth, stage, 0, 0, 0, 0, 0};
+        MemoryTracker::resetHighWater();
+        const Clock::time_point begin = Clock::now();
+        function(result);
+        result.seconds = std::chrono::duration<double>(Clock::now() - begin).count();
+        result.memory = MemoryTracker::totalHighWater();
+        results.push_back(result);
+
+        std::cout << "  " << stage << ": " << result.seconds << " s";
+        if (result.voxels > 0) std::cout << ", " << result.voxels/result.seconds/1e6 << " M voxels/s";
+        if (result.nodes > 0) std::cout << ", " << result.nodes/result.seconds/1e6 << " M nodes/s";
+        std::cout << ", tracked memory " << result.memory/(1024*1024) << " MB";
+        if (result.outputBytes > 0) std::cout << ", output " << result.outputBytes << " bytes";
+        std::cout << "\n";
+    };
+
+    for (unsigned int f = 0; f < files.size();++f){
+        if (!std::ifstream(files[f])){
+            std::cout << "\n" << files[f] << " not found, skipped\n";
+            continue;
+        }
+        const size_t slash = files[f].find_last_of("/\\");
+        const std::string path = slash == std::string::npos? "" : files[f].substr(0, slash + 1);
+        const std::string filename = files[f].substr(path.size());
+        std::cout << "\n" << filename << "\n";
+
+        // the load doesn't depend on the depth, it is depth 0. The cold load parses the OBJ file
+        // without a mesh cache and writes the cache, the warm load reads it.
+        const uint64_t hash = MeshCache::hashModel(path.c_str(), filename.c_str());
+        if (hash != 0) std::remove(MeshCache::cacheFile(hash).c_str());
+        ModelLoader::Result model;
+        measure(filename, 0, "load cold", [&model, &path, &filename](Result&){
+            model = ModelLoader::loadModel(path.c_str(), filename.c_str());
+        });
+        measure(filename, 0, "load warm", [&model, &path, &filename](Result&){
+            model = ModelLoader::loadModel(path.c_str(), filename.c_str());
+        });
+        if (model.store->triangles.empty()){
+            std::cout << " Failed to load " << files[f] << ", skipped\n";
+            continue;
+        }
+        const CpuVoxelizer cpuVoxelizer(model);
+        TextureArray* textures = gpu? new TextureArray(*model.store) : nullptr;
+
+        for (unsigned int depth = minDepth; depth <= maxDepth;++depth){
+            std::cout << " Depth " << depth << "\n";
+            const unsigned int resolution = 1 << depth;
+
+            // the CPU voxels are the input of the next stages, the GPU voxels are only counted
+            std::vector<Voxel> voxels;
+            measure(filename, depth, "voxelize cpu", [&voxels, &cpuVoxelizer, depth](Result& result){
+                voxels = voxelizeCpu(cpuVoxelizer, depth);
+                result.voxels = voxels.size();
+            });
+            MemoryTracker::Block voxelMemory(MemoryTracker::VOXELIZER, MemoryTracker::bytes(voxels));
+
+            if (gpu && depth <= GPU_MAX_DEPTH){
+                Voxelizer gpuVoxelizer(resolution, resolution, resolution, false);
+                measure(filename, depth, "voxelize gpu", [&gpuVoxelizer, &model, textures](Result& result){
+                    result.voxels = gpuVoxelizer.voxelize(glm::mat4(1.0f), model.mesh, textures).size();
+                });
+            } else if (gpu){
+                std::cout << "  voxelize gpu: skipped, the voxel image is at most " << (1 << GPU_MAX_DEPTH) << "^3\n";
+            }
+
+            std::vector<OfcSVO::MortonVoxel> mortonVoxels(voxels.size());
+            MemoryTracker::Block mortonMemory(MemoryTracker::SORT, MemoryTracker::bytes(mortonVoxels));
+            measure(filename, depth, "morton encode", [&voxels, &mortonVoxels](Result& result){
+                for (uint64_t i = 0; i < voxels.size();++i){
+                    mortonVoxels[i] = {voxels[i].RGBA, OfcSVO::mortonEncode_magicbits(voxels[i].XYZ[0], voxels[i].XYZ[1], voxels[i].XYZ[2])};
+                }
+                result.voxels = voxels.size();
+            });
+            measure(filename, depth, "sort", [&mortonVoxels](Result& result){
+                std::sort(mortonVoxels.begin(), mortonVoxels.end(), [](const OfcSVO::MortonVoxel& a, const OfcSVO::MortonVoxel& b){
+                    return a.mortonCode < b.mortonCode;
+                });
+                result.voxels = mortonVoxels.size();
+            });
+            mortonMemory.resize(0);
+            std::vector<OfcSVO::MortonVoxel>().swap(mortonVoxels);
+
+            // the plain SVO, OfcSVO::create sorts the voxels itself
+            measure(filename, depth, "create", [&voxels, depth](Result& result){
+                {
+                    std::ofstream out(BACKWARDS_FILE, std::ios::binary | std::ios::out);
+                    OfcSVO::create(out, voxels, depth, false, false);
+                }
+                result.voxels = voxels.size();
+                result.outputBytes = fileSize(BACKWARDS_FILE);
+                result.nodes = result.outputBytes/8;
+            });
+            measure(filename, depth, "reverse", [](Result& result){
+                {
+                    std::ofstream out(SVO_FILE, std::ios::binary | std::ios::out);
+                    std::ifstream in(BACKWARDS_FILE, std::ios::binary | std::ios::ate | std::ios::in);
+                    OfcSVO::reverseNodeFile(out, in);
+                }
+                result.outputBytes = fileSize(SVO_FILE);
+                result.nodes = result.outputBytes/8;
+            });
+
+            // the in memory SVO of the saver formats
+            if (depth <= LEGACY_MAX_DEPTH){
+                SVO* svo = nullptr;
+                measure(filename, depth, "svo tree", [&svo, &voxels, depth](Result& result){
+                    svo = new SVO(voxels, depth);
+                    result.voxels = voxels.size();
+                });
+                measure(filename, depth, "save", [svo](Result& result){
+                    SVOSaver::save(SVO_FILE, *svo);
+                    result.outputBytes = fileSize(SVO_FILE);
+                });
+                measure(filename, depth, "save opt", [svo](Result& result){
+                    SVOSaver::saveOpt(SVO_FILE, *svo);
+                    result.outputBytes = fileSize(SVO_FILE);
+                });
+                delete svo;
+            } else{
+                std::cout << "  svo tree, save, save opt: skipped above depth " << LEGACY_MAX_DEPTH << "\n";
+            }
+            voxelMemory.resize(0);
+            std::vector<Voxel>().swap(voxels);
+
+            // the whole CPU build, from the model to the plain SVO file
+            measure(filename, depth, "end to end cpu", [&model, depth](Result& result){
+                CpuSVOMaker maker(model);
+                maker.modelToSvoFile(SVO_FILE, depth);
+                result.outputBytes = fileSize(SVO_FILE);
+                result.nodes = result.outputBytes/8;
+            });
+        }
+        delete textures;
+    }
+    std::remove(BACKWARDS_FILE);
+    std::remove(SVO_FILE);
+
+    write(results, outputName);
+}
+
+void Benchmark::write(const std::vector<Result>& results, const std::string& outputName)
+{
+    const auto perSecond = [](uint64_t items, double seconds){
+        return seconds > 0? items/seconds : 0.0;
+    };
+
+    std::ofstream csv(outputName + ".csv");
+    csv << std::fixed << std::setprecision(6);
+    csv << "model,depth,stage,seconds,voxels,nodes,voxelsPerSecond,nodesPerSecond,trackedMemoryBytes,outputBytes\n";
+    for (unsigned int i = 0; i < results.size();++i){
+        const Result& r = results[i];
+        csv << r.model << "," << r.depth << "," << r.stage << "," << r.seconds << "," << r.voxels << "," << r.nodes << "," <<
+               perSecond(r.voxels, r.seconds) << "," << perSecond(r.nodes, r.seconds) << "," << r.memory << "," << r.outputBytes << "\n";
+    }
+
+    std::ofstream json(outputName + ".json");
+    json << std::fixed << std::setprecision(6);
+    json << "{\"results\": [";
+    for (unsigned int i = 0; i < results.size();++i){
+        const Result& r = results[i];
+        json << (i > 0? ",\n" : "\n") << "  {\"model\": \"" << r.model << "\", \"depth\": " << r.depth << ", \"stage\": \"" << r.stage <<
+                "\", \"seconds\": " << r.seconds << ", \"voxels\": " << r.voxels << ", \"nodes\": " << r.nodes <<
+                ", \"voxelsPerSecond\": " << perSecond(r.voxels, r.seconds) << ", \"nodesPerSecond\": " << perSecond(r.nodes, r.seconds) <<
+                ", \"trackedMemoryBytes\": " << r.memory << ", \"outputBytes\": " << r.outputBytes << "}";
+    }
+    json << "\n]}\n";
+
+    std::cout << "\nResults written to " << outputName << ".csv and " << outputName << ".json\n";
+}
@@ -0,0 +1,35 @@
+#ifndef BENCHMARK_H
+#define BENCHMARK_H
+
+#include <string>
+#include <vector>
+#include <cstdint>
+
+// Runs the stages of the SVO build one by one and end to end on OBJ files at a range of depths:
+// load (cold, parsing the OBJ file, and warm, from the mesh cache), voxelize (CPU, and GPU when there is an OpenGL context), morton encode, sort,
+// OfcSVO::create, the reversal of the backwards file, the in memory SVO with SVOSaver::save and
+// saveOpt, and the CPU build of CpuSVOMaker. Every stage gets its time, its voxels and nodes per
+// second, the high-water bytes of the buffers the MemoryTracker counts (not the resident memory of
+// the process) and the size of its output. The results are written to <outputName>.csv and
+// <outputName>.json.
+class Benchmark
+{
+public:
+    static void run(const std::vector<std::string>& files, unsigned int minDepth, unsigned int maxDepth, const std::string& outputName, bool gpu);
+
+private:
+    struct Result{
+        std::string model;
+        unsigned int depth;
+        std::string stage;
+        double seconds;
+        uint64_t voxels;
+        uint64_t nodes;
+        uint64_t memory;        // high-water bytes of the tracked buffers during the stage
+        uint64_t outputBytes;
+    };
+
+    static void write(const std::vector<Result>& results, const std::string& outputName);
+};
+
+#endif
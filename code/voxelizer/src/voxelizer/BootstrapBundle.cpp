@@ -0,0 +1,119 @@
+#include "BootstrapBundle.h"
+#include "MappedFile.h"
+#include "NodeTree.h"
+#include "FarPointers.h"
+#include "Profiler.h"
+
+#include <iostream>
+#include <iomanip>
+#include <fstream>
+#include <vector>
+#include <unordered_set>
+#include <algorithm>
+
+#define HEADER_SIZE 16
+
+bool BootstrapBundle::write(const char* svoFile, const char* outputFile, const char* farTableFile, unsigned int pageSize,
+                            unsigned int maxDepth, uint64_t maxBytes, unsigned int bricksDepth)
+{
+    MappedFile file(svoFile);
+    if (!file.isOpen() || file.size() < 8){
+        std::cout << "Failed to open " << svoFile << "\n";
+        return false;
+    }
+    std::cout << "Writing bootstrap bundle of " << svoFile << "...\n";
+    Profiler::Scope scope("bootstrap");
+
+    const uint8_t* data = file.data();
+    const uint64_t totalWords = file.size()/8;
+    const NodeTree tree(data, totalWords, FarPointers::readTable(farTableFile), bricksDepth);
+    const unsigned int brickLevel = tree.brickLevel();
+    // every page in a bundle is a page number and the nodes of the page
+    const uint64_t pageBytes = 8 + 8*(uint64_t)pageSize;
+
+    std::vector<uint64_t> pages;
+    std::unordered_set<uint64_t> added;
+    const auto addPage = [&pages, &added](uint64_t page){
+        if (added.insert(page).second) pages.push_back(page);
+    };
+
+    // walk the tree level by level, the pages of a level are added when the whole level fits
+    std::vector<uint64_t> level{0};
+    std::vector<uint64_t> levelPages;
+    unsigned int depth = 0;
+    std::cout << std::setw(6) << "depth" << std::setw(12) << "pages" << std::setw(14) << "bytes" << "\n";
+    while (!level.empty() && depth <= maxDepth){
+        std::vector<uint64_t> next;
+        std::vector<uint64_t> nextPages;
+        const bool bricks = brickLevel != ~0u && depth == brickLevel + 1;
+        for (uint64_t pointer : level){
+            levelPages.push_back(pointer/pageSize);
+            if (bricks){
+                const uint64_t last = pointer + tree.brickWords(pointer) - 1;
+                for (uint64_t page = pointer/pageSize + 1; page <= last/pageSize;++page) levelPages.push_back(page);
+                continue;
+            }
+
+            const Node node = tree.node(pointer);
+            if (node.childBits == 0 || node.childOffset == 0) continue;
+            // the refer word is needed to find the children
+            uint64_t referWord;
+            const uint64_t children = tree.children(pointer, node, &referWord);
+            if (referWord != NodeTree::NO_POINTER) nextPages.push_back(referWord/pageSize);
+            if (children >= totalWords) continue;
+
+            if (depth == brickLevel){
+                next.push_back(children);
+                continue;
+            }
+            const unsigned int totalChildren = __builtin_popcount(node.childBits);
+            for (unsigned int c = 0; c < totalChildren && children + c < totalWords;++c){
+                next.push_back(children + c);
+            }
+        }
+
+        // count the new pages of the level before adding them
+        uint64_t newPages = 0;
+        std::unordered_set<uint64_t> levelSet;
+        for (uint64_t page : levelPages){
+            if (added.count(page) == 0 && levelSet.insert(page).second) newPages += 1;
+        }
+        if (depth > 0 && HEADER_SIZE + (pages.size() + newPages)*pageBytes > maxBytes) break;
+        for (uint64_t page : levelPages) addPage(page);
+        std::cout << std::setw(6) << depth << std::setw(12) << pages.size() << std::setw(14) << HEADER_SIZE + pages.size()*pageBytes << "\n";
+
+        level.swap(next);
+        levelPages.swap(nextPages);
+        depth += 1;
+    }
+
+    std::ofstream out(outputFile, std::ios::binary | std::ios::out);
+    if (!out.is_open()){
+        std::cout << "Failed to open " << outputFile << "\n";
+        return false;
+    }
+    const unsigned int header[2] = {_byteswap_ulong(pageSize), _byteswap_ulong(depth - 1)};
+    out.write((const char*)header, 8);
+    uint8_t bytes[8];
+    NodeRead::toBytes(pages.size(), bytes);
+    out.write((const char*)bytes, 8);
+    for (uint64_t page : pages){
+        NodeRead::toBytes(page, bytes);
+        out.write((const char*)bytes, 8);
+    }
+    // the part of a page behind the end of the file is empty
+    std::vector<uint8_t> pageData(8*pageSize);
+    for (uint64_t page : pages){
+        std::fill(pageData.begin(), pageData.end(), 0);
+        const uint64_t begin = std::min(page*pageSize, totalWords);
+        const uint64_t end = std::min(begin + pageSize, totalWords);
+        std::copy(data + 8*begin, data + 8*end, pageData.begin());
+        out.write((const char*)pageData.data(), pageData.size());
+    }
+
+    const uint64_t size = HEADER_SIZE + pages.size()*pageBytes;
+    Profiler::add(Profiler::ALL_BYTES_WRITTEN, size);
+    std::cout << " Bootstrap bundle to depth " << depth - 1 << ": " << pages.size() << " pages, " << size << " bytes in 1 response instead of "
+              << depth << " round trips\n";
+    return true;
+}
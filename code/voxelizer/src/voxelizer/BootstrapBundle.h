@@ -0,0 +1,22 @@
+#ifndef BOOTSTRAPBUNDLE_H
+#define BOOTSTRAPBUNDLE_H
+
+#include <cstdint>
+
+// Bootstrap bundle of an SVO file in the 64 bit node format: every page the client needs to
+// render the top levels of the tree, in the order the client walks down the tree (level by
+// level, the root page first). The server sends it in one response at the start, instead of one
+// round trip per level. Levels are added as a whole up to the depth or until the next level
+// doesn't fit in the byte budget, with bricks the bricks count as the level below the brick
+// pointers. A far pointer table next to the file is used for the refer bits.
+//
+// File: <pageSize:32><depth:32><pages:64><page number:64 for every page><nodes:64 for every page>
+class BootstrapBundle
+{
+public:
+    // with bricks the bricks depth tells the level of the brick pointers, 0 is a file without bricks
+    static bool write(const char* svoFile, const char* outputFile, const char* farTableFile, unsigned int pageSize,
+                      unsigned int maxDepth, uint64_t maxBytes, unsigned int bricksDepth = 0);
+};
+
+#endif
@@ -0,0 +1,312 @@
+#include "ColorDeltaCoder.h"
+#include "PagedFile.h"
+#include "NodeTree.h"
+#include "MappedFile.h"
+#include "FarPointers.h"
+#include "Profiler.h"
+
+#include <iostream>
+#include <algorithm>
+
+#define RICE_MAX_K 7
+#define RICE_ESCAPE 12      // values with a longer unary prefix are written as 9 raw bits
+#define ZIGZAG_BITS 9
+#define NODE_WORD 0
+#define BRICK_MASK_WORD 1
+#define BRICK_COLOR_WORD 2  // 2 colors of a brick
+
+void ColorDeltaCoder::encode(const char* svoFile, const char* outputFile, unsigned int pageSize, unsigned int bricksDepth,
+                             const char* farTableFile)
+{
+    std::cout << "Delta coding colors of " << svoFile << "...\n";
+    Profiler::Scope scope("color delta");
+
+    const std::vector<uint8_t> bricks = findBricks(svoFile, farTableFile, bricksDepth);
+    std::vector<uint8_t> brickWord;
+    uint64_t rawPages = 0;
+    PagedFile::Header header;
+    const uint64_t fileSize = PagedFile::encode(svoFile, outputFile, pageSize,
+                                                [&bricks, &brickWord, &rawPages, pageSize](const std::vector<uint64_t>& nodes, uint64_t page){
+        brickWord.assign(nodes.size(), NODE_WORD);
+        for (unsigned int i = 0; i < nodes.size() && !bricks.empty();++i){
+            brickWord[i] = bricks[page*pageSize + i];
+        }
+        std::vector<uint8_t> data = encodePage(nodes, brickWord);
+        if (data[0] & 0x80) rawPages += 1;
+        return data;
+    }, header);
+    if (fileSize == 0) return;
+
+    Profiler::add(Profiler::ALL_BYTES_WRITTEN, fileSize);
+    std::cout << " Pages: " << header.totalPages << ", plain size: " << 8*header.totalNodes << " bytes, coded size: " << fileSize
+              << " bytes (" << (100.*fileSize)/std::max(8*header.totalNodes, (uint64_t)1) << "%), raw pages: " << rawPages << "\n";
+}
+
+void ColorDeltaCoder::decode(const char* inputFile, const char* svoFile)
+{
+    PagedFile::decode(inputFile, svoFile, decodePage);
+}
+
+std::vector<uint8_t> ColorDeltaCoder::findBricks(const char* svoFile, const char* farTableFile, unsigned int bricksDepth)
+{
+    if (bricksDepth == 0) return {};
+    MappedFile file(svoFile);
+    if (!file.isOpen()) return {};
+
+    const uint64_t totalWords = file.size()/8;
+    const NodeTree tree(file.data(), totalWords, FarPointers::readTable(farTableFile), bricksDepth);
+    std::vector<uint8_t> bricks(totalWords, NODE_WORD);
+    const auto visit = [&tree, &bricks, totalWords](uint64_t pointer, unsigned int level, bool&) -> uint64_t{
+        if (pointer >= totalWords) return NodeTree::NO_POINTER;
+        const Node node = tree.node(pointer);
+        if (node.childBits == 0 || node.childOffset == 0) return NodeTree::NO_POINTER;
+        const uint64_t children = tree.children(pointer, node);
+        if (children >= totalWords) return NodeTree::NO_POINTER;
+        if (level != tree.brickLevel()) return children;
+
+        const uint64_t words = tree.brickWords(children);
+        bricks[children] = BRICK_MASK_WORD;
+        for (uint64_t w = 1; w < words;++w) bricks[children + w] = BRICK_COLOR_WORD;
+        return NodeTree::NO_POINTER;
+    };
+    tree.walk<bool>(visit, [](NodeTree::Frame<bool>&, uint64_t, const bool&){}, [](const NodeTree::Frame<bool>&){});
+    return bricks;
+}
+
+void ColorDeltaCoder::markChildren(PageInfo& info, unsigned int nodeIndex, const std::vector<uint64_t>& nodes)
+{
+    // only pointers to later nodes in the page are followed, the decoder finds the same nodes
+    if (info.isRefer[nodeIndex] || info.brickWord[nodeIndex] != NODE_WORD) return;
+    const Node node = NodeRead::decode(nodes[nodeIndex]);
+    if (node.childOffset == 0) return;
+
+    // a brick is not a child node
+    const uint64_t target = nodeIndex + node.childOffset;
+    if (target >= nodes.size() || info.brickWord[target] != NODE_WORD) return;
+
+    if (node.referBit){
+        info.isRefer[target] = true;
+        return;
+    }
+
+    unsigned int child = 0;
+    for (unsigned int i = 0; i < 8;++i){
+        if ((node.childBits & (1 << i)) && target + child < nodes.size()){
+            info.parent[target + child] = nodeIndex;
+            child += 1;
+        }
+    }
+}
+
+std::vector<uint8_t> ColorDeltaCoder::encodePage(const std::vector<uint64_t>& nodes, const std::vector<uint8_t>& brickWord)
+{
+    PageInfo info{std::vector<bool>(nodes.size(), false), std::vector<int>(nodes.size(), -1), brickWord};
+
+    // find the parents and the color deltas, a brick color is coded from the brick color before it
+    std::vector<unsigned int> deltas[4];
+    const auto addDeltas = [&deltas](uint32_t color, uint32_t from){
+        for (unsigned int c = 0; c < 4;++c){
+            deltas[c].push_back(zigzag((int)((color >> (24 - 8*c)) & 0xFF) - (int)((from >> (24 - 8*c)) & 0xFF)));
+        }
+    };
+    int64_t brickColor = -1;
+    int lastNode = -1;
+    for (unsigned int i = 0; i < nodes.size();++i){
+        if (brickWord[i] == BRICK_COLOR_WORD){
+            for (int shift = 32; shift >= 0; shift -= 32){
+                const uint32_t color = nodes[i] >> shift;
+                if (brickColor >= 0) addDeltas(color, brickColor);
+                brickColor = color;
+            }
+        } else if (!info.isRefer[i] && brickWord[i] == NODE_WORD){
+            if (info.parent[i] >= 0){
+                addDeltas(nodes[i], nodes[info.parent[i]]);
+            } else if (lastNode >= 0){
+                addDeltas(nodes[i], nodes[lastNode]);
+            }
+            lastNode = i;
+        }
+        markChildren(info, i, nodes);
+    }
+
+    // find the best Rice parameter for every channel
+    unsigned int k[4];
+    for (unsigned int c = 0; c < 4;++c){
+        uint64_t bestSize = UINT64_MAX;
+        for (unsigned int testK = 0; testK <= RICE_MAX_K;++testK){
+            uint64_t size = 0;
+            for (unsigned int i = 0; i < deltas[c].size();++i){
+                size += riceSize(deltas[c][i], testK);
+            }
+            if (size < bestSize){
+                bestSize = size;
+                k[c] = testK;
+            }
+        }
+    }
+
+    // write the page
+    BitWriter out;
+    out.write(0, 1);
+    const bool bricks = std::find_if(brickWord.begin(), brickWord.end(), [](uint8_t word){ return word != NODE_WORD; }) != brickWord.end();
+    out.write(bricks, 1);
+    for (unsigned int i = 0; i < nodes.size() && bricks;++i){
+        out.write(brickWord[i] != NODE_WORD, 1);
+        if (brickWord[i] != NODE_WORD) out.write(brickWord[i] == BRICK_COLOR_WORD, 1);
+    }
+    for (unsigned int c = 0; c < 4;++c){
+        out.write(k[c], 3);
+    }
+    unsigned int d = 0;
+    const auto writeDeltas = [&out, &deltas, &k, &d](){
+        for (unsigned int c = 0; c < 4;++c){
+            writeRice(out, deltas[c][d], k[c]);
+        }
+        d += 1;
+    };
+    brickColor = -1;
+    lastNode = -1;
+    for (unsigned int i = 0; i < nodes.size();++i){
+        if (brickWord[i] == BRICK_COLOR_WORD){
+            for (int shift = 32; shift >= 0; shift -= 32){
+                const uint32_t color = nodes[i] >> shift;
+                if (brickColor >= 0){
+                    writeDeltas();
+                } else{
+                    out.write(color, 32);
+                }
+                brickColor = color;
+            }
+        } else if (info.isRefer[i] || brickWord[i] == BRICK_MASK_WORD){
+            out.write(nodes[i], 64);
+        } else if (info.parent[i] >= 0 || lastNode >= 0){
+            out.write(nodes[i] >> 32, 32);
+            writeDeltas();
+            lastNode = i;
+        } else{
+            out.write(nodes[i], 64);
+            lastNode = i;
+        }
+    }
+
+    // a page without enough deltas is smaller raw
+    if (out.bytes.size() > 8*nodes.size()){
+        BitWriter raw;
+        raw.write(1, 1);
+        for (unsigned int i = 0; i < nodes.size();++i){
+            raw.write(nodes[i], 64);
+        }
+        return raw.bytes;
+    }
+    return out.bytes;
+}
+
+std::vector<uint64_t> ColorDeltaCoder::decodePage(const uint8_t* data, unsigned int totalNodes)
+{
+    std::vector<uint64_t> nodes(totalNodes, 0);
+    PageInfo info{std::vector<bool>(totalNodes, false), std::vector<int>(totalNodes, -1), std::vector<uint8_t>(totalNodes, NODE_WORD)};
+
+    BitReader in{data};
+    if (in.read(1)){
+        for (unsigned int i = 0; i < totalNodes;++i){
+            nodes[i] = in.read(64);
+        }
+        return nodes;
+    }
+    if (in.read(1)){
+        for (unsigned int i = 0; i < totalNodes;++i){
+            if (in.read(1)) info.brickWord[i] = in.read(1)? BRICK_COLOR_WORD : BRICK_MASK_WORD;
+        }
+    }
+    unsigned int k[4];
+    for (unsigned int c = 0; c < 4;++c){
+        k[c] = in.read(3);
+    }
+
+    const auto readColor = [&in, &k](uint32_t from){
+        uint32_t color = 0;
+        for (unsigned int c = 0; c < 4;++c){
+            const int fromChannel = (from >> (24 - 8*c)) & 0xFF;
+            color = (color << 8) | ((fromChannel + unzigzag(readRice(in, k[c]))) & 0xFF);
+        }
+        return color;
+    };
+    int64_t brickColor = -1;
+    int lastNode = -1;
+    for (unsigned int i = 0; i < totalNodes;++i){
+        if (info.brickWord[i] == BRICK_COLOR_WORD){
+            uint64_t word = 0;
+            for (unsigned int half = 0; half < 2;++half){
+                const uint32_t color = brickColor >= 0? readColor(brickColor) : in.read(32);
+                word = (word << 32) | color;
+                brickColor = color;
+            }
+            nodes[i] = word;
+        } else if (info.isRefer[i] || info.brickWord[i] == BRICK_MASK_WORD){
+            nodes[i] = in.read(64);
+        } else if (info.parent[i] >= 0 || lastNode >= 0){
+            const uint64_t node = in.read(32);
+            nodes[i] = (node << 32) | readColor(nodes[info.parent[i] >= 0? info.parent[i] : lastNode]);
+            lastNode = i;
+        } else{
+            nodes[i] = in.read(64);
+            lastNode = i;
+        }
+        markChildren(info, i, nodes);
+    }
+
+    return nodes;
+}
+
+unsigned int ColorDeltaCoder::riceSize(unsigned int value, unsigned int k)
+{
+    const unsigned int q = value >> k;
+    if (q >= RICE_ESCAPE) return RICE_ESCAPE + ZIGZAG_BITS;
+    return q + 1 + k;
+}
+
+void ColorDeltaCoder::writeRice(BitWriter& out, unsigned int value, unsigned int k)
+{
+    const unsigned int q = value >> k;
+    if (q >= RICE_ESCAPE){
+        // escape: unary prefix of RICE_ESCAPE ones and the raw value
+        out.write((1 << RICE_ESCAPE) - 1, RICE_ESCAPE);
+        out.write(value, ZIGZAG_BITS);
+        return;
+    }
+    out.write(((1 << q) - 1) << 1, q + 1);
+    out.write(value & ((1 << k) - 1), k);
+}
+
+unsigned int ColorDeltaCoder::readRice(BitReader& in, unsigned int k)
+{
+    unsigned int q = 0;
+    while (q < RICE_ESCAPE && in.read(1)){
+        q += 1;
+    }
+    if (q >= RICE_ESCAPE){
+        return in.read(ZIGZAG_BITS);
+    }
+    return (q << k) | in.read(k);
+}
+
+void ColorDeltaCoder::BitWriter::write(uint64_t value, unsigned int totalBits)
+{
+    for (int i = totalBits - 1; i >= 0;--i){
+        if (bitIndex == 0){
+            bytes.push_back(0);
+        }
+        bytes.back() |= ((value >> i) & 1) << (7 - bitIndex);
+        bitIndex = (bitIndex + 1) % 8;
+    }
+}
+
+uint64_t ColorDeltaCoder::BitReader::read(unsigned int totalBits)
+{
+    uint64_t value = 0;
+    for (unsigned int i = 0; i < totalBits;++i){
+        value = (value << 1) | ((bytes[bitPointer/8] >> (7 - bitPointer%8)) & 1);
+        bitPointer += 1;
+    }
+    return value;
+}
@@ -0,0 +1,57 @@
+#ifndef COLORDELTACODER_H
+#define COLORDELTACODER_H
+
+#include <vector>
+#include <cstdint>
+
+// Lossless color coding for SVO files in the 64 bit node format.
+// Every page of <pageSize> nodes is coded on its own: a node whose parent is in the same page
+// stores its color as 4 Rice coded deltas from the color of the parent, another node from the
+// node before it in the page, the first node, refer nodes and brick masks are stored as is. A
+// brick color is coded from the brick color before it in the page. A page that doesn't get
+// smaller is stored raw. A page can be decoded without any other page.
+//
+// File: a PagedFile of the pages
+// Page: <raw:1><nodes:64 each> or <raw:1><bricks:1><brick:1 and with it colors:1 for every word,
+//       with bricks><Rice parameter:3 for R,G,B,A><nodes>, bits are written from MSB to LSB
+class ColorDeltaCoder
+{
+public:
+    // with bricks the depth tells the level of the brick pointers, a far pointer table next to
+    // the file is used to find them
+    static void encode(const char* svoFile, const char* outputFile, unsigned int pageSize, unsigned int bricksDepth = 0,
+                       const char* farTableFile = "");
+    static void decode(const char* inputFile, const char* svoFile);
+
+    static std::vector<uint64_t> decodePage(const uint8_t* data, unsigned int totalNodes);
+
+private:
+    struct BitWriter{
+        std::vector<uint8_t> bytes;
+        unsigned int bitIndex = 0;
+        void write(uint64_t value, unsigned int totalBits);
+    };
+    struct BitReader{
+        const uint8_t* bytes;
+        uint64_t bitPointer = 0;
+        uint64_t read(unsigned int totalBits);
+    };
+    struct PageInfo{
+        std::vector<bool> isRefer;
+        std::vector<int> parent;
+        std::vector<uint8_t> brickWord;     // a node, the mask or the colors of a brick
+    };
+
+    static std::vector<uint8_t> encodePage(const std::vector<uint64_t>& nodes, const std::vector<uint8_t>& brickWord);
+    // the brick words of the file, empty without bricks
+    static std::vector<uint8_t> findBricks(const char* svoFile, const char* farTableFile, unsigned int bricksDepth);
+    static void markChildren(PageInfo& info, unsigned int nodeIndex, const std::vector<uint64_t>& nodes);
+
+    static void writeRice(BitWriter& out, unsigned int value, unsigned int k);
+    static unsigned int readRice(BitReader& in, unsigned int k);
+    static unsigned int riceSize(unsigned int value, unsigned int k);
+    static unsigned int zigzag(int value){ return value >= 0? 2*value : -2*value - 1;}
+    static int unzigzag(unsigned int value){ return (value & 1)? -(int)((value + 1)/2) : value/2;}
+};
+
+#endif
@@ -0,0 +1,317 @@
+#include "CpuSVOMaker.h"
+
+#include "ofcSVO.h"
+#include "SVOMerger.h"
+#include "AsyncWriter.h"
+#include "Profiler.h"
+#include "MemoryTracker.h"
+#include <iostream>
+#include <sstream>
+#include <fstream>
+#include <algorithm>
+#include <cstring>
+#include <cstdio>
+
+#define MAX_BRICK_SIZE 128      // largest octant voxelized at once
+#define MIN_BRICK_SIZE 16       // smallest octant, it is not split even with many triangles
+#define SPLIT_TRIANGLES 4096    // octants with more triangles are split
+#define COARSE_DEPTH 6          // depth of the coarse cells of the coarse-to-fine mode, 64^3 cells
+#define LEAF_SIZE 8             // refined cells of this size are voxelized at once
+#define BIN_TRIANGLES 16384     // triangles binned by one task
+#define BATCH_CELLS 16          // coarse cells per thread that are refined before they are built
+
+// worst case memory per voxel of a brick being voxelized: the dense brick, the list of set voxels,
+// the sorted voxels and the backwards subtree with its reversed copy
+const uint64_t BRICK_VOXEL_BYTES = sizeof(RGBA8) + sizeof(uint64_t) + sizeof(OfcSVO::MortonVoxel) + 2*sizeof(uint64_t);
+
+// false if the file couldn't be written
+static bool writeReversed(const std::string& file, const std::string& backwards)
+{
+    std::vector<uint64_t> nodes(backwards.size()/8);
+    memcpy(nodes.data(), backwards.data(), nodes.size()*8);
+    std::reverse(nodes.begin(), nodes.end());
+
+    std::ofstream out(file, std::ios::binary | std::ios::out);
+    out.write((const char*)nodes.data(), nodes.size()*8);
+    out.close();
+    Profiler::add(Profiler::ALL_BYTES_WRITTEN, nodes.size()*8);
+    return (bool)out;
+}
+
+// position of a morton code
+static glm::uvec3 mortonDecode(uint64_t code)
+{
+    glm::uvec3 position(0);
+    for (unsigned int i = 0; i < 21;++i){
+        position.x |= (unsigned int)((code >> (3*i)) & 1) << i;
+        position.y |= (unsigned int)((code >> (3*i + 1)) & 1) << i;
+        position.z |= (unsigned int)((code >> (3*i + 2)) & 1) << i;
+    }
+    return position;
+}
+
+CpuSVOMaker::CpuSVOMaker(const ModelLoader::Result& model, bool bricks, uint64_t maxMemory, unsigned int totalThreads)
+    : _voxelizer{model}, _scheduler{totalThreads}, _bricks{bricks}
+{
+    _maxBrickSize = MAX_BRICK_SIZE;
+    if (maxMemory > 0){
+        // every thread voxelizes one brick at a time
+        const uint64_t threads = _scheduler.totalThreads();
+        while (_maxBrickSize > MIN_BRICK_SIZE && threads*_maxBrickSize*_maxBrickSize*_maxBrickSize*BRICK_VOXEL_BYTES > maxMemory){
+            _maxBrickSize /= 2;
+        }
+    }
+    std::cout << "CPU SVO maker: " << _scheduler.totalThreads() << " threads, max brick size " << _maxBrickSize << "\n";
+}
+
+bool CpuSVOMaker::modelToSvoFile(const char* outputFile, unsigned int depth)
+{
+    std::vector<unsigned int> triangles(_voxelizer.totalTriangles());
+    for (unsigned int i = 0; i < triangles.size();++i) triangles[i] = i;
+
+    _builtBricks = 0;
+    _totalVoxels = 0;
+    _failed = false;
+    const bool nonEmpty = buildOctant(outputFile, "", triangles, glm::uvec3(0), depth, 1 << depth);
+    _voxelizer.releaseBricks();
+    if (MemoryTracker::exceeded() || _failed) return false;
+    if (!nonEmpty){
+        // the model has no voxels, write an empty SVO
+        std::stringstream backwards;
+        OfcSVO builder(backwards, depth, _bricks, false);
+        builder.finish();
+        if (!writeReversed(outputFile, backwards.str())) return fail(outputFile);
+    }
+    std::cout << "Built " << _builtBricks << " bricks, total voxels: " << _totalVoxels << "\n";
+    return true;
+}
+
+bool CpuSVOMaker::buildOctant(const std::string& file, const std::string& path, const std::vector<unsigned int>& triangles, glm::uvec3 origin, unsigned int depth, unsigned int resolution)
+{
+    // over the memory budget or after a failed write the octants are not built, the written
+    // octant files are removed
+    if (triangles.empty() || MemoryTracker::exceeded() || _failed) return false;
+
+    const unsigned int size = 1 << depth;
+    if (size <= _maxBrickSize && (triangles.size() <= SPLIT_TRIANGLES || size <= MIN_BRICK_SIZE)){
+        return buildBrick(file, triangles, origin, depth, resolution);
+    }
+
+    // split in 8 octants, every octant is a task with the triangles that touch it
+    const unsigned int half = size/2;
+    std::string childFiles[8];
+    bool nonEmpty[8] = {false};
+    TaskScheduler::TaskGroup group;
+    for (unsigned int i = 0; i < 8;++i){
+        const glm::uvec3 childOrigin = origin + glm::uvec3(i&1, (i>>1)&1, (i>>2)&1)*half;
+        const std::string childPath = path + std::to_string(i);
+        childFiles[i] = "tmp/tmp_task_" + childPath;
+
+        _scheduler.spawn(group, [this, &triangles, &childFiles, &nonEmpty, i, childOrigin, childPath, depth, resolution, half](){
+            // half a voxel of margin, the voxelizer decides which voxels a triangle touches
+            const float voxelSize = 1.f/resolution;
+            std::vector<unsigned int> childTriangles;
+            {
+                Profiler::Scope scope("split");
+                childTriangles = _voxelizer.overlappingTriangles(triangles,
+                    glm::vec3(childOrigin)*voxelSize - glm::vec3(voxelSize/2), (half + 1)*voxelSize);
+            }
+            nonEmpty[i] = buildOctant(childFiles[i], childPath, childTriangles, childOrigin, depth - 1, resolution);
+        });
+    }
+    _scheduler.wait(group);
+
+    if (MemoryTracker::exceeded() || _failed){
+        for (unsigned int i = 0; i < 8;++i){
+            if (nonEmpty[i]) std::remove(childFiles[i].c_str());
+        }
+        return false;
+    }
+    if (std::none_of(nonEmpty, nonEmpty + 8, [](bool b){ return b; })) return false;
+
+    // merge the octant files and remove them
+    std::ifstream octantStreams[8];
+    std::istream* octants[8];
+    for (unsigned int i = 0; i < 8;++i){
+        if (nonEmpty[i]) octantStreams[i].open(childFiles[i], std::ios::binary | std::ios::in);
+        octants[i] = nonEmpty[i]? &octantStreams[i] : nullptr;
+    }
+    bool written = std::all_of(octantStreams, octantStreams + 8, [](const std::ifstream& in){ return (bool)in; });
+    if (written){
+        std::ofstream out(file, std::ios::binary | std::ios::out);
+        SVOMerger::merge(out, octants);
+        out.close();
+        written = (bool)out;
+    }
+    for (unsigned int i = 0; i < 8;++i){
+        if (!nonEmpty[i]) continue;
+        octantStreams[i].close();
+        std::remove(childFiles[i].c_str());
+    }
+    if (!written) return fail(file);
+    return true;
+}
+
+bool CpuSVOMaker::buildBrick(const std::string& file, const std::vector<unsigned int>& triangles, glm::uvec3 origin, unsigned int depth, unsigned int resolution)
+{
+    std::vector<OfcSVO::MortonVoxel> voxels;
+    {
+        Profiler::Scope scope("voxelize");
+        voxels = _voxelizer.voxelize(triangles, origin, 1 << depth, resolution);
+    }
+    if (voxels.empty()) return false;
+    MemoryTracker::Block voxelMemory(MemoryTracker::VOXELIZER, MemoryTracker::bytes(voxels));
+    if (MemoryTracker::exceeded()) return false;
+
+    // build the subtree in memory, it is written backwards
+    Profiler::Scope scope("build");
+    std::stringstream backwards;
+    OfcSVO builder(backwards, depth, _bricks, false);
+    builder.addVoxels(voxels, (uint64_t)1 << (3*depth));
+    builder.finish();
+    // the stream, its string and the reversed copy
+    MemoryTracker::Block subtreeMemory(MemoryTracker::BUILDER, 3*(uint64_t)backwards.tellp());
+    if (!writeReversed(file, backwards.str())) return fail(file);
+
+    _totalVoxels += voxels.size();
+    const uint64_t builtBricks = ++_builtBricks;
+    if (builtBricks % 256 == 0){
+        std::cout << (" Built " + std::to_string(builtBricks) + " bricks\n");
+    }
+    return true;
+}
+
+bool CpuSVOMaker::coarseToFineSvoFile(const char* outputFile, unsigned int depth)
+{
+    const unsigned int resolution = 1 << depth;
+    const unsigned int coarseDepth = std::min((unsigned int)COARSE_DEPTH, depth > 3? depth - 3 : 0);
+    const unsigned int cellSize = 1 << (depth - coarseDepth);
+
+    // bin the triangles in the coarse cells, a task for every block of triangles
+    std::vector<unsigned int> triangles(_voxelizer.totalTriangles());
+    for (unsigned int i = 0; i < triangles.size();++i) triangles[i] = i;
+    const unsigned int totalBlocks = (triangles.size() + BIN_TRIANGLES - 1)/BIN_TRIANGLES;
+    std::vector<std::vector<CpuVoxelizer::CellTriangle>> blockBins(totalBlocks);
+    TaskScheduler::TaskGroup binGroup;
+    for (unsigned int b = 0; b < totalBlocks;++b){
+        _scheduler.spawn(binGroup, [this, &triangles, &blockBins, b, resolution, cellSize](){
+            Profiler::Scope scope("bin");
+            const unsigned int count = std::min((unsigned int)triangles.size() - b*BIN_TRIANGLES, (unsigned int)BIN_TRIANGLES);
+            _voxelizer.binTriangles(&triangles[b*BIN_TRIANGLES], count, glm::uvec3(0), resolution, cellSize, resolution, blockBins[b]);
+        });
+    }
+    _scheduler.wait(binGroup);
+
+    std::vector<CpuVoxelizer::CellTriangle> bins;
+    {
+        Profiler::Scope scope("sort bins");
+        for (unsigned int b = 0; b < totalBlocks;++b){
+            bins.insert(bins.end(), blockBins[b].begin(), blockBins[b].end());
+            std::vector<CpuVoxelizer::CellTriangle>().swap(blockBins[b]);
+        }
+        std::sort(bins.begin(), bins.end(), [](const CpuVoxelizer::CellTriangle& a, const CpuVoxelizer::CellTriangle& b){
+            return a.cell < b.cell || (a.cell == b.cell && a.triangle < b.triangle);
+        });
+    }
+    MemoryTracker::Block binMemory(MemoryTracker::VOXELIZER, MemoryTracker::bytes(bins));
+
+    // the occupied cells in morton order and their first cell triangle
+    std::vector<uint64_t> cells;
+    std::vector<uint64_t> firstBins;
+    for (uint64_t i = 0; i < bins.size();++i){
+        if (i == 0 || bins[i].cell != bins[i - 1].cell){
+            cells.push_back(bins[i].cell);
+            firstBins.push_back(i);
+        }
+    }
+    firstBins.push_back(bins.size());
+    std::cout << "Coarse cells: " << cells.size() << " of " << ((uint64_t)1 << (3*coarseDepth)) << " have triangles\n";
+
+    // refine a batch of cells on all cores, then build their voxels in morton order
+    _totalVoxels = 0;
+    {
+        AsyncWriter writer("tmp/tmp_SVO_backwards");
+        std::ostream SVObackwardsOut(&writer);
+        OfcSVO builder(SVObackwardsOut, depth, _bricks);
+
+        const uint64_t cellVoxels = (uint64_t)cellSize*cellSize*cellSize;
+        const unsigned int batchCells = BATCH_CELLS*_scheduler.totalThreads();
+        std::vector<std::vector<OfcSVO::MortonVoxel>> batch(batchCells);
+        MemoryTracker::Block batchMemory(MemoryTracker::VOXELIZER);
+        for (uint64_t first = 0; first < cells.size() && !MemoryTracker::exceeded(); first += batchCells){
+            const unsigned int count = std::min((uint64_t)batchCells, cells.size() - first);
+            TaskScheduler::TaskGroup group;
+            for (unsigned int i = 0; i < count;++i){
+                _scheduler.spawn(group, [this, &bins, &cells, &firstBins, &batch, first, i, cellSize, resolution](){
+                    const uint64_t c = first + i;
+                    std::vector<unsigned int> cellTriangles;
+                    for (uint64_t b = firstBins[c]; b < firstBins[c + 1];++b){
+                        cellTriangles.push_back(bins[b].triangle);
+                    }
+                    batch[i].clear();
+                    Profiler::Scope scope("refine");
+                    refineCell(cellTriangles, mortonDecode(cells[c])*cellSize, cellSize, resolution, batch[i]);
+                });
+            }
+            _scheduler.wait(group);
+            uint64_t batchBytes = 0;
+            for (unsigned int i = 0; i < count;++i) batchBytes += MemoryTracker::bytes(batch[i]);
+            batchMemory.resize(std::max(batchBytes, batchMemory.bytes()));
+
+            Profiler::Scope scope("build");
+            for (unsigned int i = 0; i < count;++i){
+                builder.addVoxels(batch[i], (cells[first + i] + 1)*cellVoxels);
+                _totalVoxels += batch[i].size();
+            }
+        }
+        _voxelizer.releaseBricks();
+        Profiler::Scope scope("build");
+        builder.finish();
+        if (!writer.close()){
+            std::cout << "Failed to write tmp/tmp_SVO_backwards\n";
+            return false;
+        }
+    }
+    if (MemoryTracker::exceeded()) return false;
+    std::cout << "Total voxels: " << _totalVoxels << "\n";
+
+    std::ofstream out(outputFile, std::ios::binary | std::ios::out);
+    std::ifstream SVObackwardsIn("tmp/tmp_SVO_backwards", std::ios::binary | std::ios::ate | std::ios::in);
+    OfcSVO::reverseNodeFile(out, SVObackwardsIn);
+    out.close();
+    if (!out) return fail(outputFile);
+    return true;
+}
+
+bool CpuSVOMaker::fail(const std::string& file)
+{
+    // the first failed write is reported, the other tasks stop
+    if (!_failed.exchange(true)) std::cout << ("Failed to write " + file + "\n");
+    return false;
+}
+
+void CpuSVOMaker::refineCell(const std::vector<unsigned int>& triangles, glm::uvec3 origin, unsigned int size, unsigned int resolution, std::vector<OfcSVO::MortonVoxel>& voxels)
+{
+    if (size <= LEAF_SIZE){
+        // the morton codes of the cell start at the code of its origin
+        const std::vector<OfcSVO::MortonVoxel> leaf = _voxelizer.voxelize(triangles, origin, size, resolution);
+        const uint64_t base = OfcSVO::mortonEncode_magicbits(origin.x, origin.y, origin.z);
+        for (unsigned int i = 0; i < leaf.size();++i){
+            voxels.push_back({leaf[i].voxel, base + leaf[i].mortonCode});
+        }
+        return;
+    }
+
+    // children with the triangles that overlap them, in the order of the triangles
+    const unsigned int half = size/2;
+    std::vector<CpuVoxelizer::CellTriangle> bins;
+    _voxelizer.binTriangles(triangles.data(), triangles.size(), origin, size, half, resolution, bins);
+    std::vector<unsigned int> children[8];
+    for (unsigned int i = 0; i < bins.size();++i){
+        children[bins[i].cell].push_back(bins[i].triangle);
+    }
+    for (unsigned int i = 0; i < 8;++i){
+        if (children[i].empty()) continue;
+        refineCell(children[i], origin + glm::uvec3(i&1, (i>>1)&1, (i>>2)&1)*half, half, resolution, voxels);
+    }
+}
@@ -0,0 +1,50 @@
+#ifndef CPUSVOMAKER_H
+#define CPUSVOMAKER_H
+
+#include <atomic>
+#include <string>
+#include <vector>
+#include <glm/glm.hpp>
+#include "CpuVoxelizer.h"
+#include "ofcSVO.h"
+#include "TaskScheduler.h"
+#include "../opengl/modelloader.h"
+
+// Builds a plain SVO file with the CPU voxelizer, without OpenGL. Every octant is a task of the
+// work-stealing scheduler: empty octants are pruned, octants with many triangles are split again,
+// the other octants are voxelized and built as a subtree file. Skewed models split deeper where
+// the triangles are, so all cores stay busy. The subtree files are merged with SVOMerger.
+// The coarse-to-fine mode bins the triangles in a coarse grid of cells first and refines only the
+// cells with triangles level by level, the voxels are built straight into one SVO in morton order.
+// Empty space is never visited, so the work grows with the surface of the model, not its volume.
+class CpuSVOMaker
+{
+public:
+    // maxMemory limits the memory of the bricks being voxelized in bytes, 0 is no limit,
+    // 0 threads uses all cores
+    CpuSVOMaker(const ModelLoader::Result& model, bool bricks = false, uint64_t maxMemory = 0, unsigned int totalThreads = 0);
+
+    // false if a file couldn't be written or the memory budget was exceeded
+    bool modelToSvoFile(const char* outputFile, unsigned int depth);
+    bool coarseToFineSvoFile(const char* outputFile, unsigned int depth);
+
+private:
+    // builds the octant of 2^depth voxels wide at origin in file, returns false if it is empty or
+    // a write failed, the files of split octants are named after the octant path
+    bool buildOctant(const std::string& file, const std::string& path, const std::vector<unsigned int>& triangles, glm::uvec3 origin, unsigned int depth, unsigned int resolution);
+    bool buildBrick(const std::string& file, const std::vector<unsigned int>& triangles, glm::uvec3 origin, unsigned int depth, unsigned int resolution);
+    // voxelizes the cell of size^3 voxels at origin, the children with triangles are refined in morton order
+    // stops the build after a failed write, returns false
+    bool fail(const std::string& file);
+    void refineCell(const std::vector<unsigned int>& triangles, glm::uvec3 origin, unsigned int size, unsigned int resolution, std::vector<OfcSVO::MortonVoxel>& voxels);
+
+    CpuVoxelizer _voxelizer;
+    TaskScheduler _scheduler;
+    bool _bricks;
+    unsigned int _maxBrickSize;
+    std::atomic<uint64_t> _builtBricks{0};
+    std::atomic<uint64_t> _totalVoxels{0};
+    std::atomic<bool> _failed{false};
+};
+
+#endif
@@ -0,0 +1,201 @@
+#include "CpuVoxelizer.h"
+#include "TriangleOverlap.h"
+#include "MemoryTracker.h"
+
+#include <iostream>
+#include <algorithm>
+#include <cmath>
+#include <map>
+
+CpuVoxelizer::CpuVoxelizer(const ModelLoader::Result& model)
+    : _store{model.store}
+{
+    std::map<std::string, int> textures;
+    std::vector<std::string> files;
+    for (unsigned int m = 0; m < _store->materials.size();++m){
+        const TriangleStore::Material& material = _store->materials[m];
+        _materialColors.push_back({(uint8_t)(material.diffuse[0]*255), (uint8_t)(material.diffuse[1]*255), (uint8_t)(material.diffuse[2]*255), 255});
+
+        // every texture file once in the texel cache
+        int texture = -1;
+        if (material.textureFile != "" && textures.count(material.textureFile) > 0){
+            texture = textures[material.textureFile];
+        } else if (material.textureFile != ""){
+            texture = files.size();
+            files.push_back(material.textureFile);
+            textures[material.textureFile] = texture;
+        }
+        _materialTextures.push_back(texture);
+    }
+
+    _texels.reset(new TexelCache(files));
+    for (unsigned int m = 0; m < _materialTextures.size();++m){
+        if (_materialTextures[m] >= 0 && !_texels->valid(_materialTextures[m])) _materialTextures[m] = -1;
+    }
+    std::cout << "CPU voxelizer: " << _store->triangles.size() << " triangles, " << files.size() << " textures\n";
+}
+
+glm::vec3 CpuVoxelizer::position(const TriangleStore::Triangle& triangle, unsigned int corner) const
+{
+    const float* p = &_store->positions[3*(uint64_t)triangle.position[corner]];
+    return glm::vec3(p[0], p[1], p[2]);
+}
+
+std::vector<unsigned int> CpuVoxelizer::overlappingTriangles(const std::vector<unsigned int>& triangles, glm::vec3 origin, float size) const
+{
+    const glm::vec3 end = origin + glm::vec3(size);
+    std::vector<unsigned int> result;
+    for (unsigned int i = 0; i < triangles.size();++i){
+        const TriangleStore::Triangle& triangle = _store->triangles[triangles[i]];
+        const glm::vec3 p0 = position(triangle, 0);
+        const glm::vec3 p1 = position(triangle, 1);
+        const glm::vec3 p2 = position(triangle, 2);
+        const glm::vec3 tmin = glm::min(glm::min(p0, p1), p2);
+        const glm::vec3 tmax = glm::max(glm::max(p0, p1), p2);
+        if (tmin.x <= end.x && tmin.y <= end.y && tmin.z <= end.z &&
+            tmax.x >= origin.x && tmax.y >= origin.y && tmax.z >= origin.z){
+            result.push_back(triangles[i]);
+        }
+    }
+    return result;
+}
+
+void CpuVoxelizer::binTriangles(const unsigned int* triangles, unsigned int count, glm::uvec3 origin, unsigned int size, unsigned int cellSize,
+                                unsigned int resolution, std::vector<CellTriangle>& bins) const
+{
+    // the cells are the voxels of a grid with cellSize times larger voxels, the sizes are powers of 2 so the scale is exact
+    const float scale = (float)resolution/cellSize;
+    const glm::uvec3 firstCell = origin/cellSize;
+    thread_local std::vector<glm::uvec3> cells;
+    for (unsigned int i = 0; i < count;++i){
+        const TriangleStore::Triangle& t = _store->triangles[triangles[i]];
+        glm::vec3 v[3];
+        for (unsigned int j = 0; j < 3;++j){
+            v[j] = position(t, j)*scale;
+        }
+
+        cells.clear();
+        TriangleOverlap(v).voxels(firstCell, size/cellSize, cells);
+        for (unsigned int c = 0; c < cells.size();++c){
+            const glm::uvec3 cell = cells[c] - firstCell;
+            bins.push_back({OfcSVO::mortonEncode_magicbits(cell.x, cell.y, cell.z), triangles[i]});
+        }
+    }
+}
+
+std::vector<OfcSVO::MortonVoxel> CpuVoxelizer::voxelize(const std::vector<unsigned int>& triangles, glm::uvec3 origin, unsigned int size, unsigned int resolution) const
+{
+    // take a cleared brick from the pool, it goes back cleared when the call ends
+    Brick pooled;
+    {
+        std::lock_guard<std::mutex> lock(_bricksMutex);
+        if (!_bricks.empty()){
+            pooled = std::move(_bricks.back());
+            _bricks.pop_back();
+        }
+    }
+    std::vector<RGBA8>& brick = pooled.voxels;
+    const uint64_t brickVoxels = (uint64_t)size*size*size;
+    if (brick.size() < brickVoxels){
+        pooled.memory.resize(brickVoxels*sizeof(RGBA8));
+        brick.resize(brickVoxels, {0,0,0,0});
+    }
+    std::vector<uint64_t> setCodes;
+    thread_local std::vector<glm::uvec3> candidates;
+
+    const glm::vec3 brickOrigin(origin);
+    for (unsigned int i = 0; i < triangles.size();++i){
+        const TriangleStore::Triangle& t = _store->triangles[triangles[i]];
+
+        // triangle in the voxel coordinates of the grid
+        glm::vec3 p[3];
+        glm::vec3 v[3];
+        for (unsigned int j = 0; j < 3;++j){
+            p[j] = position(t, j);
+            v[j] = p[j]*(float)resolution;
+        }
+        const float footprint = texelFootprint(t, p, resolution);
+
+        candidates.clear();
+        TriangleOverlap(v).voxels(origin, size, candidates);
+        for (unsigned int c = 0; c < candidates.size();++c){
+            const glm::uvec3 voxel = candidates[c] - origin;
+            const uint64_t code = OfcSVO::mortonEncode_magicbits(voxel.x, voxel.y, voxel.z);
+            if (brick[code].A > 0) continue;
+
+            const glm::vec3 center(voxel.x + 0.5f, voxel.y + 0.5f, voxel.z + 0.5f);
+            const RGBA8 color = triangleColor(t, p, (center + brickOrigin)/(float)resolution, footprint);
+            if (color.A == 0) continue;
+            brick[code] = color;
+            setCodes.push_back(code);
+        }
+    }
+
+    // collect the voxels in morton order and clear the brick for the next call
+    std::sort(setCodes.begin(), setCodes.end());
+    std::vector<OfcSVO::MortonVoxel> voxels;
+    voxels.reserve(setCodes.size());
+    for (unsigned int i = 0; i < setCodes.size();++i){
+        voxels.push_back({brick[setCodes[i]], setCodes[i]});
+        brick[setCodes[i]] = {0,0,0,0};
+    }
+    std::lock_guard<std::mutex> lock(_bricksMutex);
+    _bricks.push_back(std::move(pooled));
+    return voxels;
+}
+
+void CpuVoxelizer::releaseBricks()
+{
+    std::lock_guard<std::mutex> lock(_bricksMutex);
+    _bricks.clear();
+    _bricks.shrink_to_fit();
+}
+
+float CpuVoxelizer::texelFootprint(const TriangleStore::Triangle& t, const glm::vec3 p[3], unsigned int resolution) const
+{
+    const int texture = _materialTextures[t.material];
+    if (texture < 0) return 0;
+
+    // texels per model area from the areas of the triangle on the texture and in the model
+    const glm::ivec2 size = _texels->size(texture);
+    glm::vec2 uv[3];
+    for (unsigned int c = 0; c < 3;++c){
+        uv[c] = glm::vec2(TriangleStore::fromHalf(t.texcoord[c][0])*size.x, TriangleStore::fromHalf(t.texcoord[c][1])*size.y);
+    }
+    const glm::vec2 t0 = uv[1] - uv[0];
+    const glm::vec2 t1 = uv[2] - uv[0];
+    const float texelArea = 0.5f*std::abs(t0.x*t1.y - t0.y*t1.x);
+    const float modelArea = 0.5f*glm::length(glm::cross(p[1] - p[0], p[2] - p[0]));
+    if (modelArea <= 0) return 0;
+    return std::sqrt(texelArea/modelArea)/resolution;
+}
+
+RGBA8 CpuVoxelizer::triangleColor(const TriangleStore::Triangle& t, const glm::vec3 p[3], glm::vec3 point, float footprint) const
+{
+    const int texture = _materialTextures[t.material];
+    if (texture < 0) return _materialColors[t.material];
+
+    // barycentric coordinates of the point projected on the triangle
+    const glm::vec3 e0 = p[1] - p[0];
+    const glm::vec3 e1 = p[2] - p[0];
+    const glm::vec3 ep = point - p[0];
+    const float d00 = glm::dot(e0, e0);
+    const float d01 = glm::dot(e0, e1);
+    const float d11 = glm::dot(e1, e1);
+    const float dp0 = glm::dot(ep, e0);
+    const float dp1 = glm::dot(ep, e1);
+    const float denominator = d00*d11 - d01*d01;
+    float b1 = 0, b2 = 0;
+    if (denominator > 0){
+        b1 = glm::clamp((d11*dp0 - d01*dp1)/denominator, 0.f, 1.f);
+        b2 = glm::clamp((d00*dp1 - d01*dp0)/denominator, 0.f, 1.f - b1);
+    }
+    glm::vec2 uv(0);
+    const float weights[3] = {1 - b1 - b2, b1, b2};
+    for (unsigned int c = 0; c < 3;++c){
+        uv += weights[c]*glm::vec2(TriangleStore::fromHalf(t.texcoord[c][0]), TriangleStore::fromHalf(t.texcoord[c][1]));
+    }
+
+    // average of the texels in the voxel
+    return _texels->samplePatch(texture, uv, footprint);
+}
@@ -0,0 +1,67 @@
+#ifndef CPUVOXELIZER_H
+#define CPUVOXELIZER_H
+
+#include <vector>
+#include <memory>
+#include <mutex>
+#include <glm/glm.hpp>
+#include "structs.h"
+#include "ofcSVO.h"
+#include "TexelCache.h"
+#include "MemoryTracker.h"
+#include "../opengl/modelloader.h"
+
+// Voxelizes the triangles of a model on the CPU. It needs no OpenGL context, so bricks can be
+// voxelized on any thread at the same time. A voxel is set when a triangle overlaps the voxel cube
+// (TriangleOverlap). Like the GPU voxelizer the first triangle that sets a voxel gives its
+// color: the average texture color of the part of the triangle in the voxel when the model has
+// a texture, the material color otherwise.
+class CpuVoxelizer
+{
+public:
+    CpuVoxelizer(const ModelLoader::Result& model);
+
+    unsigned int totalTriangles() const { return _store->triangles.size(); }
+
+    // a triangle that touches a cell, the cell is its morton code in the cube it was binned in
+    struct CellTriangle{
+        uint64_t cell;
+        unsigned int triangle;
+    };
+
+    // triangles of the list that touch the cube at origin with size, in model coordinates
+    std::vector<unsigned int> overlappingTriangles(const std::vector<unsigned int>& triangles, glm::vec3 origin, float size) const;
+    // adds a cell triangle for every cell of cellSize^3 voxels in the cube of size^3 voxels at origin that a triangle
+    // overlaps, in a grid of resolution^3 voxels. The cell triangles of a cell are in the order of the triangles.
+    void binTriangles(const unsigned int* triangles, unsigned int count, glm::uvec3 origin, unsigned int size, unsigned int cellSize,
+                      unsigned int resolution, std::vector<CellTriangle>& bins) const;
+
+    // voxelizes the brick of size^3 voxels at origin in a grid of resolution^3 voxels,
+    // the voxels are sorted in morton order, the morton codes are local to the brick
+    std::vector<OfcSVO::MortonVoxel> voxelize(const std::vector<unsigned int>& triangles, glm::uvec3 origin, unsigned int size, unsigned int resolution) const;
+    // frees the dense bricks kept for reuse between voxelize calls, call it when a voxelize pass ends
+    void releaseBricks();
+
+private:
+    // dense brick indexed by local morton code, an alpha of 0 is an empty voxel
+    struct Brick{
+        std::vector<RGBA8> voxels;
+        MemoryTracker::Block memory{MemoryTracker::VOXELIZER};
+    };
+
+    glm::vec3 position(const TriangleStore::Triangle& triangle, unsigned int corner) const;
+    // footprint of a voxel on the texture of the triangle in texels, 0 without texture
+    float texelFootprint(const TriangleStore::Triangle& triangle, const glm::vec3 p[3], unsigned int resolution) const;
+    RGBA8 triangleColor(const TriangleStore::Triangle& triangle, const glm::vec3 p[3], glm::vec3 point, float footprint) const;
+
+    // the triangles are read from the store of the model
+    std::shared_ptr<const TriangleStore> _store;
+    std::vector<RGBA8> _materialColors;
+    std::vector<int> _materialTextures;     // -1 is no texture
+    std::unique_ptr<TexelCache> _texels;
+    // cleared bricks that a voxelize call can take, one per thread voxelizing at the same time
+    mutable std::mutex _bricksMutex;
+    mutable std::vector<Brick> _bricks;
+};
+
+#endif
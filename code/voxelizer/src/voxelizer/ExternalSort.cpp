@@ -0,0 +1,367 @@
+#include "ExternalSort.h"
+#include "AsyncWriter.h"
+#include "Profiler.h"
+
+#include <iostream>
+#include <algorithm>
+#include <cstring>
+#include <cstdio>
+#include <chrono>
+
+#define RECORD_BYTES 12                     // <morton code:64><RGBA:32>
+#define IO_BUFFER_VOXELS (1 << 16)          // voxels per read or write of a run, 768 KB
+#define MAX_MERGE_RUNS 128                  // runs merged at once
+#define MERGE_BATCH_VOXELS (1 << 20)        // voxels per call to the SVO builder
+#define RUN_FILE "tmp/tmp_run_"
+
+ExternalSort::ExternalSort(const char* runFile, uint64_t runVoxels)
+    : _runFile{runFile}, _runVoxels{std::max(runVoxels, (uint64_t)1)}
+{
+}
+
+ExternalSort::~ExternalSort()
+{
+    _runs.clear();
+    for (unsigned int i = 0; i < _runFiles.size();++i){
+        std::remove(_runFiles[i].c_str());
+    }
+}
+
+void ExternalSort::add(const OfcSVO::MortonVoxel& voxel)
+{
+    if (_voxels.capacity() == 0){
+        // the run doesn't grow past its size
+        _memory.resize(_runVoxels*sizeof(OfcSVO::MortonVoxel));
+        _voxels.reserve(_runVoxels);
+    }
+    _voxels.push_back(voxel);
+    if (_voxels.size() >= _runVoxels){
+        spillRun();
+    }
+}
+
+void ExternalSort::add(const Voxel& voxel)
+{
+    add({voxel.RGBA, OfcSVO::mortonEncode_magicbits(voxel.XYZ[0], voxel.XYZ[1], voxel.XYZ[2])});
+}
+
+std::string ExternalSort::newRunFile()
+{
+    const std::string file = _runFile + std::to_string(_totalRunFiles);
+    _totalRunFiles += 1;
+    return file;
+}
+
+void ExternalSort::spillRun()
+{
+    Profiler::Scope scope("sort run");
+    std::sort(_voxels.begin(), _voxels.end(), [](const OfcSVO::MortonVoxel& a, const OfcSVO::MortonVoxel& b){
+        return a.mortonCode < b.mortonCode;
+    });
+
+    const std::string file = newRunFile();
+    std::ofstream out(file, std::ios::binary | std::ios::out);
+    if (!out.is_open()){
+        std::cout << "Failed to create run file " << file << "\n";
+        throw;
+    }
+    _runFiles.push_back(file);
+    writeRun(out, _voxels);
+
+    std::cout << " Spilled run " << _runFiles.size() << " with " << _voxels.size() << " voxels\n";
+    _voxels.clear();
+}
+
+void ExternalSort::writeRun(std::ofstream &out, const std::vector<OfcSVO::MortonVoxel>& voxels)
+{
+    // pack the voxels and write them in large blocks
+    std::vector<char> buffer(IO_BUFFER_VOXELS*RECORD_BYTES);
+    for (uint64_t i = 0; i < voxels.size(); i += IO_BUFFER_VOXELS){
+        const uint64_t totalVoxels = std::min((uint64_t)IO_BUFFER_VOXELS, voxels.size() - i);
+        for (uint64_t j = 0; j < totalVoxels;++j){
+            memcpy(&buffer[j*RECORD_BYTES], &voxels[i + j].mortonCode, 8);
+            memcpy(&buffer[j*RECORD_BYTES + 8], &voxels[i + j].voxel, 4);
+        }
+        out.write(buffer.data(), totalVoxels*RECORD_BYTES);
+    }
+}
+
+void ExternalSort::finishRuns()
+{
+    Profiler::Scope scope("sort run");
+    // the last run stays in memory
+    std::sort(_voxels.begin(), _voxels.end(), [](const OfcSVO::MortonVoxel& a, const OfcSVO::MortonVoxel& b){
+        return a.mortonCode < b.mortonCode;
+    });
+    _memoryPos = 0;
+
+    while (_runFiles.size() > MAX_MERGE_RUNS){
+        // merge the oldest runs in one larger run
+        std::vector<std::string> files(_runFiles.begin(), _runFiles.begin() + MAX_MERGE_RUNS);
+        _runFiles.erase(_runFiles.begin(), _runFiles.begin() + MAX_MERGE_RUNS);
+        openRuns(files, false);
+
+        const std::string file = newRunFile();
+        std::ofstream out(file, std::ios::binary | std::ios::out);
+        if (!out.is_open()){
+            std::cout << "Failed to create run file " << file << "\n";
+            throw;
+        }
+        // duplicates are kept, they are only combined in the last merge to get the right average
+        std::vector<OfcSVO::MortonVoxel> block;
+        block.reserve(IO_BUFFER_VOXELS);
+        OfcSVO::MortonVoxel voxel;
+        while (pop(voxel)){
+            block.push_back(voxel);
+            if (block.size() >= IO_BUFFER_VOXELS){
+                writeRun(out, block);
+                block.clear();
+            }
+        }
+        writeRun(out, block);
+
+        _runs.clear();
+        for (unsigned int i = 0; i < files.size();++i){
+            std::remove(files[i].c_str());
+        }
+        _runFiles.push_back(file);
+        std::cout << " Merged " << files.size() << " runs\n";
+    }
+
+    openRuns(_runFiles, true);
+}
+
+void ExternalSort::openRuns(const std::vector<std::string>& files, bool memoryRun)
+{
+    _runs.clear();
+    _memory.resize(MemoryTracker::bytes(_voxels) + files.size()*IO_BUFFER_VOXELS*RECORD_BYTES);
+    _runs.resize(files.size() + (memoryRun? 1 : 0));
+    for (unsigned int i = 0; i < _runs.size();++i){
+        if (i < files.size()){
+            _runs[i].in.open(files[i], std::ios::binary | std::ios::ate);
+            if (!_runs[i].in.is_open()){
+                std::cout << "Failed to open run file " << files[i] << "\n";
+                throw;
+            }
+            _runs[i].remaining = _runs[i].in.tellg()/RECORD_BYTES;
+            _runs[i].in.seekg(0, std::ios::beg);
+            _runs[i].buffer.resize(IO_BUFFER_VOXELS*RECORD_BYTES);
+        } else{
+            _runs[i].inMemory = true;
+            _runs[i].remaining = _voxels.size();
+        }
+        advance(i);
+    }
+
+    // leaves are at _runs.size() + run
+    _loserTree.assign(std::max(_runs.size(), (size_t)1), 0);
+    _loserTree[0] = buildTree(1);
+}
+
+void ExternalSort::advance(unsigned int run)
+{
+    Run& r = _runs[run];
+    if (r.remaining == 0){
+        r.done = true;
+        return;
+    }
+    r.remaining -= 1;
+
+    if (r.inMemory){
+        r.current = _voxels[_memoryPos++];
+        return;
+    }
+
+    if (r.bufferPos >= r.bufferVoxels){
+        // read the next block of the run
+        r.bufferVoxels = std::min((uint64_t)IO_BUFFER_VOXELS, r.remaining + 1);
+        r.in.read(r.buffer.data(), r.bufferVoxels*RECORD_BYTES);
+        r.bufferPos = 0;
+    }
+    memcpy(&r.current.mortonCode, &r.buffer[r.bufferPos*RECORD_BYTES], 8);
+    memcpy(&r.current.voxel, &r.buffer[r.bufferPos*RECORD_BYTES + 8], 4);
+    r.bufferPos += 1;
+}
+
+bool ExternalSort::less(unsigned int a, unsigned int b) const
+{
+    // finished runs lose from every other run
+    if (_runs[a].done != _runs[b].done) return _runs[b].done;
+    if (_runs[a].done) return a < b;
+    if (_runs[a].current.mortonCode != _runs[b].current.mortonCode){
+        return _runs[a].current.mortonCode < _runs[b].current.mortonCode;
+    }
+    return a < b;
+}
+
+unsigned int ExternalSort::buildTree(unsigned int node)
+{
+    // returns the winner of the subtree and stores the loser in the node
+    const unsigned int totalRuns = _runs.size();
+    if (node >= totalRuns) return node - totalRuns;
+
+    const unsigned int a = buildTree(2*node);
+    const unsigned int b = buildTree(2*node + 1);
+    if (less(a, b)){
+        _loserTree[node] = b;
+        return a;
+    }
+    _loserTree[node] = a;
+    return b;
+}
+
+void ExternalSort::replay(unsigned int run)
+{
+    // play the new voxel of the run against the losers on the path to the root
+    unsigned int winner = run;
+    for (unsigned int node = (run + _runs.size())/2; node > 0; node /= 2){
+        if (less(_loserTree[node], winner)){
+            std::swap(_loserTree[node], winner);
+        }
+    }
+    _loserTree[0] = winner;
+}
+
+bool ExternalSort::pop(OfcSVO::MortonVoxel& voxel)
+{
+    const unsigned int winner = _loserTree[0];
+    if (_runs[winner].done) return false;
+
+    voxel = _runs[winner].current;
+    advance(winner);
+    replay(winner);
+    return true;
+}
+
+bool ExternalSort::next(OfcSVO::MortonVoxel& voxel)
+{
+    unsigned int winner = _loserTree[0];
+    if (_runs[winner].done) return false;
+
+    voxel = _runs[winner].current;
+    uint64_t R = 0, G = 0, B = 0, A = 0, total = 0;
+    while (!_runs[winner].done && _runs[winner].current.mortonCode == voxel.mortonCode){
+        // combine all voxels with the same morton code
+        const RGBA8 rgba = _runs[winner].current.voxel;
+        R += rgba.R;
+        G += rgba.G;
+        B += rgba.B;
+        A += rgba.A;
+        total += 1;
+
+        advance(winner);
+        replay(winner);
+        winner = _loserTree[0];
+    }
+    voxel.voxel = {(uint8_t)(R/total), (uint8_t)(G/total), (uint8_t)(B/total), (uint8_t)(A/total)};
+    return true;
+}
+
+void ExternalSort::merge(OfcSVO &builder)
+{
+    finishRuns();
+    std::cout << "Merging " << _runs.size() << " sorted runs...\n";
+    Profiler::Scope scope("merge runs");
+
+    std::vector<OfcSVO::MortonVoxel> batch;
+    batch.reserve(MERGE_BATCH_VOXELS);
+    OfcSVO::MortonVoxel voxel;
+    while (next(voxel)){
+        // a batch ends on a brick boundary so no brick is split over 2 batches
+        const uint64_t brickCode = voxel.mortonCode / BRICK_VOXELS * BRICK_VOXELS;
+        if (batch.size() >= MERGE_BATCH_VOXELS && brickCode > batch.back().mortonCode){
+            builder.addVoxels(batch, brickCode);
+            batch.clear();
+        }
+        batch.push_back(voxel);
+    }
+    builder.addVoxels(batch, UINT64_MAX);
+}
+
+bool ExternalSort::buildFile(const char* voxelFile, const char* outputFile, unsigned int depth, uint64_t maxMemory, bool bricks)
+{
+    std::ifstream in(voxelFile, std::ios::binary | std::ios::ate);
+    if (!in.is_open()){
+        std::cout << "Failed to open voxel file\n";
+        return false;
+    }
+    const uint64_t totalVoxels = in.tellg()/sizeof(Voxel);
+    in.seekg(0, std::ios::beg);
+    std::cout << "Sorting " << totalVoxels << " voxels in morton order...\n";
+
+    // read the voxels in blocks and add them to the runs
+    ExternalSort sorter(RUN_FILE, maxMemory/sizeof(OfcSVO::MortonVoxel));
+    std::vector<Voxel> block(IO_BUFFER_VOXELS);
+    for (uint64_t i = 0; i < totalVoxels; i += IO_BUFFER_VOXELS){
+        const uint64_t voxels = std::min((uint64_t)IO_BUFFER_VOXELS, totalVoxels - i);
+        in.read((char*)block.data(), voxels*sizeof(Voxel));
+        for (uint64_t j = 0; j < voxels;++j){
+            sorter.add(block[j]);
+        }
+    }
+
+    {
+        AsyncWriter writer("tmp/tmp_SVO_backwards");
+        std::ostream SVObackwardsOut(&writer);
+        OfcSVO builder(SVObackwardsOut, depth, bricks);
+        sorter.merge(builder);
+        builder.finish();
+        if (!writer.close()){
+            std::cout << "Failed to write tmp/tmp_SVO_backwards\n";
+            return false;
+        }
+    }
+
+    std::ofstream out(outputFile, std::ios_base::binary | std::ios::out);
+    std::ifstream SVObackwardsIn("tmp/tmp_SVO_backwards", std::ios::binary | std::ios::ate | std::ios::in);
+    OfcSVO::reverseNodeFile(out, SVObackwardsIn);
+    return (bool)out;
+}
+
+void ExternalSort::benchmark(uint64_t totalVoxels, uint64_t maxMemory, unsigned int depth, bool build)
+{
+    std::cout << "Sorting " << totalVoxels << " random voxels at depth " << depth << " with " << maxMemory/(1024*1024) << " MB of memory\n";
+    typedef std::chrono::steady_clock Clock;
+    const auto seconds = [](Clock::time_point begin){
+        return std::chrono::duration<double>(Clock::now() - begin).count();
+    };
+
+    // random morton codes from a xorshift generator
+    const uint64_t codeMask = depth >= 21? ~(uint64_t)0 : ((uint64_t)1 << (3*depth)) - 1;
+    uint64_t state = 88172645463325252ull;
+
+    ExternalSort sorter(RUN_FILE, maxMemory/sizeof(OfcSVO::MortonVoxel));
+    Clock::time_point begin = Clock::now();
+    for (uint64_t i = 0; i < totalVoxels;++i){
+        state ^= state << 13;
+        state ^= state >> 7;
+        state ^= state << 17;
+        sorter.add(OfcSVO::MortonVoxel{{(uint8_t)state, (uint8_t)(state >> 8), (uint8_t)(state >> 16), 255}, state & codeMask});
+    }
+    const double runTime = seconds(begin);
+
+    begin = Clock::now();
+    uint64_t mergedVoxels = 0;
+    if (build){
+        AsyncWriter writer("tmp/tmp_SVO_backwards");
+        std::ostream SVObackwardsOut(&writer);
+        OfcSVO builder(SVObackwardsOut, depth, false);
+        sorter.merge(builder);
+        builder.finish();
+        if (!writer.close()) std::cout << "Failed to write tmp/tmp_SVO_backwards\n";
+    } else{
+        sorter.finishRuns();
+        OfcSVO::MortonVoxel voxel;
+        while (sorter.next(voxel)){
+            mergedVoxels += 1;
+        }
+    }
+    const double mergeTime = seconds(begin);
+
+    std::cout << "Spilled runs: " << sorter.totalRuns() << "\n";
+    std::cout << "Sort and spill: " << runTime << " s, " << totalVoxels/runTime/1e6 << " M voxels/s\n";
+    std::cout << (build? "Merge and build: " : "Merge: ") << mergeTime << " s, " << totalVoxels/mergeTime/1e6 << " M voxels/s\n";
+    if (!build){
+        std::cout << "Unique voxels: " << mergedVoxels << "\n";
+    }
+}
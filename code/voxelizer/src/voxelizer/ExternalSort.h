@@ -0,0 +1,72 @@
+#ifndef EXTERNALSORT_H
+#define EXTERNALSORT_H
+
+#include <fstream>
+#include <string>
+#include <vector>
+#include "ofcSVO.h"
+#include "MemoryTracker.h"
+
+// Sorts voxels in morton order when they don't fit in memory. The voxels are collected in runs
+// of runVoxels, every full run is sorted and spilled to disk as packed <morton code:64><RGBA:32>
+// records. The runs are merged with a loser tree, voxels with the same morton code are combined
+// in one voxel with the average color. When there are too many runs to merge at once, groups of
+// runs are first merged in larger runs.
+class ExternalSort
+{
+public:
+    ExternalSort(const char* runFile, uint64_t runVoxels);
+    ~ExternalSort();
+
+    void add(const OfcSVO::MortonVoxel& voxel);
+    void add(const Voxel& voxel);
+
+    // ends adding voxels, the voxels can be read in morton order with next()
+    void finishRuns();
+    bool next(OfcSVO::MortonVoxel& voxel);
+
+    // streams all voxels to the SVO builder, the builder is not finished
+    void merge(OfcSVO &builder);
+
+    uint64_t totalRuns() const { return _runFiles.size(); }
+
+    // builds an SVO from a file of unsorted voxels, stored as Voxel structs, false if a file couldn't be written
+    static bool buildFile(const char* voxelFile, const char* outputFile, unsigned int depth, uint64_t maxMemory, bool bricks);
+    // sorts random voxels and reports the throughput of every stage
+    static void benchmark(uint64_t totalVoxels, uint64_t maxMemory, unsigned int depth, bool build);
+
+private:
+    struct Run{
+        std::ifstream in;
+        std::vector<char> buffer;
+        uint64_t bufferPos = 0;
+        uint64_t bufferVoxels = 0;
+        uint64_t remaining = 0;             // voxels not yet read from the file or the memory run
+        OfcSVO::MortonVoxel current;
+        bool inMemory = false;
+        bool done = false;
+    };
+
+    void spillRun();
+    void openRuns(const std::vector<std::string>& files, bool memoryRun);
+    void writeRun(std::ofstream &out, const std::vector<OfcSVO::MortonVoxel>& voxels);
+    std::string newRunFile();
+    void advance(unsigned int run);
+    bool less(unsigned int a, unsigned int b) const;
+    unsigned int buildTree(unsigned int node);
+    void replay(unsigned int run);
+    bool pop(OfcSVO::MortonVoxel& voxel);
+
+    std::string _runFile;
+    uint64_t _runVoxels;
+    std::vector<OfcSVO::MortonVoxel> _voxels;    // run in memory
+    uint64_t _memoryPos = 0;
+    std::vector<std::string> _runFiles;
+    unsigned int _totalRunFiles = 0;
+
+    std::vector<Run> _runs;                     // runs being merged
+    std::vector<unsigned int> _loserTree;       // _loserTree[0] is the winner
+    MemoryTracker::Block _memory{MemoryTracker::SORT};     // the memory run and the read buffers
+};
+
+#endif
@@ -0,0 +1,151 @@
+#include "FarPointers.h"
+#include "MappedFile.h"
+#include "NodeTree.h"
+#include "Profiler.h"
+#include "ofcSVO.h"
+
+#include <iostream>
+#include <fstream>
+
+#define WRITE_BLOCK_WORDS (1 << 16)
+
+bool FarPointers::convert(const char* svoFile, const char* outputFile, const char* tableFile, unsigned int bricksDepth)
+{
+    MappedFile file(svoFile);
+    if (!file.isOpen() || file.size() < 8){
+        std::cout << "Failed to open " << svoFile << "\n";
+        return false;
+    }
+    std::cout << "Replacing the refer nodes of " << svoFile << " by far pointers...\n";
+    Profiler::Scope scope("far pointers");
+
+    const uint64_t totalWords = file.size()/8;
+    const NodeTree tree(file.data(), totalWords, {}, bricksDepth);
+
+    // find the nodes and the refer words, the other words are bricks and are kept as they are
+    std::vector<bool> isNode(totalWords, false);
+    std::vector<uint64_t> referBits((totalWords + 63)/64, 0);
+    std::vector<std::pair<uint64_t, unsigned int>> stack{{0, 0}};
+    while (!stack.empty()){
+        const uint64_t pointer = stack.back().first;
+        const unsigned int level = stack.back().second;
+        stack.pop_back();
+        isNode[pointer] = true;
+
+        const Node node = tree.node(pointer);
+        if (node.childBits == 0 || node.childOffset == 0) continue;
+        uint64_t referWord;
+        const uint64_t children = tree.children(pointer, node, &referWord);
+        if (referWord != NodeTree::NO_POINTER) referBits[referWord/64] |= (uint64_t)1 << (referWord%64);
+        if (level == tree.brickLevel()) continue;
+
+        const unsigned int totalChildren = __builtin_popcount(node.childBits);
+        for (unsigned int c = 0; c < totalChildren && children + c < totalWords;++c){
+            stack.push_back({children + c, level + 1});
+        }
+    }
+
+    // refer words in front of every block of 64 words, a word moves forward by the refer words in front of it
+    std::vector<uint64_t> referRank(referBits.size() + 1, 0);
+    for (uint64_t b = 0; b < referBits.size();++b){
+        referRank[b + 1] = referRank[b] + __builtin_popcountll(referBits[b]);
+    }
+    const auto newPointer = [&referBits, &referRank](uint64_t pointer){
+        const uint64_t below = referBits[pointer/64] & (((uint64_t)1 << (pointer%64)) - 1);
+        return pointer - referRank[pointer/64] - __builtin_popcountll(below);
+    };
+    const auto isRefer = [&referBits](uint64_t pointer){
+        return (referBits[pointer/64] >> (pointer%64)) & 1;
+    };
+
+    std::ofstream out(outputFile, std::ios::binary | std::ios::out);
+    if (!out.is_open()){
+        std::cout << "Failed to open " << outputFile << "\n";
+        return false;
+    }
+
+    std::vector<uint64_t> table{0};
+    // refer nodes whose children are close enough now
+    uint64_t referFits = 0;
+    std::vector<uint8_t> block;
+    block.reserve(8*WRITE_BLOCK_WORDS);
+    uint8_t bytes[8];
+    for (uint64_t pointer = 0; pointer < totalWords;++pointer){
+        if (isRefer(pointer)) continue;
+
+        uint64_t word = tree.word(pointer);
+        if (isNode[pointer]){
+            Node node = NodeRead::decode(word);
+            uint64_t referWord;
+            const uint64_t children = tree.children(pointer, node, &referWord);
+
+            if (node.childBits > 0 && node.childOffset > 0 && children < totalWords){
+                const uint64_t offset = newPointer(children) - newPointer(pointer);
+                if (offset < (1 << TOTAL_CHILDOFFSET_BITS)){
+                    if (referWord != NodeTree::NO_POINTER) referFits += 1;
+                    node.referBit = false;
+                    node.childOffset = offset;
+                } else if (table.size() < (1 << TOTAL_CHILDOFFSET_BITS)){
+                    node.referBit = true;
+                    node.childOffset = table.size();
+                    table.push_back(offset);
+                } else{
+                    std::cout << "Too many far pointers for a 23 bit index, " << outputFile << " is not complete\n";
+                    return false;
+                }
+                word = NodeRead::encode(node);
+            }
+        }
+
+        NodeRead::toBytes(word, bytes);
+        block.insert(block.end(), bytes, bytes + 8);
+        if (block.size() >= 8*WRITE_BLOCK_WORDS){
+            out.write((const char*)block.data(), block.size());
+            block.clear();
+        }
+    }
+    out.write((const char*)block.data(), block.size());
+
+    std::ofstream tableOut(tableFile, std::ios::binary | std::ios::out);
+    if (!tableOut.is_open()){
+        std::cout << "Failed to open " << tableFile << "\n";
+        return false;
+    }
+    NodeRead::toBytes(table.size(), bytes);
+    tableOut.write((const char*)bytes, 8);
+    for (uint64_t i = 0; i < table.size();++i){
+        NodeRead::toBytes(table[i], bytes);
+        tableOut.write((const char*)bytes, 8);
+    }
+
+    const uint64_t referNodes = referRank.back();
+    const uint64_t farPointers = table.size() - 1;
+    Profiler::add(Profiler::ALL_BYTES_WRITTEN, 8*(totalWords - referNodes) + 8*(table.size() + 1));
+    std::cout << " Refer nodes avoided: " << referNodes << " of " << totalWords << " words, far pointers: " << farPointers
+              << ", offsets that fit without a refer node: " << referFits << "\n";
+    std::cout << " Size: " << 8*totalWords << " -> " << 8*(totalWords - referNodes) << " bytes, far pointer table: "
+              << 8*(table.size() + 1) << " bytes\n";
+    return true;
+}
+
+std::vector<uint64_t> FarPointers::readTable(const char* tableFile)
+{
+    std::ifstream in(tableFile, std::ios::binary | std::ios::ate);
+    if (!in.is_open()) return {};
+    const uint64_t fileSize = in.tellg();
+    in.seekg(0, std::ios::beg);
+    uint8_t bytes[8];
+    if (!in.read((char*)bytes, 8)) return {};
+
+    // the count is checked against the file before the table is allocated
+    const uint64_t count = NodeRead::fromBytes(bytes);
+    if (count > (fileSize - 8)/8){
+        std::cout << "The far pointer table " << tableFile << " is truncated or corrupt\n";
+        return {};
+    }
+    std::vector<uint64_t> table(count);
+    for (uint64_t i = 0; i < table.size() && in.read((char*)bytes, 8);++i){
+        table[i] = NodeRead::fromBytes(bytes);
+    }
+    return table;
+}
@@ -0,0 +1,24 @@
+#ifndef FARPOINTERS_H
+#define FARPOINTERS_H
+
+#include <vector>
+#include <cstdint>
+
+// Far pointers replace the refer nodes of an SVO file in the 64 bit node format. The refer words
+// are removed from the file, which moves most children close enough to their parent for a 23 bit
+// child offset. A node whose offset still doesn't fit gets the refer bit and the child offset is
+// an index in a side table with the 64 bit offset, so no node needs an extra word in the pages.
+// Entry 0 of the table is unused, a child offset of 0 still is a leaf.
+//
+// Table file: <total entries:64><offset:64 for every entry>
+class FarPointers
+{
+public:
+    // with bricks the depth tells the level of the brick pointers, 0 is a file without bricks
+    static bool convert(const char* svoFile, const char* outputFile, const char* tableFile, unsigned int bricksDepth = 0);
+
+    // an empty table if the file doesn't exist or its count doesn't fit in the file
+    static std::vector<uint64_t> readTable(const char* tableFile);
+};
+
+#endif
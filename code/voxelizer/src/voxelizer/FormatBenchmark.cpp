@@ -0,0 +1,335 @@
+#include "FormatBenchmark.h"
+#include "ofcSVO.h"
+#include "SVO.h"
+#include "SVOSaver.h"
+#include "NodeRead.h"
+#include "ColorDeltaCoder.h"
+#include "PageCoder.h"
+#include "MemoryTracker.h"
+
+#include <iostream>
+#include <fstream>
+#include <chrono>
+#include <random>
+#include <algorithm>
+#include <iomanip>
+#include <cstdio>
+
+#define RANDOM_PAGES 2000       // pages decoded one by one for the latency
+#define LEGACY_MAX_DEPTH 10     // the in memory SVO of deeper models doesn't fit in memory
+#define READ_PADDING 8          // zero bytes behind a file, the bit reader reads whole bytes
+#define BATCH_VOXELS (1 << 20)  // voxels streamed to the brick builder at once
+
+static const char* BACKWARDS_FILE = "tmp/tmp_formats_backwards";
+static const char* BRICKS_FILE = "tmp/tmp_formats_bricks.svo";
+static const char* COLOR_DELTA_FILE = "tmp/tmp_formats.cd";
+static const char* COMPRESSED_FILE = "tmp/tmp_formats.pc";
+static const char* OPT_FILE = "tmp/tmp_formats.opt";
+
+// reads totalBits <= 32 bits from the bit pointer, bits are stored from MSB to LSB
+static uint64_t readBits(const uint8_t* bytes, uint64_t bitPointer, unsigned int totalBits)
+{
+    const uint8_t* p = bytes + bitPointer/8;
+    uint64_t value = 0;
+    for (unsigned int i = 0; i < 5;++i){
+        value = (value << 8) | p[i];
+    }
+    return (value >> (40 - bitPointer % 8 - totalBits)) & ((1ull << totalBits) - 1);
+}
+
+static unsigned int readUint32(const uint8_t* bytes)
+{
+    return (bytes[0] << 24) | (bytes[1] << 16) | (bytes[2] << 8) | bytes[3];
+}
+
+std::vector<uint8_t> FormatBenchmark::readFile(const char* file)
+{
+    std::ifstream in(file, std::ios::binary | std::ios::ate);
+    if (!in.is_open()) return {};
+    const uint64_t size = in.tellg();
+    std::vector<uint8_t> bytes(size);
+    in.seekg(0, std::ios::beg);
+    in.read((char*)bytes.data(), size);
+    return bytes;
+}
+
+uint64_t FormatBenchmark::decodeVoxels(const std::vector<uint8_t>& file, unsigned int depth,
+                                       const std::function<void(const std::vector<OfcSVO::MortonVoxel>& voxels, uint64_t endCode)>& batch)
+{
+    struct Entry{
+        uint64_t pointer;
+        unsigned int level;
+        uint64_t mortonCode;
+    };
+    const uint64_t totalNodes = file.size()/8;
+    uint64_t totalVoxels = 0;
+    std::vector<OfcSVO::MortonVoxel> voxels;
+    MemoryTracker::Block voxelMemory(MemoryTracker::VOXELIZER);
+    const auto addVoxel = [&](uint64_t code, RGBA8 color){
+        if (voxels.size() >= BATCH_VOXELS && code/BRICK_VOXELS != voxels.back().mortonCode/BRICK_VOXELS){
+            voxelMemory.resize(MemoryTracker::bytes(voxels));
+            batch(voxels, code/BRICK_VOXELS*BRICK_VOXELS);
+            voxels.clear();
+        }
+        voxels.push_back({color, code});
+        totalVoxels += 1;
+    };
+
+    // the children are pushed backwards, so the voxels come in morton order
+    std::vector<Entry> stack = {{0, 0, 0}};
+    while (!stack.empty()){
+        const Entry entry = stack.back();
+        stack.pop_back();
+        const Node node = NodeRead::decode(NodeRead::fromBytes(&file[8*entry.pointer]));
+        if (node.childBits == 0) continue;
+
+        // a leaf above the last level fills its whole region
+        if (node.childOffset == 0){
+            const uint64_t regionVoxels = 1ull << 3*(depth - entry.level);
+            for (uint64_t code = entry.mortonCode*regionVoxels; code < (entry.mortonCode + 1)*regionVoxels;++code){
+                addVoxel(code, node.RGBA);
+            }
+            continue;
+        }
+
+        uint64_t children = entry.pointer + node.childOffset;
+        if (node.referBit){
+            children += NodeRead::fromBytes(&file[8*children]);
+        }
+        unsigned int child = __builtin_popcount(node.childBits);
+        for (int i = 7; i >= 0;--i){
+            if ((node.childBits >> i) & 1){
+                child -= 1;
+                if (children + child < totalNodes){
+                    stack.push_back({children + child, entry.level + 1, entry.mortonCode*8 + i});
+                }
+            }
+        }
+    }
+    voxelMemory.resize(MemoryTracker::bytes(voxels));
+    batch(voxels, 1ull << (3*depth));
+    return totalVoxels;
+}
+
+FormatBenchmark::Encoding FormatBenchmark::plain(const std::string& name, const char* file, unsigned int pageSize)
+{
+    Encoding encoding;
+    encoding.name = name;
+    encoding.file = readFile(file);
+    encoding.fileSize = encoding.file.size();
+    encoding.totalNodes = encoding.file.size()/8;
+    encoding.totalPages = (encoding.totalNodes + pageSize - 1)/pageSize;
+    const uint8_t* bytes = encoding.file.data();
+    const uint64_t totalNodes = encoding.totalNodes;
+    encoding.decodePage = [bytes, totalNodes, pageSize](uint64_t page, std::vector<uint64_t>& nodes){
+        const uint64_t begin = page*pageSize;
+        const uint64_t end = std::min(begin + pageSize, totalNodes);
+        nodes.resize(end - begin);
+        for (uint64_t i = begin; i < end;++i){
+            nodes[i - begin] = NodeRead::fromBytes(bytes + 8*i);
+        }
+    };
+    return encoding;
+}
+
+FormatBenchmark::Encoding FormatBenchmark::paged(const std::string& name, const char* file, PagedFile::PageDecoder decodePage)
+{
+    Encoding encoding;
+    encoding.name = name;
+    encoding.file = readFile(file);
+    encoding.fileSize = encoding.file.size();
+    const uint8_t* bytes = encoding.file.data();
+    // a file with a bad header has no pages
+    PagedFile::Header header;
+    PagedFile::readHeader(bytes, encoding.fileSize, header);
+    encoding.totalNodes = header.totalNodes;
+    encoding.totalPages = header.totalPages;
+
+    // the page data follows the page offsets
+    const uint8_t* offsets = bytes + PagedFile::HEADER_SIZE;
+    const uint8_t* pages = bytes + PagedFile::pagesBegin(header);
+    encoding.decodePage = [offsets, pages, header, decodePage](uint64_t page, std::vector<uint64_t>& nodes){
+        nodes = decodePage(pages + NodeRead::fromBytes(offsets + 8*page), PagedFile::pageNodes(header, page));
+    };
+    return encoding;
+}
+
+FormatBenchmark::Encoding FormatBenchmark::optimized(const char* file, unsigned int pageSize)
+{
+    Encoding encoding;
+    encoding.name = "opt";
+    encoding.file = readFile(file);
+    encoding.fileSize = encoding.file.size();
+    const uint64_t fileBits = 8*encoding.fileSize;
+    encoding.file.resize(encoding.file.size() + READ_PADDING, 0);
+    const uint8_t* bytes = encoding.file.data();
+
+    // header: child pointer size updates ending with 0, color size, total colors, colors
+    std::vector<unsigned int> updates;
+    uint64_t bytePointer = 0;
+    for (unsigned int update = readUint32(bytes); update != 0; update = readUint32(bytes + bytePointer)){
+        updates.push_back(update);
+        bytePointer += 4;
+    }
+    bytePointer += 4;
+    const unsigned int colorSize = readUint32(bytes + bytePointer);
+    const unsigned int totalColors = readUint32(bytes + bytePointer + 4);
+    bytePointer += 8;
+    std::vector<uint64_t> colors(totalColors);
+    for (unsigned int i = 0; i < totalColors;++i){
+        colors[i] = readUint32(bytes + bytePointer + 4*i);
+    }
+
+    // the child pointers of the nodes in [updates[k - 1], updates[k]) have k + 1 bits
+    std::vector<uint64_t> rangeBegin(updates.size() + 1);
+    std::vector<uint64_t> rangeBit(updates.size() + 1);
+    rangeBegin[0] = 0;
+    rangeBit[0] = 8*(bytePointer + 4*totalColors);
+    for (unsigned int k = 1; k <= updates.size();++k){
+        rangeBegin[k] = updates[k - 1];
+        rangeBit[k] = rangeBit[k - 1] + (rangeBegin[k] - rangeBegin[k - 1])*(8 + k + colorSize);
+    }
+    // the last byte is filled up with less bits than a node
+    encoding.totalNodes = rangeBegin.back() + (fileBits - rangeBit.back())/(8 + updates.size() + 1 + colorSize);
+    encoding.totalPages = (encoding.totalNodes + pageSize - 1)/pageSize;
+    if (updates.size() + 1 > TOTAL_CHILDOFFSET_BITS){
+        std::cout << "opt: child pointers of " << updates.size() + 1 << " bits don't fit in a node, they are cut to " << TOTAL_CHILDOFFSET_BITS << " bits\n";
+    }
+
+    const uint64_t totalNodes = encoding.totalNodes;
+    encoding.decodePage = [bytes, updates, rangeBegin, rangeBit, colors, colorSize, totalNodes, pageSize](uint64_t page, std::vector<uint64_t>& nodes){
+        const uint64_t begin = page*pageSize;
+        const uint64_t end = std::min(begin + pageSize, totalNodes);
+        nodes.resize(end - begin);
+        unsigned int k = std::upper_bound(updates.begin(), updates.end(), begin) - updates.begin();
+        for (uint64_t i = begin; i < end;++i){
+            while (k < updates.size() && i >= updates[k]) k += 1;
+            const unsigned int childPointerBits = k + 1;
+            const uint64_t bitPointer = rangeBit[k] + (i - rangeBegin[k])*(8 + childPointerBits + colorSize);
+            const uint64_t childMask = readBits(bytes, bitPointer, 8);
+            const uint64_t childPointer = readBits(bytes, bitPointer + 8, childPointerBits);
+            const uint64_t color = colorSize > 0? readBits(bytes, bitPointer + 8 + childPointerBits, colorSize) : 0;
+            nodes[i - begin] = (childMask << 56) | ((childPointer & ((1ull << TOTAL_CHILDOFFSET_BITS) - 1)) << 32) | colors[color];
+        }
+    };
+    return encoding;
+}
+
+void FormatBenchmark::run(const char* svoFile, unsigned int depth, unsigned int pageSize, double bandwidthMbit)
+{
+    typedef std::chrono::steady_clock Clock;
+
+    const std::vector<uint8_t> input = readFile(svoFile);
+    if (input.size() < 8){
+        std::cout << "Failed to read " << svoFile << "\n";
+        return;
+    }
+    // every encoding of the exporter, the voxels of the input are streamed to the brick builder
+    std::cout << "Encoding bricks\n";
+    {
+        {
+            std::ofstream out(BACKWARDS_FILE, std::ios::binary | std::ios::out);
+            OfcSVO builder(out, depth, true, false);
+            const uint64_t totalVoxels = decodeVoxels(input, depth, [&builder](const std::vector<OfcSVO::MortonVoxel>& voxels, uint64_t endCode){
+                builder.addVoxels(voxels, endCode);
+            });
+            builder.finish();
+            std::cout << totalVoxels << " voxels\n";
+        }
+        std::ofstream out(BRICKS_FILE, std::ios::binary | std::ios::out);
+        std::ifstream in(BACKWARDS_FILE, std::ios::binary | std::ios::ate | std::ios::in);
+        OfcSVO::reverseNodeFile(out, in);
+    }
+    std::cout << "Encoding color delta\n";
+    ColorDeltaCoder::encode(svoFile, COLOR_DELTA_FILE, pageSize);
+    std::cout << "Encoding compressed pages\n";
+    PageCoder::encode(svoFile, COMPRESSED_FILE, pageSize);
+
+    // the decoders point into the files of the encodings, they must not be copied
+    std::vector<Encoding> encodings;
+    encodings.reserve(5);
+    encodings.push_back(plain("plain", svoFile, pageSize));
+    encodings.push_back(plain("bricks", BRICKS_FILE, pageSize));
+    encodings.push_back(paged("color delta", COLOR_DELTA_FILE, ColorDeltaCoder::decodePage));
+    encodings.push_back(paged("compressed", COMPRESSED_FILE, PageCoder::decodePage));
+    if (depth <= LEGACY_MAX_DEPTH){
+        // the in memory SVO needs all voxels at once
+        std::cout << "Encoding opt\n";
+        std::vector<Voxel> voxels;
+        MemoryTracker::Block voxelMemory(MemoryTracker::VOXELIZER);
+        decodeVoxels(input, depth, [&voxels, &voxelMemory](const std::vector<OfcSVO::MortonVoxel>& batch, uint64_t){
+            for (const OfcSVO::MortonVoxel& mortonVoxel : batch){
+                Voxel voxel;
+                voxel.XYZ[0] = voxel.XYZ[1] = voxel.XYZ[2] = 0;
+                for (unsigned int i = 0; i < 21;++i){
+                    voxel.XYZ[0] |= (unsigned int)((mortonVoxel.mortonCode >> (3*i)) & 1) << i;
+                    voxel.XYZ[1] |= (unsigned int)((mortonVoxel.mortonCode >> (3*i + 1)) & 1) << i;
+                    voxel.XYZ[2] |= (unsigned int)((mortonVoxel.mortonCode >> (3*i + 2)) & 1) << i;
+                }
+                voxel.RGBA = mortonVoxel.voxel;
+                voxels.push_back(voxel);
+            }
+            voxelMemory.resize(MemoryTracker::bytes(voxels));
+        });
+        const SVO svo(voxels, depth);
+        SVOSaver::saveOpt(OPT_FILE, svo);
+        std::cout << "\n";
+        encodings.push_back(optimized(OPT_FILE, pageSize));
+    } else{
+        std::cout << "opt: skipped above depth " << LEGACY_MAX_DEPTH << "\n";
+    }
+
+    struct Row{
+        double latency;         // microseconds per random page
+        double bulkSeconds;
+        double totalSeconds;    // transfer and bulk decode
+    };
+    std::vector<Row> rows(encodings.size());
+    std::mt19937_64 random(1);
+    std::vector<uint64_t> nodes;
+    volatile uint64_t sink = 0;
+    unsigned int best = 0;
+    for (unsigned int e = 0; e < encodings.size();++e){
+        const Encoding& encoding = encodings[e];
+        if (encoding.totalPages == 0) continue;
+
+        std::uniform_int_distribution<uint64_t> randomPage(0, encoding.totalPages - 1);
+        Clock::time_point begin = Clock::now();
+        for (unsigned int i = 0; i < RANDOM_PAGES;++i){
+            encoding.decodePage(randomPage(random), nodes);
+            sink = sink + nodes[0];
+        }
+        rows[e].latency = std::chrono::duration<double, std::micro>(Clock::now() - begin).count()/RANDOM_PAGES;
+
+        begin = Clock::now();
+        for (uint64_t page = 0; page < encoding.totalPages;++page){
+            encoding.decodePage(page, nodes);
+            sink = sink + nodes[0];
+        }
+        rows[e].bulkSeconds = std::chrono::duration<double>(Clock::now() - begin).count();
+        rows[e].totalSeconds = encoding.fileSize*8/(bandwidthMbit*1e6) + rows[e].bulkSeconds;
+        if (rows[e].totalSeconds < rows[best].totalSeconds) best = e;
+    }
+
+    std::cout << "\n" << svoFile << ", depth " << depth << ", pages of " << pageSize << " nodes, " << bandwidthMbit << " Mbit/s\n";
+    std::cout << std::left << std::setw(13) << "format" << std::right << std::setw(12) << "bytes" << std::setw(11) << "nodes" <<
+                 std::setw(12) << "bytes/node" << std::setw(10) << "pages" << std::setw(14) << "page (us)" <<
+                 std::setw(14) << "M nodes/s" << std::setw(10) << "MB/s" << std::setw(18) << "transfer+decode" << "\n";
+    std::cout << std::fixed << std::setprecision(3);
+    for (unsigned int e = 0; e < encodings.size();++e){
+        const Encoding& encoding = encodings[e];
+        const double bulkSeconds = rows[e].bulkSeconds > 0? rows[e].bulkSeconds : 1e-9;
+        std::cout << std::left << std::setw(13) << encoding.name << std::right << std::setw(12) << encoding.fileSize <<
+                     std::setw(11) << encoding.totalNodes << std::setw(12) << (double)encoding.fileSize/std::max(encoding.totalNodes, (uint64_t)1) <<
+                     std::setw(10) << encoding.totalPages << std::setw(14) << rows[e].latency <<
+                     std::setw(14) << encoding.totalNodes/bulkSeconds/1e6 << std::setw(10) << encoding.fileSize/bulkSeconds/(1024*1024) <<
+                     std::setw(16) << rows[e].totalSeconds << " s" << (e == best? " *" : "") << "\n";
+    }
+    std::cout << std::defaultfloat << "* least transfer and decode time\n";
+
+    std::remove(BACKWARDS_FILE);
+    std::remove(BRICKS_FILE);
+    std::remove(COLOR_DELTA_FILE);
+    std::remove(COMPRESSED_FILE);
+    std::remove(OPT_FILE);
+}
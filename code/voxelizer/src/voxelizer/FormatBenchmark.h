@@ -0,0 +1,50 @@
+#ifndef FORMATBENCHMARK_H
+#define FORMATBENCHMARK_H
+
+#include <string>
+#include <vector>
+#include <cstdint>
+#include <functional>
+#include "structs.h"
+#include "ofcSVO.h"
+#include "PagedFile.h"
+
+// Compares the SVO encodings of the exporter on one SVO: the plain 64 bit nodes, the plain nodes
+// with bricks, the color delta coded pages (ColorDeltaCoder), the compressed pages (PageCoder)
+// and the bit packed format of SVOSaver::saveOpt. The bricks are built from the voxels of the input
+// SVO, streamed in morton order in batches, the opt file from an in memory SVO up to depth 10.
+// Every encoding is loaded in memory like the back-end does and decoded page by page to 64 bit
+// nodes. The opt nodes get the 23 bit child pointer of a node, wider opt pointers don't fit and
+// those nodes are only timed. The table has the file size, bytes per node, pages, the latency of
+// decoding one random page, the throughput of decoding all pages and the time to transfer and
+// decode the whole model at a bandwidth.
+class FormatBenchmark
+{
+public:
+    // svoFile is a plain SVO without bricks of the depth
+    static void run(const char* svoFile, unsigned int depth, unsigned int pageSize, double bandwidthMbit);
+
+private:
+    struct Encoding{
+        std::string name;
+        std::vector<uint8_t> file;
+        uint64_t fileSize;
+        uint64_t totalNodes;
+        uint64_t totalPages;
+        std::function<void(uint64_t page, std::vector<uint64_t>& nodes)> decodePage;
+    };
+
+    static std::vector<uint8_t> readFile(const char* file);
+    // walks the voxels of a plain SVO without bricks in morton order, a solid node is expanded to
+    // all voxels of its region. The voxels are passed on in batches with the morton code they end
+    // at, a batch ends at the start of a brick.
+    static uint64_t decodeVoxels(const std::vector<uint8_t>& file, unsigned int depth,
+                                 const std::function<void(const std::vector<OfcSVO::MortonVoxel>& voxels, uint64_t endCode)>& batch);
+
+    static Encoding plain(const std::string& name, const char* file, unsigned int pageSize);
+    // a PagedFile of ColorDeltaCoder or PageCoder
+    static Encoding paged(const std::string& name, const char* file, PagedFile::PageDecoder decodePage);
+    static Encoding optimized(const char* file, unsigned int pageSize);
+};
+
+#endif
@@ -0,0 +1,223 @@
+#include "LevelOrder.h"
+#include "MappedFile.h"
+#include "NodeTree.h"
+#include "Profiler.h"
+#include "MemoryTracker.h"
+#include "ofcSVO.h"
+
+#include <iostream>
+#include <iomanip>
+#include <fstream>
+#include <string>
+
+#define WRITE_BLOCK_WORDS (1 << 16)
+
+bool LevelOrder::write(const char* svoFile, const char* outputFile, const char* tableFile, unsigned int bricksDepth)
+{
+    MappedFile file(svoFile);
+    if (!file.isOpen() || file.size() < 8){
+        std::cout << "Failed to open " << svoFile << "\n";
+        return false;
+    }
+    std::cout << "Writing " << svoFile << " level by level...\n";
+    Profiler::Scope scope("level order");
+
+    const uint64_t totalWords = file.size()/8;
+    const NodeTree tree(file.data(), totalWords, {}, bricksDepth);
+    const unsigned int brickLevel = tree.brickLevel();
+
+    // breadth first walk, the children of every node are added to the next level together
+    std::vector<Level> levels(1);
+    levels[0].nodes.push_back(0);
+    levels[0].groupStart.push_back(true);
+    std::vector<uint64_t> bricks;
+    std::vector<uint64_t> brickSizes;
+    std::vector<uint64_t> brickPositions;
+    // the whole tree is in memory, ~24 bytes per node and brick
+    MemoryTracker::Block memory(MemoryTracker::SAVER);
+    const auto trackMemory = [&](){
+        uint64_t bytes = MemoryTracker::bytes(levels) + MemoryTracker::bytes(bricks) + MemoryTracker::bytes(brickSizes)
+                         + MemoryTracker::bytes(brickPositions);
+        for (const Level& level : levels){
+            bytes += MemoryTracker::bytes(level.nodes) + MemoryTracker::bytes(level.firstChild) + MemoryTracker::bytes(level.position)
+                     + (level.groupStart.capacity() + level.refer.capacity())/8;
+        }
+        memory.resize(bytes);
+        return !MemoryTracker::exceeded();
+    };
+    const auto stop = [outputFile](){
+        std::cout << "The level order of " << outputFile << " is over the memory budget, it is not written\n";
+        return false;
+    };
+
+    uint64_t inputRefers = 0;
+    for (unsigned int d = 0; d < levels.size();++d){
+        Level next;
+        Level& level = levels[d];
+        level.firstChild.assign(level.nodes.size(), -1);
+        level.refer.assign(level.nodes.size(), false);
+        for (uint64_t i = 0; i < level.nodes.size();++i){
+            const Node node = tree.node(level.nodes[i]);
+            if (node.childBits == 0 || node.childOffset == 0) continue;
+            uint64_t referWord;
+            const uint64_t children = tree.children(level.nodes[i], node, &referWord);
+            if (referWord != NodeTree::NO_POINTER) inputRefers += 1;
+            if (children >= totalWords) continue;
+
+            if (d == brickLevel){
+                level.firstChild[i] = bricks.size();
+                bricks.push_back(children);
+                brickSizes.push_back(tree.brickWords(children));
+                continue;
+            }
+            level.firstChild[i] = next.nodes.size();
+            const unsigned int totalChildren = __builtin_popcount(node.childBits);
+            for (unsigned int c = 0; c < totalChildren && children + c < totalWords;++c){
+                next.nodes.push_back(children + c);
+                next.groupStart.push_back(c == 0);
+            }
+        }
+        if (!next.nodes.empty()) levels.push_back(std::move(next));
+        if (!trackMemory()) return stop();
+    }
+
+    // add refer words until every child offset fits, a refer word only moves nodes further away.
+    // Every pass lays out the whole tree again and adds all refer words that are missing, which
+    // takes few passes.
+    const auto childrenPosition = [&levels, &brickPositions, brickLevel](unsigned int d, uint64_t i){
+        const int64_t first = levels[d].firstChild[i];
+        return d == brickLevel? brickPositions[first] : levels[d + 1].position[first];
+    };
+    std::vector<uint64_t> offsets;
+    bool changed = true;
+    while (changed){
+        offsets = layout(levels, brickSizes, brickPositions);
+        if (!trackMemory()) return stop();
+        changed = false;
+        for (unsigned int d = 0; d < levels.size();++d){
+            Level& level = levels[d];
+            for (uint64_t i = 0; i < level.nodes.size();++i){
+                if (level.firstChild[i] < 0 || level.refer[i]) continue;
+                if (childrenPosition(d, i) - level.position[i] >= (1 << TOTAL_CHILDOFFSET_BITS)){
+                    level.refer[i] = true;
+                    changed = true;
+                }
+            }
+        }
+    }
+
+    std::ofstream out(outputFile, std::ios::binary | std::ios::out);
+    if (!out.is_open()){
+        std::cout << "Failed to open " << outputFile << "\n";
+        return false;
+    }
+    std::vector<uint8_t> block;
+    block.reserve(8*WRITE_BLOCK_WORDS);
+    uint64_t written = 0;
+    const auto writeWord = [&out, &block, &written](uint64_t word){
+        uint8_t bytes[8];
+        NodeRead::toBytes(word, bytes);
+        block.insert(block.end(), bytes, bytes + 8);
+        written += 1;
+        if (block.size() >= 8*WRITE_BLOCK_WORDS){
+            out.write((const char*)block.data(), block.size());
+            block.clear();
+        }
+    };
+
+    uint64_t outputRefers = 0;
+    for (unsigned int d = 0; d < levels.size();++d){
+        const Level& level = levels[d];
+        // the refer words of a group are written right after it
+        std::vector<uint64_t> referWords;
+        for (uint64_t i = 0; i < level.nodes.size();++i){
+            if (level.groupStart[i]){
+                for (uint64_t word : referWords) writeWord(word);
+                referWords.clear();
+            }
+
+            uint64_t word = tree.word(level.nodes[i]);
+            if (level.firstChild[i] >= 0){
+                Node node = NodeRead::decode(word);
+                const uint64_t children = childrenPosition(d, i);
+                if (level.refer[i]){
+                    uint64_t groupEnd = i + 1;
+                    while (groupEnd < level.nodes.size() && !level.groupStart[groupEnd]) groupEnd += 1;
+                    const uint64_t referPointer = level.position[groupEnd - 1] + 1 + referWords.size();
+                    node.referBit = true;
+                    node.childOffset = referPointer - level.position[i];
+                    referWords.push_back(children - referPointer);
+                    outputRefers += 1;
+                } else{
+                    node.referBit = false;
+                    node.childOffset = children - level.position[i];
+                }
+                word = NodeRead::encode(node);
+            }
+            writeWord(word);
+        }
+        for (uint64_t word : referWords) writeWord(word);
+    }
+    for (uint64_t b = 0; b < bricks.size();++b){
+        for (uint64_t w = 0; w < brickSizes[b];++w){
+            writeWord(tree.word(bricks[b] + w));
+        }
+    }
+    out.write((const char*)block.data(), block.size());
+    if (written != offsets.back()){
+        std::cout << "Error writing " << outputFile << ", " << written << " words written instead of " << offsets.back() << "\n";
+        return false;
+    }
+
+    std::ofstream tableOut(tableFile, std::ios::binary | std::ios::out);
+    if (!tableOut.is_open()){
+        std::cout << "Failed to open " << tableFile << "\n";
+        return false;
+    }
+    const unsigned int totalLevels = _byteswap_ulong(offsets.size() - 1);
+    tableOut.write((const char*)&totalLevels, 4);
+    uint8_t bytes[8];
+    for (uint64_t i = 0; i < offsets.size();++i){
+        NodeRead::toBytes(offsets[i], bytes);
+        tableOut.write((const char*)bytes, 8);
+    }
+
+    Profiler::add(Profiler::ALL_BYTES_WRITTEN, 8*written + 4 + 8*offsets.size());
+    std::cout << " Words: " << totalWords << " -> " << written << ", refer words: " << inputRefers << " -> " << outputRefers << "\n";
+    std::cout << std::setw(6) << "level" << std::setw(12) << "nodes" << std::setw(14) << "offset" << std::setw(16) << "bytes up to" << "\n";
+    for (unsigned int l = 0; l + 1 < offsets.size();++l){
+        const uint64_t words = offsets[l + 1] - offsets[l];
+        std::cout << std::setw(6) << (l < levels.size()? std::to_string(l) : "bricks") << std::setw(12) << words << std::setw(14) << offsets[l]
+                  << std::setw(16) << 8*offsets[l + 1] << "\n";
+    }
+    return true;
+}
+
+std::vector<uint64_t> LevelOrder::layout(std::vector<Level>& levels, const std::vector<uint64_t>& brickSizes, std::vector<uint64_t>& brickPositions)
+{
+    std::vector<uint64_t> offsets;
+    uint64_t pointer = 0;
+    for (Level& level : levels){
+        offsets.push_back(pointer);
+        level.position.resize(level.nodes.size());
+        uint64_t referWords = 0;
+        for (uint64_t i = 0; i < level.nodes.size();++i){
+            if (level.groupStart[i]){
+                pointer += referWords;
+                referWords = 0;
+            }
+            level.position[i] = pointer++;
+            if (level.refer[i]) referWords += 1;
+        }
+        pointer += referWords;
+    }
+
+    if (!brickSizes.empty()) offsets.push_back(pointer);
+    brickPositions.resize(brickSizes.size());
+    for (uint64_t b = 0; b < brickSizes.size();++b){
+        brickPositions[b] = pointer;
+        pointer += brickSizes[b];
+    }
+    offsets.push_back(pointer);
+    return offsets;
+}
@@ -0,0 +1,35 @@
+#ifndef LEVELORDER_H
+#define LEVELORDER_H
+
+#include <vector>
+#include <cstdint>
+
+// Level ordered layout of an SVO file in the 64 bit node format: the nodes are written level by
+// level from the root down, so the top levels of the tree are one range at the start of the file.
+// The children of a node stay next to each other, a child offset that doesn't fit in 23 bits
+// points to a refer word right after the children of its parent. With bricks the bricks follow
+// the last level. The file is a plain SVO for every reader, the start of every level is in a
+// depth table next to it. The whole tree is walked in memory, ~24 bytes per node and brick,
+// counted as saver memory: over the memory budget the file is not written.
+//
+// Depth table file: <levels:32><levelOffset:64 in words for every level + end offset>
+class LevelOrder
+{
+public:
+    // with bricks the depth tells the level of the brick pointers, 0 is a file without bricks
+    static bool write(const char* svoFile, const char* outputFile, const char* tableFile, unsigned int bricksDepth = 0);
+
+private:
+    struct Level{
+        std::vector<uint64_t> nodes;        // pointers in the input file
+        std::vector<int64_t> firstChild;    // index in the next level or brick, -1 without children
+        std::vector<bool> groupStart;       // first node of the children of a node
+        std::vector<bool> refer;            // the child offset needs a refer word
+        std::vector<uint64_t> position;     // pointers in the output file
+    };
+
+    // the positions of all nodes and bricks for the current refer words, returns the level offsets
+    static std::vector<uint64_t> layout(std::vector<Level>& levels, const std::vector<uint64_t>& brickSizes, std::vector<uint64_t>& brickPositions);
+};
+
+#endif
@@ -0,0 +1,29 @@
+#ifndef MAPPEDFILE_H
+#define MAPPEDFILE_H
+
+#include <cstdint>
+
+// Read-only memory mapping of a whole file, the pages are loaded by the OS when they are read.
+// Empty or missing files are not open.
+class MappedFile
+{
+public:
+    MappedFile(const char* file);
+    ~MappedFile();
+    MappedFile(const MappedFile&) = delete;
+    MappedFile& operator=(const MappedFile&) = delete;
+
+    bool isOpen() const { return _data != nullptr; }
+    const uint8_t* data() const { return _data; }
+    uint64_t size() const { return _size; }
+
+private:
+    const uint8_t* _data = nullptr;
+    uint64_t _size = 0;
+#ifdef _WIN32
+    void* _file = nullptr;
+    void* _mapping = nullptr;
+#endif
+};
+
+#endif
@@ -0,0 +1,148 @@
+#include "MemoryTracker.h"
+
+#include <iostream>
+#include <atomic>
+
+#define MB (1024.0*1024.0)
+
+static const char* SUBSYSTEM_NAMES[MemoryTracker::TOTAL_SUBSYSTEMS] = {"voxelizer", "sort", "builder", "saver"};
+
+static std::atomic<uint64_t> budgetBytes{0};
+static std::atomic<bool> budgetExceeded{false};
+static std::atomic<uint64_t> currentBytes[MemoryTracker::TOTAL_SUBSYSTEMS];
+static std::atomic<uint64_t> highWaterBytes[MemoryTracker::TOTAL_SUBSYSTEMS];
+static std::atomic<uint64_t> totalBytes{0};
+static std::atomic<uint64_t> totalHighWaterBytes{0};
+
+static void raiseHighWater(std::atomic<uint64_t>& highWater, uint64_t bytes)
+{
+    uint64_t old = highWater.load(std::memory_order_relaxed);
+    while (bytes > old && !highWater.compare_exchange_weak(old, bytes, std::memory_order_relaxed));
+}
+
+MemoryTracker::Block::Block(Subsystem subsystem, uint64_t bytes)
+    : _subsystem{subsystem}
+{
+    resize(bytes);
+}
+
+MemoryTracker::Block::Block(const Block& other)
+    : _subsystem{other._subsystem}
+{
+    resize(other._bytes);
+}
+
+MemoryTracker::Block::Block(Block&& other)
+    : _subsystem{other._subsystem}, _bytes{other._bytes}
+{
+    other._bytes = 0;
+}
+
+MemoryTracker::Block& MemoryTracker::Block::operator=(const Block& other)
+{
+    if (this == &other) return *this;
+    resize(0);
+    _subsystem = other._subsystem;
+    resize(other._bytes);
+    return *this;
+}
+
+MemoryTracker::Block& MemoryTracker::Block::operator=(Block&& other)
+{
+    if (this == &other) return *this;
+    resize(0);
+    _subsystem = other._subsystem;
+    _bytes = other._bytes;
+    other._bytes = 0;
+    return *this;
+}
+
+MemoryTracker::Block::~Block()
+{
+    resize(0);
+}
+
+void MemoryTracker::Block::resize(uint64_t bytes)
+{
+    if (bytes > _bytes){
+        allocate(_subsystem, bytes - _bytes);
+    } else if (bytes < _bytes){
+        release(_subsystem, _bytes - bytes);
+    }
+    _bytes = bytes;
+}
+
+void MemoryTracker::setBudget(uint64_t bytes)
+{
+    budgetBytes = bytes;
+}
+
+uint64_t MemoryTracker::budget()
+{
+    return budgetBytes;
+}
+
+bool MemoryTracker::exceeded()
+{
+    return budgetExceeded;
+}
+
+void MemoryTracker::allocate(Subsystem subsystem, uint64_t bytes)
+{
+    raiseHighWater(highWaterBytes[subsystem], currentBytes[subsystem].fetch_add(bytes, std::memory_order_relaxed) + bytes);
+    const uint64_t total = totalBytes.fetch_add(bytes, std::memory_order_relaxed) + bytes;
+    raiseHighWater(totalHighWaterBytes, total);
+
+    const uint64_t budget = budgetBytes.load(std::memory_order_relaxed);
+    // any thread can cross the budget, the build is stopped by the thread that runs it
+    if (budget > 0 && total > budget && !budgetExceeded.exchange(true)){
+        std::cerr << "Memory budget of " << budget/MB << " MB exceeded: the " << SUBSYSTEM_NAMES[subsystem] << " needs "
+                  << bytes/MB << " MB more, " << total/MB << " MB in total, the build stops\n";
+        report();
+    }
+}
+
+void MemoryTracker::release(Subsystem subsystem, uint64_t bytes)
+{
+    currentBytes[subsystem].fetch_sub(bytes, std::memory_order_relaxed);
+    totalBytes.fetch_sub(bytes, std::memory_order_relaxed);
+}
+
+uint64_t MemoryTracker::current(Subsystem subsystem)
+{
+    return currentBytes[subsystem];
+}
+
+uint64_t MemoryTracker::highWater(Subsystem subsystem)
+{
+    return highWaterBytes[subsystem];
+}
+
+uint64_t MemoryTracker::totalHighWater()
+{
+    return totalHighWaterBytes;
+}
+
+void MemoryTracker::resetHighWater()
+{
+    for (unsigned int i = 0; i < TOTAL_SUBSYSTEMS;++i){
+        highWaterBytes[i] = currentBytes[i].load();
+    }
+    totalHighWaterBytes = totalBytes.load();
+}
+
+const char* MemoryTracker::name(Subsystem subsystem)
+{
+    return SUBSYSTEM_NAMES[subsystem];
+}
+
+void MemoryTracker::report()
+{
+    std::cout << "Memory (current / high water):\n";
+    for (unsigned int i = 0; i < TOTAL_SUBSYSTEMS;++i){
+        std::cout << " " << SUBSYSTEM_NAMES[i] << ": " << currentBytes[i]/MB << " / " << highWaterBytes[i]/MB << " MB\n";
+    }
+    std::cout << " total: " << totalBytes/MB << " / " << totalHighWaterBytes/MB << " MB";
+    if (budgetBytes > 0) std::cout << ", budget " << budgetBytes/MB << " MB";
+    std::cout << "\n";
+}
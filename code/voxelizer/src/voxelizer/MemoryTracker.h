@@ -0,0 +1,65 @@
+#ifndef MEMORYTRACKER_H
+#define MEMORYTRACKER_H
+
+#include <cstdint>
+#include <vector>
+
+// Counts the bytes of the large buffers of every subsystem of a build, with the current and the
+// high-water bytes of every subsystem and of all of them together. A buffer is counted by a Block
+// that is resized with the buffer. With a budget, a block that grows past the budget reports all
+// subsystems and marks the budget as exceeded, the build checks it between its steps and stops
+// with its files closed, before the system runs out of memory.
+class MemoryTracker
+{
+public:
+    enum Subsystem{
+        VOXELIZER,          // voxel images, voxelized bricks and voxel lists
+        SORT,               // morton ordered voxels, sort runs and their read buffers
+        BUILDER,            // in memory SVO trees and subtrees
+        SAVER,              // node arrays of the SVO savers
+        TOTAL_SUBSYSTEMS
+    };
+
+    // bytes of a buffer, they are released when the block is destroyed. A copy of a block counts
+    // the bytes again, like the copy of its buffer.
+    class Block
+    {
+    public:
+        Block(Subsystem subsystem = VOXELIZER, uint64_t bytes = 0);
+        Block(const Block& other);
+        Block(Block&& other);
+        Block& operator=(const Block& other);
+        Block& operator=(Block&& other);
+        ~Block();
+
+        void resize(uint64_t bytes);
+        uint64_t bytes() const { return _bytes; }
+    private:
+        Subsystem _subsystem;
+        uint64_t _bytes = 0;
+    };
+
+    // a budget of 0 bytes is no budget
+    static void setBudget(uint64_t bytes);
+    static uint64_t budget();
+    // true once the total grew past the budget
+    static bool exceeded();
+
+    static void allocate(Subsystem subsystem, uint64_t bytes);
+    static void release(Subsystem subsystem, uint64_t bytes);
+
+    static uint64_t current(Subsystem subsystem);
+    static uint64_t highWater(Subsystem subsystem);
+    static uint64_t totalHighWater();
+    // lowers the high-water bytes to the current bytes, to measure the next step on its own
+    static void resetHighWater();
+    static const char* name(Subsystem subsystem);
+
+    // writes the current and high-water bytes of every subsystem to the console
+    static void report();
+
+    template <class T>
+    static uint64_t bytes(const std::vector<T>& v){ return v.capacity()*sizeof(T); }
+};
+
+#endif
@@ -0,0 +1,53 @@
+#include "NodeRead.h"
+
+Node NodeRead::decode(uint64_t word)
+{
+    Node node;
+    node.childBits = (word >> 56) & 0xFF;
+    node.referBit = (word >> 55) & 1;
+    node.childOffset = (word >> 32) & 0x7FFFFF;
+    node.childPointer = 0;
+    node.RGBA.R = (word >> 24) & 0xFF;
+    node.RGBA.G = (word >> 16) & 0xFF;
+    node.RGBA.B = (word >> 8) & 0xFF;
+    node.RGBA.A = word & 0xFF;
+    return node;
+}
+
+uint64_t NodeRead::encode(Node node)
+{
+    uint64_t word = node.childBits;
+    word = (word << 1) | (node.referBit? 1 : 0);
+    word = (word << 23) | (node.childOffset & 0x7FFFFF);
+    word = (word << 8) | node.RGBA.R;
+    word = (word << 8) | node.RGBA.G;
+    word = (word << 8) | node.RGBA.B;
+    word = (word << 8) | node.RGBA.A;
+    return word;
+}
+
+uint64_t NodeRead::readWord(std::istream &in, uint64_t nodePointer)
+{
+    uint8_t bytes[8];
+    in.seekg(nodePointer*8, std::ios::beg);
+    in.read((char*)bytes, 8);
+    return fromBytes(bytes);
+}
+
+uint64_t NodeRead::fromBytes(const uint8_t* bytes)
+{
+    // nodes are stored with the most significant byte first
+    uint64_t word = 0;
+    for (unsigned int i = 0; i < 8;++i){
+        word = (word << 8) | bytes[i];
+    }
+    return word;
+}
+
+void NodeRead::toBytes(uint64_t word, uint8_t* bytes)
+{
+    for (int i = 7; i >= 0;--i){
+        bytes[i] = word & 0xFF;
+        word >>= 8;
+    }
+}
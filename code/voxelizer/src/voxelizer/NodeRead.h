@@ -0,0 +1,18 @@
+#ifndef NODEREAD_H
+#define NODEREAD_H
+
+#include "structs.h"
+#include <fstream>
+
+class NodeRead
+{
+public:
+    static Node decode(uint64_t word);
+    static uint64_t encode(Node node);
+
+    static uint64_t readWord(std::istream &in, uint64_t nodePointer);
+    static uint64_t fromBytes(const uint8_t* bytes);
+    static void toBytes(uint64_t word, uint8_t* bytes);
+};
+
+#endif
@@ -0,0 +1,35 @@
+#include "NodeTree.h"
+#include "ofcSVO.h"
+
+#include <algorithm>
+
+NodeTree::NodeTree(const uint8_t* data, uint64_t totalWords, std::vector<uint64_t> farTable, unsigned int bricksDepth)
+    : _data{data}, _totalWords{totalWords}, _farTable{std::move(farTable)}, _brickLevel{brickLevel(bricksDepth)}
+{
+}
+
+unsigned int NodeTree::brickLevel(unsigned int bricksDepth)
+{
+    return bricksDepth > BRICK_LEVELS? bricksDepth - BRICK_LEVELS : ~0u;
+}
+
+uint64_t NodeTree::children(uint64_t pointer, const Node& node, uint64_t* referWord) const
+{
+    if (referWord) *referWord = NO_POINTER;
+    if (node.referBit && !_farTable.empty()){
+        if (node.childOffset >= _farTable.size()) return _totalWords;
+        return std::min(pointer + _farTable[node.childOffset], _totalWords);
+    }
+
+    const uint64_t children = pointer + node.childOffset;
+    if (children >= _totalWords) return _totalWords;
+    if (!node.referBit) return children;
+    // the refer word holds the offset of the children
+    if (referWord) *referWord = children;
+    return std::min(children + word(children), _totalWords);
+}
+
+uint64_t NodeTree::brickWords(uint64_t brick) const
+{
+    return std::min((uint64_t)(1 + (brickVoxels(brick) + 1)/2), _totalWords - brick);
+}
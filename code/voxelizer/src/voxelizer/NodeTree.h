@@ -0,0 +1,103 @@
+#ifndef NODETREE_H
+#define NODETREE_H
+
+#include "NodeRead.h"
+#include <vector>
+#include <cstdint>
+
+#define MAX_FAN_OUT 8           // pages with a larger fan-out are counted together
+
+// The tree of an SVO file in the 64 bit node format in memory, e.g. a mapped file: the children
+// of a node through its refer word or a far pointer table, the bricks and a depth first walk that
+// only keeps the open nodes. With a far pointer table the refer bit is an index in the table.
+class NodeTree
+{
+public:
+    static const uint64_t NO_POINTER = ~(uint64_t)0;
+
+    // with bricks the depth tells the level of the brick pointers, 0 is a tree without bricks
+    NodeTree(const uint8_t* data, uint64_t totalWords, std::vector<uint64_t> farTable = {}, unsigned int bricksDepth = 0);
+
+    uint64_t totalWords() const { return _totalWords; }
+    const std::vector<uint64_t>& farTable() const { return _farTable; }
+    unsigned int brickLevel() const { return _brickLevel; }
+    // the level of the nodes that point to bricks, ~0u without bricks
+    static unsigned int brickLevel(unsigned int bricksDepth);
+
+    uint64_t word(uint64_t pointer) const { return NodeRead::fromBytes(_data + 8*pointer); }
+    Node node(uint64_t pointer) const { return NodeRead::decode(word(pointer)); }
+
+    // the first child of a node with a child offset, totalWords if it is behind the end of the file,
+    // referWord is the refer word of the node or NO_POINTER
+    uint64_t children(uint64_t pointer, const Node& node, uint64_t* referWord = nullptr) const;
+
+    // brick: a mask and 2 colors per word, the words are cut at the end of the file
+    unsigned int brickVoxels(uint64_t brick) const { return __builtin_popcountll(word(brick)); }
+    uint64_t brickWords(uint64_t brick) const;
+
+    // an open node of a walk, value adds up its walked children
+    template <class Value>
+    struct Frame{
+        uint64_t pointer;
+        uint64_t children;
+        unsigned int level;
+        uint8_t childBits;
+        uint8_t nextBit;
+        uint8_t child;
+        Value value;
+    };
+
+    // Walks the tree depth first from the root. visit(pointer, level, value) is called for every
+    // child pointer, also behind the end of the file: it returns the first child of a node whose
+    // children are walked, with value as the start value of the node, or NO_POINTER with the
+    // value of the node. add(parent, child, value) adds a walked child to its open parent and
+    // close(frame) is called when all children of a node are walked. Returns the value of the root.
+    template <class Value, class Visit, class Add, class Close>
+    Value walk(Visit visit, Add add, Close close) const;
+
+private:
+    const uint8_t* _data;
+    uint64_t _totalWords;
+    std::vector<uint64_t> _farTable;
+    unsigned int _brickLevel;
+};
+
+template <class Value, class Visit, class Add, class Close>
+Value NodeTree::walk(Visit visit, Add add, Close close) const
+{
+    std::vector<Frame<Value>> stack;
+    // visits a node, a node with children to walk is pushed on the stack
+    const auto enter = [this, &visit, &stack](uint64_t pointer, unsigned int level, Value& value){
+        const uint64_t children = visit(pointer, level, value);
+        if (children == NO_POINTER) return false;
+        stack.push_back({pointer, children, level, node(pointer).childBits, 0, 0, value});
+        return true;
+    };
+
+    Value value{};
+    if (!enter(0, 0, value)) return value;
+    while (true){
+        Frame<Value>& frame = stack.back();
+        while (frame.nextBit < 8 && !((frame.childBits >> frame.nextBit) & 1)) frame.nextBit += 1;
+
+        if (frame.nextBit == 8){
+            // the subtree is done
+            const Frame<Value> done = frame;
+            stack.pop_back();
+            close(done);
+            if (stack.empty()) return done.value;
+            add(stack.back(), done.pointer, done.value);
+            continue;
+        }
+
+        const uint64_t child = frame.children + frame.child;
+        const unsigned int level = frame.level + 1;
+        frame.nextBit += 1;
+        frame.child += 1;
+        // a pushed child is added to its parent when it's done, the push can move the parent
+        Value childValue{};
+        if (!enter(child, level, childValue)) add(stack.back(), child, childValue);
+    }
+}
+
+#endif
@@ -1,68 +1,56 @@
 #include "NodeWrite.h"
 #include <iostream>
 
-uint8_t NodeWrite::writeBuffer{0};
-uint8_t NodeWrite::writeBufferIndex{0}; 
-
-void NodeWrite::writeNode(std::ofstream &SVOout, Node node)
+void NodeWrite::writeNode(std::ostream &SVOout, Node node)
 {
-
-    // write childbits
-    for (int i = 7; i >= 0;--i){
-        writeBit(SVOout, node.childBits & (1 << i));
-    }
-
-    // write refer bit
-    writeBit(SVOout, node.referBit);
-
-    // write childoffset
-    for (int i = 22; i >= 0;--i){
-        writeBit(SVOout, node.childOffset & (1 << (i )));
-    }
-
-    // write RGBA
-    for (int i = 7; i >= 0;--i){
-        writeBit(SVOout, node.RGBA.R & (1 << i));
-    }
-    for (int i = 7; i >= 0;--i){
-        writeBit(SVOout, node.RGBA.G & (1 << i));
-    }
-    for (int i = 7; i >= 0;--i){
-        writeBit(SVOout, node.RGBA.B & (1 << i));
-    }
-    for (int i = 7; i >= 0;--i){
-        writeBit(SVOout, node.RGBA.A & (1 << i));
-    }
+    // <childBits:8><referBit:1><childOffset:23><RGBA:32>
+    uint64_t word = (uint64_t)node.childBits << 56;
+    word |= (uint64_t)node.referBit << 55;
+    word |= (uint64_t)(node.childOffset & 0x7FFFFF) << 32;
+    word |= ((uint64_t)node.RGBA.R << 24) | ((uint64_t)node.RGBA.G << 16) | ((uint64_t)node.RGBA.B << 8) | (uint64_t)node.RGBA.A;
+    writeWord(SVOout, word);
 }
 
-void NodeWrite::writeRefer(std::ofstream &SVOout,uint64_t offset)
+void NodeWrite::writeRefer(std::ostream &SVOout,uint64_t offset)
 {
     // write offset
-    for (int i = 63; i >= 0;--i){
-        writeBit(SVOout, offset & ((uint64_t)1 << (i )));
-    }
+    writeWord(SVOout, offset);
 }
 
-void NodeWrite::writeBit(std::ofstream &out, bool bit)
+uint64_t NodeWrite::writeBrick(std::ostream &SVOout, uint64_t mask, const std::vector<RGBA8>& colors)
 {
-    // add bit to writebuffer
-    writeBuffer |= (bit << (7-writeBufferIndex));
-
-    // prepare for next bit
-    writeBufferIndex += 1;
+    // the file is reversed after writing, so the brick is written back to front:
+    // color words from last to first, the occupancy mask last
+    const uint64_t colorWords = (colors.size() + 1)/2;
+    for (uint64_t w = colorWords; w-- > 0;){
+        uint64_t word = 0;
+        for (uint64_t c = 0; c < 2;++c){
+            word <<= 32;
+            if (2*w + c < colors.size()){
+                const RGBA8 rgba = colors[2*w + c];
+                word |= ((uint64_t)rgba.R << 24) | ((uint64_t)rgba.G << 16) | ((uint64_t)rgba.B << 8) | (uint64_t)rgba.A;
+            }
+        }
+        writeWord(SVOout, word);
+    }
+
+    // write occupancy mask
+    writeWord(SVOout, mask);
+
+    return colorWords + 1;
+}
 
-    // if writebuffer full, write the buffer
-    if (writeBufferIndex >= 8){
-        out.write((const char*)&writeBuffer, 1);
-        writeBufferIndex = 0;
-        writeBuffer = 0;
+void NodeWrite::writeWord(std::ostream &out, uint64_t word)
+{
+    // words are written big endian
+    char bytes[8];
+    for (int i = 0; i < 8;++i){
+        bytes[i] = (char)(word >> (56 - 8*i));
     }
+    out.write(bytes, 8);
 }
 
-void NodeWrite::flush(std::ofstream &out)
+void NodeWrite::flush(std::ostream &out)
 {
-    // write 0 bits until writebuffer empty
-    while(writeBufferIndex != 0){
-        writeBit(out, 0);
-    }
-}
\ No newline at end of file
+    out.flush();
+}
@@ -3,18 +3,17 @@
 
 #include <vector>
 #include "structs.h"
-#include <fstream>
+#include <ostream>
 
 class NodeWrite
 {
 public:
-    static void writeNode(std::ofstream &SVOout, Node node);
-    static void writeRefer(std::ofstream &SVOout,uint64_t offset);
-    static void flush(std::ofstream &out);
+    static void writeNode(std::ostream &SVOout, Node node);
+    static void writeRefer(std::ostream &SVOout,uint64_t offset);
+    static uint64_t writeBrick(std::ostream &SVOout, uint64_t mask, const std::vector<RGBA8>& colors);
+    static void flush(std::ostream &out);
 private:
-    static void writeBit(std::ofstream &out, bool bit);
-    static uint8_t writeBuffer;
-    static uint8_t writeBufferIndex; 
+    static void writeWord(std::ostream &out, uint64_t word);
 };
 
-#endif
\ No newline at end of file
+#endif
@@ -0,0 +1,156 @@
+#include "PageCoder.h"
+#include "PagedFile.h"
+#include "NodeRead.h"
+#include "Profiler.h"
+
+#include <iostream>
+#include <chrono>
+#include <unordered_map>
+#include <algorithm>
+
+#define MAX_PALETTE 256     // pages with more colors store the colors raw
+
+void PageCoder::encode(const char* svoFile, const char* outputFile, unsigned int pageSize)
+{
+    std::cout << "Compressing pages of " << svoFile << "...\n";
+    Profiler::Scope scope("page compression");
+
+    // every page is decoded again to time the decoder
+    std::chrono::steady_clock::duration decodeTime(0);
+    bool exact = true;
+    PagedFile::Header header;
+    const uint64_t fileSize = PagedFile::encode(svoFile, outputFile, pageSize, [&decodeTime, &exact](const std::vector<uint64_t>& nodes, uint64_t){
+        std::vector<uint8_t> data = encodePage(nodes);
+        const std::chrono::steady_clock::time_point begin = std::chrono::steady_clock::now();
+        const std::vector<uint64_t> decoded = decodePage(data.data(), nodes.size());
+        decodeTime += std::chrono::steady_clock::now() - begin;
+        exact = exact && decoded == nodes;
+        return data;
+    }, header);
+    if (fileSize == 0) return;
+
+    const double seconds = std::max(std::chrono::duration<double>(decodeTime).count(), 1e-9);
+    Profiler::add(Profiler::ALL_BYTES_WRITTEN, fileSize);
+    std::cout << " Pages: " << header.totalPages << ", plain size: " << 8*header.totalNodes << " bytes, compressed size: " << fileSize
+              << " bytes, ratio " << (double)8*header.totalNodes/std::max(fileSize, (uint64_t)1) << "\n";
+    std::cout << " Decoded at " << 8*header.totalNodes/seconds/(1024*1024) << " MB/s of nodes, " << header.totalPages/seconds/1e6 << " M pages/s"
+              << (exact? "" : ", DECODED PAGES DIFFER") << "\n";
+}
+
+void PageCoder::decode(const char* inputFile, const char* svoFile)
+{
+    PagedFile::decode(inputFile, svoFile, decodePage);
+}
+
+std::vector<uint8_t> PageCoder::encodePage(const std::vector<uint64_t>& nodes)
+{
+    std::vector<uint8_t> out;
+
+    // palette in the order of the first use
+    std::vector<uint32_t> palette;
+    std::unordered_map<uint32_t, uint8_t> paletteIds;
+    for (unsigned int i = 0; i < nodes.size() && palette.size() <= MAX_PALETTE;++i){
+        const uint32_t color = nodes[i] & 0xFFFFFFFF;
+        if (paletteIds.count(color) == 0){
+            paletteIds[color] = palette.size();
+            palette.push_back(color);
+        }
+    }
+    const bool rawColors = palette.size() > MAX_PALETTE;
+    writeVarint(out, rawColors? 0 : palette.size());
+    for (unsigned int i = 0; i < palette.size() && !rawColors;++i){
+        for (int b = 24; b >= 0; b -= 8) out.push_back((palette[i] >> b) & 0xFF);
+    }
+
+    for (unsigned int i = 0; i < nodes.size();++i){
+        out.push_back(nodes[i] >> 56);
+    }
+
+    Predictor predictor;
+    for (unsigned int i = 0; i < nodes.size();++i){
+        const uint32_t field = (nodes[i] >> 32) & 0xFFFFFF;
+        writeVarint(out, zigzag((int32_t)field - (int32_t)predictor.predict(i, nodes[i] >> 56)));
+        predictor.update(i, nodes[i]);
+    }
+
+    for (unsigned int i = 0; i < nodes.size();++i){
+        const uint32_t color = nodes[i] & 0xFFFFFFFF;
+        if (rawColors){
+            for (int b = 24; b >= 0; b -= 8) out.push_back((color >> b) & 0xFF);
+        } else if (palette.size() > 1){
+            out.push_back(paletteIds[color]);
+        }
+    }
+    return out;
+}
+
+std::vector<uint64_t> PageCoder::decodePage(const uint8_t* data, unsigned int totalNodes)
+{
+    std::vector<uint64_t> nodes(totalNodes);
+
+    const uint32_t paletteSize = readVarint(data);
+    std::vector<uint32_t> palette(paletteSize);
+    for (unsigned int i = 0; i < paletteSize;++i){
+        palette[i] = (data[0] << 24) | (data[1] << 16) | (data[2] << 8) | data[3];
+        data += 4;
+    }
+
+    for (unsigned int i = 0; i < totalNodes;++i){
+        nodes[i] = (uint64_t)data[i] << 56;
+    }
+    data += totalNodes;
+
+    Predictor predictor;
+    for (unsigned int i = 0; i < totalNodes;++i){
+        const uint32_t field = predictor.predict(i, nodes[i] >> 56) + unzigzag(readVarint(data));
+        nodes[i] |= (uint64_t)(field & 0xFFFFFF) << 32;
+        predictor.update(i, nodes[i]);
+    }
+
+    for (unsigned int i = 0; i < totalNodes;++i){
+        if (paletteSize == 0){
+            nodes[i] |= (uint32_t)((data[0] << 24) | (data[1] << 16) | (data[2] << 8) | data[3]);
+            data += 4;
+        } else if (paletteSize == 1){
+            nodes[i] |= palette[0];
+        } else{
+            nodes[i] |= palette[*data++];
+        }
+    }
+    return nodes;
+}
+
+uint32_t PageCoder::Predictor::predict(unsigned int nodeIndex, uint8_t childBits) const
+{
+    // after an empty node or a leaf the next node is likely one too
+    if (lastChildren < 0) return 0;
+    const int64_t offset = lastChildren - __builtin_popcount(childBits) - nodeIndex;
+    return offset > 0 && offset < (1 << 23)? offset : 0;
+}
+
+void PageCoder::Predictor::update(unsigned int nodeIndex, uint64_t node)
+{
+    const Node decoded = NodeRead::decode(node);
+    lastChildren = decoded.childOffset == 0 && !decoded.referBit? -1 : nodeIndex + decoded.childOffset;
+}
+
+void PageCoder::writeVarint(std::vector<uint8_t>& out, uint32_t value)
+{
+    while (value >= 0x80){
+        out.push_back((value & 0x7F) | 0x80);
+        value >>= 7;
+    }
+    out.push_back(value);
+}
+
+uint32_t PageCoder::readVarint(const uint8_t*& in)
+{
+    uint32_t value = 0;
+    unsigned int shift = 0;
+    while (*in & 0x80){
+        value |= (uint32_t)(*in++ & 0x7F) << shift;
+        shift += 7;
+    }
+    value |= (uint32_t)*in++ << shift;
+    return value;
+}
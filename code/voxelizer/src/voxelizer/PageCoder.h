@@ -0,0 +1,41 @@
+#ifndef PAGECODER_H
+#define PAGECODER_H
+
+#include <vector>
+#include <cstdint>
+
+// Lossless compression of SVO files in the 64 bit node format for streaming.
+// Every page of <pageSize> nodes is compressed on its own and split in columns: the child masks,
+// the refer bit and child offset and the colors. The builder writes the children of a node right
+// in front of the children of the node before it, a child offset is stored as a zigzag varint of
+// the difference with the offset that follows from the node before it and the child mask. The
+// colors are ids in a palette of the colors of the page. The server can send the pages as they
+// are and a page can be decoded without any other page.
+//
+// File: a PagedFile of the pages
+// Page: <palette size:varint, 0 for raw colors><palette:32 each><masks:8 each>
+//       <offset differences:varint each><color ids:8 each, none for 1 color, raw colors:32 each>
+class PageCoder
+{
+public:
+    static void encode(const char* svoFile, const char* outputFile, unsigned int pageSize);
+    static void decode(const char* inputFile, const char* svoFile);
+
+    static std::vector<uint8_t> encodePage(const std::vector<uint64_t>& nodes);
+    static std::vector<uint64_t> decodePage(const uint8_t* data, unsigned int totalNodes);
+
+private:
+    // the offset field of a node follows from the node before it
+    struct Predictor{
+        int64_t lastChildren = -1;      // children or refer node of the node before, -1 for a leaf
+        uint32_t predict(unsigned int nodeIndex, uint8_t childBits) const;
+        void update(unsigned int nodeIndex, uint64_t node);
+    };
+
+    static void writeVarint(std::vector<uint8_t>& out, uint32_t value);
+    static uint32_t readVarint(const uint8_t*& in);
+    static uint32_t zigzag(int32_t value){ return value >= 0? 2*(uint32_t)value : 2*(uint32_t)(-(int64_t)value) - 1;}
+    static int32_t unzigzag(uint32_t value){ return (value & 1)? -(int32_t)((value - 1)/2) - 1 : value/2;}
+};
+
+#endif
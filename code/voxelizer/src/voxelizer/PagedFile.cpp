@@ -0,0 +1,152 @@
+#include "PagedFile.h"
+#include "NodeRead.h"
+
+#include <iostream>
+#include <algorithm>
+
+uint64_t PagedFile::encode(const char* svoFile, const char* outputFile, unsigned int pageSize, const PageEncoder& encodePage,
+                           Header& header)
+{
+    if (pageSize == 0){
+        std::cout << "The page size must be at least 1 node\n";
+        return 0;
+    }
+    std::ifstream in(svoFile, std::ios::binary | std::ios::ate);
+    std::ofstream out(outputFile, std::ios::binary | std::ios::out);
+    if (!in.is_open() || !out.is_open()){
+        std::cout << "Failed to open SVO files\n";
+        return 0;
+    }
+
+    header.pageSize = pageSize;
+    header.totalNodes = in.tellg()/8;
+    header.totalPages = (header.totalNodes + pageSize - 1)/pageSize;
+    in.seekg(0, std::ios::beg);
+
+    // write header, the page offsets are filled in when all pages are written
+    const unsigned int size = _byteswap_ulong(pageSize);
+    out.write((const char*)&size, 4);
+    writeUint64(out, header.totalNodes);
+    for (uint64_t i = 0; i <= header.totalPages;++i){
+        writeUint64(out, 0);
+    }
+
+    std::vector<uint64_t> pageOffsets;
+    std::vector<uint8_t> bytes(8*pageSize);
+    uint64_t offset = 0;
+    for (uint64_t page = 0; page < header.totalPages;++page){
+        const unsigned int totalNodes = pageNodes(header, page);
+        in.read((char*)bytes.data(), 8*totalNodes);
+
+        std::vector<uint64_t> nodes;
+        for (unsigned int i = 0; i < totalNodes;++i){
+            nodes.push_back(NodeRead::fromBytes(&bytes[8*i]));
+        }
+
+        const std::vector<uint8_t> data = encodePage(nodes, page);
+        out.write((const char*)data.data(), data.size());
+
+        pageOffsets.push_back(offset);
+        offset += data.size();
+    }
+    pageOffsets.push_back(offset);
+
+    // fill in the page offsets
+    out.seekp(HEADER_SIZE, std::ios::beg);
+    for (uint64_t i = 0; i < pageOffsets.size();++i){
+        writeUint64(out, pageOffsets[i]);
+    }
+    return HEADER_SIZE + 8*pageOffsets.size() + offset;
+}
+
+bool PagedFile::decode(const char* inputFile, const char* svoFile, PageDecoder decodePage)
+{
+    std::ifstream in(inputFile, std::ios::binary);
+    std::ofstream out(svoFile, std::ios::binary | std::ios::out);
+    if (!in.is_open() || !out.is_open()){
+        std::cout << "Failed to open SVO files\n";
+        return false;
+    }
+
+    Header header;
+    if (!readHeader(in, header)) return false;
+    uint8_t bytes[8];
+    for (uint64_t page = 0; page < header.totalPages;++page){
+        const std::vector<uint64_t> nodes = readPage(in, header, page, decodePage);
+        for (unsigned int i = 0; i < nodes.size();++i){
+            NodeRead::toBytes(nodes[i], bytes);
+            out.write((const char*)bytes, 8);
+        }
+    }
+    return true;
+}
+
+bool PagedFile::readHeader(std::ifstream &in, Header& header)
+{
+    in.seekg(0, std::ios::end);
+    const uint64_t fileSize = in.tellg();
+    uint8_t bytes[HEADER_SIZE] = {};
+    in.seekg(0, std::ios::beg);
+    in.read((char*)bytes, HEADER_SIZE);
+    in.clear();
+    return readHeader(bytes, fileSize, header);
+}
+
+bool PagedFile::readHeader(const uint8_t* bytes, uint64_t fileSize, Header& header)
+{
+    header = {0, 0, 0};
+    if (fileSize < HEADER_SIZE + 8){
+        std::cout << "The paged file is truncated\n";
+        return false;
+    }
+    header.pageSize = ((unsigned int)bytes[0] << 24) | (bytes[1] << 16) | (bytes[2] << 8) | bytes[3];
+    header.totalNodes = NodeRead::fromBytes(bytes + 4);
+    if (header.pageSize == 0){
+        std::cout << "The paged file has page size 0\n";
+        header.totalNodes = 0;
+        return false;
+    }
+    header.totalPages = (header.totalNodes + header.pageSize - 1)/header.pageSize;
+
+    // every page and the end have an offset
+    if (header.totalPages > (fileSize - HEADER_SIZE)/8 - 1){
+        std::cout << "The paged file has " << header.totalPages << " pages but only offsets for "
+                  << (fileSize - HEADER_SIZE)/8 - 1 << " pages\n";
+        header = {0, 0, 0};
+        return false;
+    }
+    return true;
+}
+
+std::vector<uint64_t> PagedFile::readPage(std::ifstream &in, const Header& header, uint64_t page, PageDecoder decodePage)
+{
+    // find the page in the offset table
+    in.seekg(HEADER_SIZE + 8*page, std::ios::beg);
+    const uint64_t begin = readUint64(in);
+    const uint64_t end = readUint64(in);
+
+    std::vector<uint8_t> data(end - begin);
+    in.seekg(pagesBegin(header) + begin, std::ios::beg);
+    in.read((char*)data.data(), data.size());
+    return decodePage(data.data(), pageNodes(header, page));
+}
+
+unsigned int PagedFile::pageNodes(const Header& header, uint64_t page)
+{
+    // the last page can be shorter
+    return std::min((uint64_t)header.pageSize, header.totalNodes - page*header.pageSize);
+}
+
+void PagedFile::writeUint64(std::ofstream &out, uint64_t value)
+{
+    uint8_t bytes[8];
+    NodeRead::toBytes(value, bytes);
+    out.write((const char*)bytes, 8);
+}
+
+uint64_t PagedFile::readUint64(std::ifstream &in)
+{
+    uint8_t bytes[8];
+    in.read((char*)bytes, 8);
+    return NodeRead::fromBytes(bytes);
+}
@@ -0,0 +1,49 @@
+#ifndef PAGEDFILE_H
+#define PAGEDFILE_H
+
+#include <vector>
+#include <fstream>
+#include <functional>
+#include <cstdint>
+
+// The file of the page coders: the nodes of an SVO file in pages of <pageSize> nodes, every page
+// coded on its own and found with a table of page offsets, so a page can be read without the
+// pages before it. The coders only code and decode the nodes of one page.
+//
+// File: <pageSize:32><totalNodes:64><pageOffset:64 for every page + end offset><pages>
+class PagedFile
+{
+public:
+    static const unsigned int HEADER_SIZE = 12;
+
+    struct Header{
+        unsigned int pageSize;
+        uint64_t totalNodes;
+        uint64_t totalPages;
+    };
+
+    // codes the nodes of a page, the page index gives the position of the nodes in the SVO file
+    typedef std::function<std::vector<uint8_t>(const std::vector<uint64_t>& nodes, uint64_t page)> PageEncoder;
+    typedef std::vector<uint64_t> (*PageDecoder)(const uint8_t* data, unsigned int totalNodes);
+
+    // returns the size of the written file, 0 when it isn't written
+    static uint64_t encode(const char* svoFile, const char* outputFile, unsigned int pageSize, const PageEncoder& encodePage,
+                           Header& header);
+    static bool decode(const char* inputFile, const char* svoFile, PageDecoder decodePage);
+
+    // the header is read once for all pages, false with a message for a header with page size 0
+    // or more pages than the file has offsets for
+    static bool readHeader(std::ifstream &in, Header& header);
+    static bool readHeader(const uint8_t* bytes, uint64_t fileSize, Header& header);
+    static std::vector<uint64_t> readPage(std::ifstream &in, const Header& header, uint64_t page, PageDecoder decodePage);
+
+    // the pages start behind the page offsets
+    static uint64_t pagesBegin(const Header& header){ return HEADER_SIZE + 8*(header.totalPages + 1);}
+    static unsigned int pageNodes(const Header& header, uint64_t page);
+
+private:
+    static void writeUint64(std::ofstream &out, uint64_t value);
+    static uint64_t readUint64(std::ifstream &in);
+};
+
+#endif
@@ -0,0 +1,174 @@
+#include "PrefetchManifest.h"
+#include "MappedFile.h"
+#include "NodeTree.h"
+#include "FarPointers.h"
+#include "Profiler.h"
+
+#include <iostream>
+#include <iomanip>
+#include <fstream>
+#include <vector>
+#include <algorithm>
+
+#define MAX_DEPTH 21            // the voxels of a solid leaf at the root fit in 64 bits
+
+bool PrefetchManifest::write(const char* svoFile, const char* outputFile, const char* farTableFile, unsigned int pageSize,
+                             unsigned int maxEntries, unsigned int depth, bool bricks)
+{
+    MappedFile file(svoFile);
+    if (!file.isOpen() || file.size() < 8){
+        std::cout << "Failed to open " << svoFile << "\n";
+        return false;
+    }
+    if (pageSize < 8){
+        std::cout << "The prefetch manifest needs pages of at least 8 nodes\n";
+        return false;
+    }
+    if (depth > MAX_DEPTH){
+        std::cout << "The prefetch manifest supports depths up to " << MAX_DEPTH << "\n";
+        return false;
+    }
+    std::cout << "Writing prefetch manifest of " << svoFile << "...\n";
+    Profiler::Scope scope("prefetch manifest");
+
+    const uint64_t totalWords = file.size()/8;
+    const uint64_t totalPages = (totalWords + pageSize - 1)/pageSize;
+    const NodeTree tree(file.data(), totalWords, FarPointers::readTable(farTableFile), bricks? depth : 0);
+
+    std::vector<Entry> entries;
+    const auto addEntry = [&entries, pageSize](uint64_t pointer, uint64_t page, uint64_t voxels){
+        if (voxels > 0 && page != pointer/pageSize) entries.push_back({pointer/pageSize, page, voxels});
+    };
+
+    // the voxels of a subtree, the voxels of the children of a node by page, its children span at
+    // most 2 pages, and the page of its refer word
+    struct Subtree{
+        uint64_t voxels;
+        uint64_t childVoxels[2];
+        uint64_t referPage;
+    };
+    // a node with children at the depth, the level of the voxels, means the SVO is deeper than
+    // the depth, the walk stops there
+    bool tooDeep = false;
+    const auto visit = [&](uint64_t pointer, unsigned int level, Subtree& subtree) -> uint64_t{
+        if (tooDeep || pointer >= totalWords) return NodeTree::NO_POINTER;
+        const Node node = tree.node(pointer);
+        if (node.childBits == 0) return NodeTree::NO_POINTER;
+        if (node.childOffset == 0){
+            // a solid leaf fills its cube down to the last level, a voxel is a solid leaf there
+            subtree.voxels = node.childBits == 255? (uint64_t)1 << 3*(depth - level) : __builtin_popcount(node.childBits);
+            return NodeTree::NO_POINTER;
+        }
+        if (level >= depth){
+            tooDeep = true;
+            return NodeTree::NO_POINTER;
+        }
+
+        // the refer word is needed to find the children
+        uint64_t referWord;
+        const uint64_t children = tree.children(pointer, node, &referWord);
+        const uint64_t referPage = referWord != NodeTree::NO_POINTER? referWord/pageSize : ~(uint64_t)0;
+        if (children >= totalWords) return NodeTree::NO_POINTER;
+
+        if (level == tree.brickLevel()){
+            const unsigned int voxels = tree.brickVoxels(children);
+            const uint64_t last = children + tree.brickWords(children) - 1;
+            for (uint64_t page = children/pageSize; page <= last/pageSize;++page) addEntry(pointer, page, voxels);
+            if (referPage != ~(uint64_t)0) addEntry(pointer, referPage, voxels);
+            subtree.voxels = voxels;
+            return NodeTree::NO_POINTER;
+        }
+        subtree = {0, {0, 0}, referPage};
+        return children;
+    };
+    const auto addChild = [pageSize](NodeTree::Frame<Subtree>& parent, uint64_t child, const Subtree& subtree){
+        if (subtree.voxels == 0) return;
+        parent.value.voxels += subtree.voxels;
+        parent.value.childVoxels[child/pageSize - parent.children/pageSize] += subtree.voxels;
+    };
+    // a subtree is done, its pages are ranked by the voxels behind them
+    const auto close = [&addEntry, pageSize](const NodeTree::Frame<Subtree>& done){
+        addEntry(done.pointer, done.children/pageSize, done.value.childVoxels[0]);
+        addEntry(done.pointer, done.children/pageSize + 1, done.value.childVoxels[1]);
+        if (done.value.referPage != ~(uint64_t)0) addEntry(done.pointer, done.value.referPage, done.value.voxels);
+    };
+    const uint64_t totalVoxels = tree.walk<Subtree>(visit, addChild, close).voxels;
+    if (tooDeep){
+        std::cout << "The SVO " << svoFile << " is deeper than depth " << depth << ", the prefetch manifest is not written\n";
+        return false;
+    }
+
+    // the entries of the same pages are added together, the pages of every page are sorted by voxels
+    std::sort(entries.begin(), entries.end(), [](const Entry& a, const Entry& b){
+        return a.from < b.from || (a.from == b.from && a.page < b.page);
+    });
+    uint64_t merged = 0;
+    for (uint64_t i = 0; i < entries.size();++i){
+        if (merged > 0 && entries[merged - 1].from == entries[i].from && entries[merged - 1].page == entries[i].page){
+            entries[merged - 1].voxels += entries[i].voxels;
+        } else{
+            entries[merged++] = entries[i];
+        }
+    }
+    entries.resize(merged);
+
+    std::vector<uint64_t> fanOut(MAX_FAN_OUT + 1, 0);
+    uint64_t maxFanOut = 0;
+    uint64_t truncated = 0;
+    uint64_t allVoxels = 0;
+    uint64_t firstVoxels = 0;
+    std::vector<uint64_t> offsets(totalPages + 1, 0);
+    std::vector<Entry> kept;
+    uint64_t begin = 0;
+    for (uint64_t page = 0; page < totalPages;++page){
+        offsets[page] = kept.size();
+        uint64_t end = begin;
+        while (end < entries.size() && entries[end].from == page) end += 1;
+        std::sort(entries.begin() + begin, entries.begin() + end, [](const Entry& a, const Entry& b){
+            return a.voxels > b.voxels || (a.voxels == b.voxels && a.page < b.page);
+        });
+
+        const uint64_t pages = end - begin;
+        fanOut[std::min(pages, (uint64_t)MAX_FAN_OUT)] += 1;
+        maxFanOut = std::max(maxFanOut, pages);
+        if (pages > maxEntries) truncated += 1;
+        for (uint64_t i = begin; i < end;++i) allVoxels += entries[i].voxels;
+        if (pages > 0) firstVoxels += entries[begin].voxels;
+        kept.insert(kept.end(), entries.begin() + begin, entries.begin() + std::min(end, begin + maxEntries));
+        begin = end;
+    }
+    offsets[totalPages] = kept.size();
+
+    std::ofstream out(outputFile, std::ios::binary | std::ios::out);
+    if (!out.is_open()){
+        std::cout << "Failed to open " << outputFile << "\n";
+        return false;
+    }
+    const unsigned int header = _byteswap_ulong(pageSize);
+    out.write((const char*)&header, 4);
+    uint8_t bytes[8];
+    NodeRead::toBytes(totalPages, bytes);
+    out.write((const char*)bytes, 8);
+    for (uint64_t offset : offsets){
+        NodeRead::toBytes(offset, bytes);
+        out.write((const char*)bytes, 8);
+    }
+    for (const Entry& entry : kept){
+        NodeRead::toBytes(entry.page, bytes);
+        out.write((const char*)bytes, 8);
+        NodeRead::toBytes(entry.voxels, bytes);
+        out.write((const char*)bytes, 8);
+    }
+
+    const uint64_t size = 12 + 8*offsets.size() + 16*kept.size();
+    Profiler::add(Profiler::ALL_BYTES_WRITTEN, size);
+    std::cout << " Pages: " << totalPages << ", voxels: " << totalVoxels << ", entries: " << entries.size() << " -> " << kept.size()
+              << " (at most " << maxEntries << " per page, " << truncated << " pages cut), " << size << " bytes\n";
+    std::cout << std::fixed << std::setprecision(2);
+    std::cout << " Fan-out, the other pages the children of a page lead into: mean " << (totalPages > 0? (double)entries.size()/totalPages : 0.0)
+              << ", max " << maxFanOut << ", voxels behind the first page: " << (allVoxels > 0? 100.0*firstVoxels/allVoxels : 0.0) << "%\n";
+    for (unsigned int f = 0; f <= MAX_FAN_OUT;++f){
+        std::cout << std::setw(4) << f << (f == MAX_FAN_OUT? "+: " : ": ") << fanOut[f] << " pages\n";
+    }
+    return true;
+}
@@ -0,0 +1,30 @@
+#ifndef PREFETCHMANIFEST_H
+#define PREFETCHMANIFEST_H
+
+#include <cstdint>
+
+// Prefetch manifest of an SVO file in the 64 bit node format: for every page the other pages the
+// child pointers of its nodes lead into (the children, their refer words and bricks), ranked by
+// the voxels of the subtrees behind them. A server or a load generator can send the first pages
+// of the list before the client asks for them. The tree is walked once depth first with the file
+// memory mapped, a far pointer table next to the file is used for the refer bits. A solid leaf
+// stands for all voxels below it down to the depth of the SVO, a brick for its mask bits.
+//
+// File: <pageSize:32><pages:64><entryOffset:64 for every page + end><page:64><voxels:64 for every entry>
+class PrefetchManifest
+{
+public:
+    // at most maxEntries pages are kept per page, depth is the depth of the SVO
+    static bool write(const char* svoFile, const char* outputFile, const char* farTableFile, unsigned int pageSize,
+                      unsigned int maxEntries, unsigned int depth, bool bricks = false);
+
+private:
+    // voxels behind a page the children of a page lead into
+    struct Entry{
+        uint64_t from;
+        uint64_t page;
+        uint64_t voxels;
+    };
+};
+
+#endif
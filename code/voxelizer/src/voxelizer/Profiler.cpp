@@ -0,0 +1,219 @@
+#include "Profiler.h"
+#include "MemoryTracker.h"
+
+#include <iostream>
+#include <fstream>
+#include <atomic>
+#include <chrono>
+#include <mutex>
+#include <vector>
+#include <map>
+#include <iomanip>
+
+#ifdef __linux__
+#include <cstring>
+#include <cerrno>
+#include <unistd.h>
+#include <sys/syscall.h>
+#include <linux/perf_event.h>
+#endif
+
+static const char* COUNTER_NAMES[Profiler::TOTAL_COUNTERS] = {"voxels", "nodes", "referNodes", "bytesWritten", "allBytesWritten"};
+static const char* HARDWARE_COUNTER_NAMES[Profiler::TOTAL_HARDWARE_COUNTERS] = {"cycles", "llcMisses"};
+
+// a finished scope
+struct TraceEvent{
+    const char* stage;
+    unsigned int thread;
+    uint64_t begin;         // ns since profiling was enabled
+    uint64_t duration;
+    uint64_t hardware[Profiler::TOTAL_HARDWARE_COUNTERS];
+};
+
+static std::atomic<bool> profiling{false};
+static bool hardwareProfiling = false;
+static std::chrono::steady_clock::time_point startTime;
+static std::atomic<uint64_t> counters[Profiler::TOTAL_COUNTERS];
+static std::atomic<unsigned int> totalThreads{0};
+static std::mutex eventsMutex;
+static std::vector<TraceEvent> events;
+
+static uint64_t now()
+{
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - startTime).count();
+}
+
+// index of the calling thread in the trace
+static unsigned int threadIndex()
+{
+    thread_local unsigned int index = totalThreads++;
+    return index;
+}
+
+#ifdef __linux__
+// the hardware counters of the calling thread, opened on its first scope
+struct HardwareCounters{
+    int fds[Profiler::TOTAL_HARDWARE_COUNTERS] = {-1, -1};
+
+    HardwareCounters()
+    {
+        const uint64_t configs[Profiler::TOTAL_HARDWARE_COUNTERS] = {PERF_COUNT_HW_CPU_CYCLES, PERF_COUNT_HW_CACHE_MISSES};
+        for (unsigned int i = 0; i < Profiler::TOTAL_HARDWARE_COUNTERS;++i){
+            perf_event_attr attr;
+            memset(&attr, 0, sizeof(attr));
+            attr.type = PERF_TYPE_HARDWARE;
+            attr.size = sizeof(attr);
+            attr.config = configs[i];
+            attr.exclude_kernel = 1;
+            attr.exclude_hv = 1;
+            fds[i] = syscall(__NR_perf_event_open, &attr, 0, -1, -1, 0);
+            if (fds[i] < 0){
+                static std::atomic<bool> reported{false};
+                if (!reported.exchange(true)){
+                    std::cout << "Hardware counter " << HARDWARE_COUNTER_NAMES[i] << " is not available: " << strerror(errno) << "\n";
+                }
+            }
+        }
+    }
+    ~HardwareCounters()
+    {
+        for (unsigned int i = 0; i < Profiler::TOTAL_HARDWARE_COUNTERS;++i){
+            if (fds[i] >= 0) close(fds[i]);
+        }
+    }
+};
+#endif
+
+static void readHardwareCounters(uint64_t values[Profiler::TOTAL_HARDWARE_COUNTERS])
+{
+#ifdef __linux__
+    thread_local HardwareCounters hardware;
+    for (unsigned int i = 0; i < Profiler::TOTAL_HARDWARE_COUNTERS;++i){
+        values[i] = 0;
+        if (hardware.fds[i] >= 0 && read(hardware.fds[i], &values[i], sizeof(uint64_t)) != sizeof(uint64_t)) values[i] = 0;
+    }
+#else
+    for (unsigned int i = 0; i < Profiler::TOTAL_HARDWARE_COUNTERS;++i) values[i] = 0;
+#endif
+}
+
+void Profiler::enable(bool hardwareCounters)
+{
+    startTime = std::chrono::steady_clock::now();
+#ifndef __linux__
+    if (hardwareCounters){
+        std::cout << "Hardware counters are only supported on Linux\n";
+        hardwareCounters = false;
+    }
+#endif
+    hardwareProfiling = hardwareCounters;
+    profiling = true;
+}
+
+bool Profiler::enabled()
+{
+    return profiling.load(std::memory_order_relaxed);
+}
+
+void Profiler::add(Counter counter, uint64_t value)
+{
+    if (enabled()) counters[counter].fetch_add(value, std::memory_order_relaxed);
+}
+
+Profiler::Scope::Scope(const char* stage)
+    : _stage{stage}
+{
+    if (!enabled()) return;
+    if (hardwareProfiling) readHardwareCounters(_hardware);
+    _begin = now();
+}
+
+Profiler::Scope::~Scope()
+{
+    if (!enabled()) return;
+    TraceEvent event{_stage, threadIndex(), _begin, now() - _begin, {0, 0}};
+    if (hardwareProfiling){
+        readHardwareCounters(event.hardware);
+        for (unsigned int i = 0; i < Profiler::TOTAL_HARDWARE_COUNTERS;++i) event.hardware[i] -= _hardware[i];
+    }
+
+    std::lock_guard<std::mutex> lock(eventsMutex);
+    events.push_back(event);
+}
+
+void Profiler::write(const std::string& summaryFile, const std::string& traceFile)
+{
+    if (!enabled()) return;
+    const uint64_t totalTime = now();
+    std::lock_guard<std::mutex> lock(eventsMutex);
+
+    if (summaryFile != ""){
+        // the scopes of a stage are added up, nested stages are included in the time of their parents
+        struct Stage{
+            uint64_t calls = 0;
+            uint64_t time = 0;
+            uint64_t hardware[Profiler::TOTAL_HARDWARE_COUNTERS] = {0, 0};
+        };
+        std::map<std::string, Stage> stages;
+        for (unsigned int i = 0; i < events.size();++i){
+            Stage& stage = stages[events[i].stage];
+            stage.calls += 1;
+            stage.time += events[i].duration;
+            for (unsigned int h = 0; h < Profiler::TOTAL_HARDWARE_COUNTERS;++h) stage.hardware[h] += events[i].hardware[h];
+        }
+
+        std::ofstream out(summaryFile);
+        out << std::fixed << std::setprecision(6);
+        out << "{\n  \"seconds\": " << totalTime*1e-9 << ",\n  \"threads\": " << totalThreads << ",\n  \"counters\": {";
+        for (unsigned int c = 0; c < TOTAL_COUNTERS;++c){
+            out << (c > 0? ", " : "") << "\"" << COUNTER_NAMES[c] << "\": " << counters[c];
+        }
+        out << "},\n  \"memory\": {";
+        for (unsigned int m = 0; m < MemoryTracker::TOTAL_SUBSYSTEMS;++m){
+            const MemoryTracker::Subsystem subsystem = (MemoryTracker::Subsystem)m;
+            out << "\"" << MemoryTracker::name(subsystem) << "\": {\"current\": " << MemoryTracker::current(subsystem) <<
+                   ", \"highWater\": " << MemoryTracker::highWater(subsystem) << "}, ";
+        }
+        out << "\"highWater\": " << MemoryTracker::totalHighWater() << ", \"budget\": " << MemoryTracker::budget();
+        out << "},\n  \"stages\": [";
+        bool first = true;
+        for (const auto& stage : stages){
+            out << (first? "\n" : ",\n") << "    {\"name\": \"" << stage.first << "\", \"calls\": " << stage.second.calls << ", \"seconds\": " << stage.second.time*1e-9;
+            if (hardwareProfiling){
+                for (unsigned int h = 0; h < Profiler::TOTAL_HARDWARE_COUNTERS;++h){
+                    out << ", \"" << HARDWARE_COUNTER_NAMES[h] << "\": " << stage.second.hardware[h];
+                }
+            }
+            out << "}";
+            first = false;
+        }
+        out << "\n  ]\n}\n";
+        std::cout << "Profile summary written to " << summaryFile << "\n";
+    }
+
+    if (traceFile != ""){
+        // complete events in microseconds, the counters are counter events at the end of the trace
+        std::ofstream out(traceFile);
+        out << std::fixed << std::setprecision(3);
+        out << "{\"traceEvents\": [\n";
+        for (unsigned int i = 0; i < events.size();++i){
+            const TraceEvent& event = events[i];
+            out << "{\"name\": \"" << event.stage << "\", \"ph\": \"X\", \"pid\": 1, \"tid\": " << event.thread <<
+                   ", \"ts\": " << event.begin/1000.0 << ", \"dur\": " << event.duration/1000.0;
+            if (hardwareProfiling){
+                out << ", \"args\": {";
+                for (unsigned int h = 0; h < Profiler::TOTAL_HARDWARE_COUNTERS;++h){
+                    out << (h > 0? ", " : "") << "\"" << HARDWARE_COUNTER_NAMES[h] << "\": " << event.hardware[h];
+                }
+                out << "}";
+            }
+            out << "},\n";
+        }
+        out << "{\"name\": \"counters\", \"ph\": \"C\", \"pid\": 1, \"ts\": " << totalTime/1000.0 << ", \"args\": {";
+        for (unsigned int c = 0; c < TOTAL_COUNTERS;++c){
+            out << (c > 0? ", " : "") << "\"" << COUNTER_NAMES[c] << "\": " << counters[c];
+        }
+        out << "}}\n]}\n";
+        std::cout << "Trace written to " << traceFile << "\n";
+    }
+}
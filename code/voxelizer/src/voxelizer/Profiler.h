@@ -0,0 +1,48 @@
+#ifndef PROFILER_H
+#define PROFILER_H
+
+#include <cstdint>
+#include <string>
+
+// Timing of the stages of a build. A Profiler::Scope measures the stage of its lifetime on any
+// thread, nested scopes are nested stages. The summary is a JSON file with the time, the calls and
+// the hardware counters of every stage and the build counters; the trace is a Chrome trace event
+// file (chrome://tracing or Perfetto). The hardware counters (cycles, LLC misses) of every thread are
+// read with perf_event_open, only on Linux. A scope costs a branch when profiling is off.
+class Profiler
+{
+public:
+    enum Counter{
+        VOXELS,             // voxels added to the SVO builders
+        NODES,              // words of the built plain SVO file, refer nodes and bricks included
+        REFER_NODES,        // refer nodes of offsets that don't fit in 23 bits
+        BYTES_WRITTEN,      // bytes of the output file and its side files
+        ALL_BYTES_WRITTEN,  // bytes written to all files, the temporary files included
+        TOTAL_COUNTERS
+    };
+    enum HardwareCounter{
+        CYCLES,
+        LLC_MISSES,
+        TOTAL_HARDWARE_COUNTERS
+    };
+
+    class Scope
+    {
+    public:
+        Scope(const char* stage);
+        ~Scope();
+    private:
+        const char* _stage;
+        uint64_t _begin = 0;
+        uint64_t _hardware[TOTAL_HARDWARE_COUNTERS] = {0, 0};
+    };
+
+    static void enable(bool hardwareCounters);
+    static bool enabled();
+    static void add(Counter counter, uint64_t value);
+
+    // writes the JSON summary and the trace, a file with an empty name is not written
+    static void write(const std::string& summaryFile, const std::string& traceFile);
+};
+
+#endif
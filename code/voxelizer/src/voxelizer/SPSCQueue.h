@@ -0,0 +1,62 @@
+#ifndef SPSCQUEUE_H
+#define SPSCQUEUE_H
+
+#include <mutex>
+#include <condition_variable>
+#include <vector>
+#include <cstddef>
+
+// Bounded queue between 1 producer thread and 1 consumer thread of a pipeline.
+// push waits while the queue is full, so a fast stage can't run ahead of a slow stage.
+// pop waits while the queue is empty and returns false when the queue is closed and empty.
+// A waiting stage sleeps on a condition variable, the stages hand over large items so the lock is cheap.
+template <typename T>
+class SPSCQueue
+{
+public:
+    SPSCQueue(size_t capacity)
+        : _items(capacity > 0? capacity : 1)
+    {
+    }
+
+    void push(T item)
+    {
+        std::unique_lock<std::mutex> lock(_mutex);
+        _notFull.wait(lock, [this]{ return _size < _items.size(); });
+        _items[(_head + _size) % _items.size()] = std::move(item);
+        _size += 1;
+        _notEmpty.notify_one();
+    }
+
+    bool pop(T& item)
+    {
+        std::unique_lock<std::mutex> lock(_mutex);
+        // the producer may have pushed items before it closed the queue
+        _notEmpty.wait(lock, [this]{ return _size > 0 || _closed; });
+        if (_size == 0) return false;
+        item = std::move(_items[_head]);
+        _head = (_head + 1) % _items.size();
+        _size -= 1;
+        _notFull.notify_one();
+        return true;
+    }
+
+    // called by the producer after the last push
+    void close()
+    {
+        std::lock_guard<std::mutex> lock(_mutex);
+        _closed = true;
+        _notEmpty.notify_one();
+    }
+
+private:
+    std::vector<T> _items;
+    size_t _head = 0;
+    size_t _size = 0;
+    bool _closed = false;
+    std::mutex _mutex;
+    std::condition_variable _notFull;
+    std::condition_variable _notEmpty;
+};
+
+#endif
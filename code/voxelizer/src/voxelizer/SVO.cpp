@@ -15,6 +15,7 @@ SVO::SVO(const std::vector<Voxel> voxels, const unsigned int depth)
 
     std::cout << " Optimizing tree\n";
     optimizeTree(&_root);
+    _memory.resize(totalElements(_root)*sizeof(NestedElement));
 }
 
 void SVO::addElement(Voxel voxel, NestedElement *tree, unsigned int maxDepth, float voxelSize, float offsetX, float offsetY, float offsetZ)
@@ -62,6 +63,7 @@ void SVO::addElement(Voxel voxel, NestedElement *tree, unsigned int maxDepth, fl
     {
         NestedElement el{true, {}, 0,0,0,0};
         tree->children.push_back(el);
+        _memory.resize(_memory.bytes() + sizeof(NestedElement));
     }
     
     // mix colors
@@ -200,42 +202,14 @@ SVO::SVO(SVO children[8])
     }
 
     _depth += 1;
+    _memory.resize(totalElements(_root)*sizeof(NestedElement));
 }
 
-void SVO::addSVO(const SVO other)
+uint64_t SVO::totalElements(const NestedElement& tree)
 {
-    combine(&_root, &other._root);
-    optimizeTree(&_root);
-}
-
-void SVO::combine(NestedElement* first, const NestedElement* second)
-{
-    // if empty, no elements need adding
-    if (second->isEmpty) return;
-
-    first->isEmpty = false;
-
-    // mix colors
-    if (first->A <= 0){
-        // root does not yet have a color, give it the color of the child
-        first->R = second->R;
-        first->G = second->G;
-        first->B = second->B;
-        first->A = second->A;
-    } else{
-        // mix node color with color of the child
-        first->R = (first->R + second->R)/2;
-        first->G = (first->G + second->G)/2;
-        first->B = (first->B + second->B)/2;
-        first->A = (first->A + second->A)/2;
-    }
-
-    // add children
-    for (unsigned int i = 0; i < second->children.size();++i){
-        if (i < first->children.size()){
-            combine(&first->children[i], &second->children[i]);
-        } else{
-            first->children.push_back(second->children[i]);
-        }
+    uint64_t total = tree.children.size();
+    for (unsigned int i = 0; i < tree.children.size();++i){
+        total += totalElements(tree.children[i]);
     }
-}
\ No newline at end of file
+    return total;
+}
@@ -2,6 +2,7 @@
 #define SVO_H
 
 #include "structs.h"
+#include "MemoryTracker.h"
 #include <vector>
 #include <fstream>
 
@@ -21,9 +22,7 @@ public:
 
     SVO(SVO children[8]);
 
-    void addSVO(const SVO other);
-
-    NestedElement getRoot() const { return _root;}
+    const NestedElement& getRoot() const { return _root;}
 private:
 
 
@@ -33,10 +32,11 @@ private:
     void optimizeEmptyElements(NestedElement* tree);
     void optimizeSolidElements(NestedElement* tree);
 
-    static void combine(NestedElement* first, const NestedElement* second);
+    static uint64_t totalElements(const NestedElement& tree);
 
     NestedElement _root{true, {}, 0,0,0,0};
     unsigned int _depth;
+    MemoryTracker::Block _memory{MemoryTracker::BUILDER};   // the elements of the tree
 
 };
 
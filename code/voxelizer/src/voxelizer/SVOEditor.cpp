@@ -0,0 +1,310 @@
+#include "SVOEditor.h"
+#include "NodeRead.h"
+#include "ofcSVO.h"
+
+#include <iostream>
+
+SVOEditor::SVOEditor(const char* svoFile, unsigned int depth)
+    : _depth{depth}
+{
+    _file.open(svoFile, std::ios::binary | std::ios::in | std::ios::out | std::ios::ate);
+    if (!_file.is_open()){
+        std::cout << "Failed to open SVO file " << svoFile << "\n";
+        _totalNodes = 0;
+        _fileNodes = 0;
+        return;
+    }
+    _totalNodes = _file.tellg()/8;
+    _fileNodes = _totalNodes;
+}
+
+SVOEditor::~SVOEditor()
+{
+    _file.close();
+}
+
+void SVOEditor::setVoxels(uint64_t mortonBegin, uint64_t mortonEnd, RGBA8 color)
+{
+    edit(mortonBegin, mortonEnd, SET, color);
+}
+
+void SVOEditor::clearVoxels(uint64_t mortonBegin, uint64_t mortonEnd)
+{
+    edit(mortonBegin, mortonEnd, CLEAR, {0,0,0,0});
+}
+
+void SVOEditor::recolorVoxels(uint64_t mortonBegin, uint64_t mortonEnd, RGBA8 color)
+{
+    edit(mortonBegin, mortonEnd, RECOLOR, color);
+}
+
+void SVOEditor::edit(uint64_t mortonBegin, uint64_t mortonEnd, Operation operation, RGBA8 color)
+{
+    if (_totalNodes <= 0) return;
+
+    _mortonBegin = mortonBegin;
+    _mortonEnd = mortonEnd;
+    _operation = operation;
+    _color = color;
+    const uint64_t startNodes = _totalNodes;
+
+    // rebuild the paths to the edited voxels in memory
+    EditNode root = loadNode(0);
+    if (!build(root, 0, 0)){
+        std::cout << "Edit did not change the SVO\n";
+        return;
+    }
+
+    // write the root on its position and the changed children after it
+    const uint64_t target = childTarget(root);
+    writeWord(0, encodeChild(root, 0, target, true));
+    if (hasChildren(root) && root.childrenChanged){
+        writeChildren(root, target);
+    }
+    _file.flush();
+
+    std::cout << "Edit done, nodes appended: " << _totalNodes - startNodes << ", total nodes: " << _totalNodes << "\n";
+}
+
+bool SVOEditor::build(EditNode& editNode, unsigned int level, uint64_t code)
+{
+    // find the morton codes covered by the node
+    const uint64_t size = (uint64_t)1 << (3*(_depth - level));
+    const uint64_t begin = code*size;
+    const uint64_t end = begin + size;
+    if (end <= _mortonBegin || begin >= _mortonEnd) return false;
+    const bool covered = begin >= _mortonBegin && end <= _mortonEnd;
+
+    Node node{{0,0,0,0}, 0, 0,0};
+    if (covered && _operation == SET){
+        node = {_color, 255, 0,0};
+    } else if (covered && _operation == CLEAR){
+        node = {{0,0,0,0}, 0, 0,0};
+    } else if (_operation == RECOLOR && editNode.node.childBits == 0){
+        // nothing to recolor
+        return false;
+    } else if (covered && editNode.children == 0){
+        // recolor a solid node
+        node = {_color, editNode.node.childBits, 0,0};
+    } else{
+        // edit the children
+        std::vector<EditNode> children;
+        loadChildren(editNode, children);
+
+        bool childChanged = false;
+        for (unsigned int i = 0; i < 8;++i){
+            childChanged |= build(children[i], level + 1, code*8 + i);
+        }
+        if (!childChanged) return false;
+
+        std::vector<Node> childNodes;
+        bool allSolid = true;
+        for (unsigned int i = 0; i < 8;++i){
+            childNodes.push_back(children[i].node);
+            if (children[i].node.childBits != 255 || hasChildren(children[i]) ||
+                children[i].node.RGBA.R != children[0].node.RGBA.R || children[i].node.RGBA.G != children[0].node.RGBA.G ||
+                children[i].node.RGBA.B != children[0].node.RGBA.B || children[i].node.RGBA.A != children[0].node.RGBA.A){
+                allSolid = false;
+            }
+        }
+
+        node = {Node::mixColors(childNodes), 0, 0,0};
+        if (allSolid){
+            // all children equal, set node to a solid node
+            node.childBits = 255;
+        } else{
+            for (unsigned int i = 0; i < 8;++i){
+                if (children[i].node.childBits > 0) node.childBits |= 1 << i;
+            }
+            if (node.childBits > 0){
+                editNode.node = node;
+                editNode.childNodes = children;
+                editNode.childrenChanged = true;
+                editNode.inPlace = canStayInPlace(editNode);
+                return true;
+            }
+        }
+    }
+
+    // the node has no children after the edit
+    const bool sameNode = editNode.children == 0 && node.childBits == editNode.node.childBits &&
+        node.RGBA.R == editNode.node.RGBA.R && node.RGBA.G == editNode.node.RGBA.G &&
+        node.RGBA.B == editNode.node.RGBA.B && node.RGBA.A == editNode.node.RGBA.A;
+    if (sameNode) return false;
+
+    editNode.childrenChanged = editNode.children != 0;
+    editNode.node = node;
+    editNode.childNodes.clear();
+    return true;
+}
+
+SVOEditor::EditNode SVOEditor::loadNode(uint64_t nodePointer)
+{
+    EditNode editNode;
+    editNode.node = NodeRead::decode(readWord(nodePointer));
+    editNode.oldNode = editNode.node;
+
+    if (editNode.node.childOffset > 0){
+        editNode.children = nodePointer + editNode.node.childOffset;
+        if (editNode.node.referBit){
+            // follow the refer node
+            editNode.referPosition = editNode.children;
+            editNode.children += readWord(editNode.referPosition);
+        }
+    }
+    return editNode;
+}
+
+void SVOEditor::loadChildren(const EditNode& editNode, std::vector<EditNode>& children)
+{
+    children.clear();
+    unsigned int child = 0;
+    for (unsigned int i = 0; i < 8;++i){
+        const bool exists = editNode.node.childBits & (1 << i);
+        if (exists && editNode.children != 0){
+            children.push_back(loadNode(editNode.children + child));
+            child += 1;
+        } else{
+            // children of solid and empty nodes are not in the file
+            EditNode virtualNode;
+            virtualNode.node = {exists? editNode.node.RGBA : RGBA8{0,0,0,0}, (uint8_t)(exists? 255 : 0), 0,0};
+            virtualNode.oldNode = virtualNode.node;
+            children.push_back(virtualNode);
+        }
+    }
+}
+
+bool SVOEditor::hasChildren(const EditNode& editNode)
+{
+    if (editNode.childrenChanged) return !editNode.childNodes.empty();
+    return editNode.children != 0;
+}
+
+bool SVOEditor::needsSlot(const EditNode& editNode)
+{
+    // the children will be appended to the file, the distance can be too large for a direct offset
+    return editNode.childrenChanged && !editNode.childNodes.empty() && !editNode.inPlace;
+}
+
+bool SVOEditor::canStayInPlace(const EditNode& editNode)
+{
+    // the old children group can only be reused if it has the same children
+    if (editNode.children == 0 || editNode.oldNode.childBits != editNode.node.childBits) return false;
+
+    // every moved child needs a refer node near it, its old refer node or its old children group
+    for (unsigned int i = 0; i < editNode.childNodes.size();++i){
+        const EditNode& child = editNode.childNodes[i];
+        if (child.node.childBits > 0 && needsSlot(child) && child.referPosition == 0 && child.children == 0){
+            return false;
+        }
+    }
+    return true;
+}
+
+uint64_t SVOEditor::childTarget(EditNode& child)
+{
+    if (!child.childrenChanged) return child.children;
+    if (child.childNodes.empty()) return 0;
+    if (child.inPlace) return child.children;
+
+    // allocate the new children group at the end of the file
+    const uint64_t target = _totalNodes;
+    _totalNodes += totalChildren(child.node.childBits);
+    return target;
+}
+
+uint64_t SVOEditor::encodeChild(const EditNode& child, uint64_t nodePointer, uint64_t target, bool inPlace)
+{
+    Node node = child.node;
+    node.childOffset = 0;
+    node.referBit = false;
+
+    if (inPlace && target != 0 && target == child.children){
+        // children did not move, keep the old offset
+        node.childOffset = child.oldNode.childOffset;
+        node.referBit = child.oldNode.referBit;
+    } else if (target > nodePointer && target - nodePointer < ((uint64_t)1 << TOTAL_CHILDOFFSET_BITS)){
+        node.childOffset = target - nodePointer;
+    } else if (target != 0){
+        // offset does not fit, use a refer node
+        uint64_t referPointer;
+        if (inPlace && child.referPosition != 0){
+            referPointer = child.referPosition;
+        } else if (inPlace && child.children != 0 && child.children != target){
+            // the old children group is no longer used
+            referPointer = child.children;
+        } else if (!inPlace){
+            referPointer = _totalNodes;
+            _totalNodes += 1;
+        } else{
+            std::cout << "Error editing SVO, no position found for a refer node\n";
+            throw;
+        }
+        writeWord(referPointer, target - referPointer);
+        node.referBit = true;
+        node.childOffset = referPointer - nodePointer;
+    }
+
+    return NodeRead::encode(node);
+}
+
+void SVOEditor::writeChildren(EditNode& editNode, uint64_t groupPointer)
+{
+    const bool inPlace = editNode.inPlace;
+
+    // allocate the new children groups first, so they are close to this group
+    std::vector<uint64_t> targets(8, 0);
+    for (unsigned int i = 0; i < 8;++i){
+        if (editNode.childNodes[i].node.childBits > 0){
+            targets[i] = childTarget(editNode.childNodes[i]);
+        }
+    }
+
+    // write the children group
+    uint64_t nodePointer = groupPointer;
+    for (unsigned int i = 0; i < 8;++i){
+        if (editNode.childNodes[i].node.childBits > 0){
+            writeWord(nodePointer, encodeChild(editNode.childNodes[i], nodePointer, targets[i], inPlace));
+            nodePointer += 1;
+        }
+    }
+
+    // write the changed groups of the children
+    for (unsigned int i = 0; i < 8;++i){
+        EditNode& child = editNode.childNodes[i];
+        if (child.node.childBits > 0 && child.childrenChanged && !child.childNodes.empty()){
+            writeChildren(child, targets[i]);
+        }
+    }
+}
+
+uint8_t SVOEditor::totalChildren(uint8_t childBits)
+{
+    uint8_t total = 0;
+    for (unsigned int i = 0; i < 8;++i){
+        if (childBits & (1 << i)) total += 1;
+    }
+    return total;
+}
+
+uint64_t SVOEditor::readWord(uint64_t nodePointer)
+{
+    return NodeRead::readWord(_file, nodePointer);
+}
+
+void SVOEditor::writeWord(uint64_t nodePointer, uint64_t word)
+{
+    uint8_t bytes[8] = {0,0,0,0,0,0,0,0};
+
+    // fill the file up to the node
+    _file.seekp(_fileNodes*8, std::ios::beg);
+    while (_fileNodes < nodePointer){
+        _file.write((const char*)bytes, 8);
+        _fileNodes += 1;
+    }
+
+    NodeRead::toBytes(word, bytes);
+    _file.seekp(nodePointer*8, std::ios::beg);
+    _file.write((const char*)bytes, 8);
+    if (nodePointer >= _fileNodes) _fileNodes = nodePointer + 1;
+}
@@ -0,0 +1,66 @@
+#ifndef SVOEDITOR_H
+#define SVOEDITOR_H
+
+#include <fstream>
+#include <vector>
+#include "structs.h"
+
+// Edits voxels of an SVO file in the 64 bit node format without rebuilding it.
+// Only the paths to the edited voxels are rebuilt. Children groups that keep their shape are
+// rewritten in place, other groups are appended to the end of the file and linked with a direct
+// offset or with a refer node. Refer nodes can point backwards, the offset is added modulo 2^64.
+class SVOEditor
+{
+public:
+    SVOEditor(const char* svoFile, unsigned int depth);
+    ~SVOEditor();
+
+    void setVoxels(uint64_t mortonBegin, uint64_t mortonEnd, RGBA8 color);
+    void clearVoxels(uint64_t mortonBegin, uint64_t mortonEnd);
+    void recolorVoxels(uint64_t mortonBegin, uint64_t mortonEnd, RGBA8 color);
+
+private:
+    enum Operation{
+        SET,
+        CLEAR,
+        RECOLOR
+    };
+
+    struct EditNode{
+        Node node;
+        Node oldNode{{0,0,0,0}, 0, 0,0};    // node as found in the file
+        uint64_t children = 0;              // position of the children in the file, 0 if none
+        uint64_t referPosition = 0;         // refer node used by the node, 0 if none
+        bool childrenChanged = false;       // the children of the node changed
+        bool inPlace = false;               // the children can be written on their old position
+        std::vector<EditNode> childNodes;   // the 8 children if the children changed
+    };
+
+    void edit(uint64_t mortonBegin, uint64_t mortonEnd, Operation operation, RGBA8 color);
+    bool build(EditNode& editNode, unsigned int level, uint64_t code);
+    void loadChildren(const EditNode& editNode, std::vector<EditNode>& children);
+    EditNode loadNode(uint64_t nodePointer);
+    bool canStayInPlace(const EditNode& editNode);
+    bool needsSlot(const EditNode& editNode);
+
+    void writeChildren(EditNode& editNode, uint64_t groupPointer);
+    uint64_t childTarget(EditNode& child);
+    uint64_t encodeChild(const EditNode& child, uint64_t nodePointer, uint64_t target, bool inPlace);
+    static bool hasChildren(const EditNode& editNode);
+    void writeWord(uint64_t nodePointer, uint64_t word);
+    uint64_t readWord(uint64_t nodePointer);
+
+    static uint8_t totalChildren(uint8_t childBits);
+
+    std::fstream _file;
+    unsigned int _depth;
+    uint64_t _totalNodes;       // nodes in the file including the allocated nodes
+    uint64_t _fileNodes;        // nodes written to the file
+
+    uint64_t _mortonBegin;
+    uint64_t _mortonEnd;
+    Operation _operation;
+    RGBA8 _color;
+};
+
+#endif
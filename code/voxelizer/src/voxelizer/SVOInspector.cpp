@@ -0,0 +1,201 @@
+#include "SVOInspector.h"
+#include "MappedFile.h"
+#include "NodeTree.h"
+#include "FarPointers.h"
+
+#include <iostream>
+#include <iomanip>
+#include <chrono>
+#include <unordered_set>
+#include <algorithm>
+#include <numeric>
+#include <string>
+
+#define MAX_COLORS (1 << 20)    // distinct colors counted, a set of about 40 MB
+
+unsigned int SVOInspector::bitWidth(uint64_t value)
+{
+    unsigned int bits = 0;
+    while (value > 0){
+        bits += 1;
+        value >>= 1;
+    }
+    return bits;
+}
+
+void SVOInspector::inspect(const char* svoFile, unsigned int pageSize, unsigned int bricksDepth)
+{
+    typedef std::chrono::steady_clock Clock;
+    const Clock::time_point begin = Clock::now();
+
+    MappedFile file(svoFile);
+    if (!file.isOpen() || file.size() < 8){
+        std::cout << "Failed to open " << svoFile << "\n";
+        return;
+    }
+    const uint64_t totalWords = file.size()/8;
+    const uint64_t totalPages = (totalWords + pageSize - 1)/pageSize;
+    // with a far pointer table next to the file the refer bit is an index in the table
+    const NodeTree tree(file.data(), totalWords, FarPointers::readTable((std::string(svoFile) + ".far").c_str()), bricksDepth);
+    const bool far = !tree.farTable().empty();
+
+    std::vector<Level> levels;
+    uint64_t offsetWidths[65] = {0};
+    uint64_t referWidths[65] = {0};
+    std::unordered_set<uint32_t> colors;
+    uint32_t lastColor = 0;
+    const auto addColor = [&colors, &lastColor](uint32_t color){
+        // neighbouring nodes often have the same color
+        if (color == lastColor && !colors.empty()) return;
+        lastColor = color;
+        if (colors.size() < MAX_COLORS) colors.insert(color);
+    };
+    std::vector<bool> isNode(totalWords, false);
+    uint64_t totalNodes = 0;
+    uint64_t brickWords = 0;
+    uint64_t brickVoxels = 0;
+    uint64_t outside = 0;       // child pointers behind the end of the file
+
+    const auto addSpan = [&levels, pageSize](unsigned int level, uint64_t pointer, uint64_t lastPointer){
+        const uint64_t pages = lastPointer/pageSize - pointer/pageSize + 1;
+        levels[level].spannedPages += pages;
+        levels[level].maxSpannedPages = std::max(levels[level].maxSpannedPages, pages);
+    };
+
+    // the value of a node is the last word of its subtree, a node with children to walk starts with itself
+    const auto visit = [&](uint64_t pointer, unsigned int level, uint64_t& lastPointer) -> uint64_t{
+        if (pointer >= totalWords){
+            outside += 1;
+            return NodeTree::NO_POINTER;
+        }
+        if (levels.size() <= level) levels.resize(level + 1);
+        Level& stats = levels[level];
+        const Node node = tree.node(pointer);
+        isNode[pointer] = true;
+        totalNodes += 1;
+        stats.nodes += 1;
+        lastPointer = pointer;
+
+        if (node.childBits == 0){
+            stats.empty += 1;
+            addSpan(level, pointer, pointer);
+            return NodeTree::NO_POINTER;
+        }
+        addColor((node.RGBA.R << 24) | (node.RGBA.G << 16) | (node.RGBA.B << 8) | node.RGBA.A);
+        if (node.childOffset == 0){
+            if (node.childBits == 255){
+                stats.solid += 1;
+            } else{
+                stats.leaves += 1;
+            }
+            addSpan(level, pointer, pointer);
+            return NodeTree::NO_POINTER;
+        }
+
+        stats.branching += 1;
+        uint64_t referWord;
+        const uint64_t children = tree.children(pointer, node, &referWord);
+        if (node.referBit && far){
+            stats.refer += 1;
+            referWidths[bitWidth(children - pointer)] += 1;
+        } else{
+            offsetWidths[bitWidth(node.childOffset)] += 1;
+            if (referWord != NodeTree::NO_POINTER){
+                stats.refer += 1;
+                referWidths[bitWidth(tree.word(referWord))] += 1;
+            }
+        }
+        if (children >= totalWords){
+            outside += 1;
+            addSpan(level, pointer, pointer);
+            return NodeTree::NO_POINTER;
+        }
+
+        if (level == tree.brickLevel()){
+            stats.bricks += 1;
+            const unsigned int voxels = tree.brickVoxels(children);
+            const uint64_t words = tree.brickWords(children);
+            brickVoxels += voxels;
+            brickWords += words;
+            for (uint64_t w = children + 1; w < children + words;++w){
+                const uint64_t word = tree.word(w);
+                addColor(word >> 32);
+                if (2*(w - children) <= voxels) addColor(word & 0xFFFFFFFF);
+            }
+            lastPointer = children + words - 1;
+            addSpan(level, pointer, lastPointer);
+            return NodeTree::NO_POINTER;
+        }
+        return children;
+    };
+    tree.walk<uint64_t>(visit, [](NodeTree::Frame<uint64_t>& parent, uint64_t, uint64_t lastPointer){
+        parent.value = std::max(parent.value, lastPointer);
+    }, [&addSpan](const NodeTree::Frame<uint64_t>& done){
+        addSpan(done.level, done.pointer, done.value);
+    });
+
+    // fan-out: the other pages a page needs for the children of its nodes, in file order
+    std::vector<uint64_t> fanOut(MAX_FAN_OUT + 1, 0);
+    uint64_t totalFanOut = 0;
+    uint64_t maxFanOut = 0;
+    std::vector<uint64_t> pages;
+    for (uint64_t page = 0; page < totalPages;++page){
+        pages.clear();
+        const uint64_t end = std::min((page + 1)*pageSize, totalWords);
+        for (uint64_t pointer = page*pageSize; pointer < end;++pointer){
+            if (!isNode[pointer]) continue;
+            const Node node = tree.node(pointer);
+            if (node.childBits == 0 || node.childOffset == 0) continue;
+
+            uint64_t referWord;
+            const uint64_t children = tree.children(pointer, node, &referWord);
+            if (referWord != NodeTree::NO_POINTER) pages.push_back(referWord/pageSize);
+            if (children >= totalWords) continue;
+            // the children are nodes or a brick
+            const uint64_t last = isNode[children]? std::min(children + __builtin_popcount(node.childBits) - 1, totalWords - 1) :
+                                                    children + tree.brickWords(children) - 1;
+            pages.push_back(children/pageSize);
+            if (last/pageSize != children/pageSize) pages.push_back(last/pageSize);
+        }
+        std::sort(pages.begin(), pages.end());
+        pages.erase(std::unique(pages.begin(), pages.end()), pages.end());
+        const uint64_t otherPages = pages.size() - std::count(pages.begin(), pages.end(), page);
+        fanOut[std::min(otherPages, (uint64_t)MAX_FAN_OUT)] += 1;
+        totalFanOut += otherPages;
+        maxFanOut = std::max(maxFanOut, otherPages);
+    }
+
+    const uint64_t referNodes = std::accumulate(levels.begin(), levels.end(), (uint64_t)0, [](uint64_t sum, const Level& level){ return sum + level.refer; });
+    std::cout << svoFile << ": " << file.size() << " bytes, " << totalWords << " words, " << totalPages << " pages of " << pageSize << " nodes\n";
+    const uint64_t referWords = far? 0 : referNodes;
+    std::cout << " nodes: " << totalNodes << ", refer words: " << referWords << ", brick words: " << brickWords << ", unreachable words: " <<
+                 totalWords - totalNodes - referWords - brickWords << "\n";
+    if (far) std::cout << " far pointers: " << referNodes << ", far pointer table: " << tree.farTable().size() << " entries\n";
+    if (bricksDepth > 0) std::cout << " bricks of depth " << bricksDepth << ": " << brickVoxels << " voxels\n";
+    if (outside > 0) std::cout << " " << outside << " child pointers behind the end of the file\n";
+    std::cout << " distinct colors: " << (colors.size() < MAX_COLORS? "" : "at least ") << colors.size() << "\n";
+
+    std::cout << std::fixed << std::setprecision(2);
+    std::cout << "\n" << std::setw(6) << "level" << std::setw(12) << "nodes" << std::setw(12) << "empty" << std::setw(12) << "solid" <<
+                 std::setw(12) << "leaves" << std::setw(12) << "branching" << std::setw(10) << "refer" << std::setw(12) << "bricks" <<
+                 std::setw(14) << "pages/subtree" << std::setw(10) << "max" << "\n";
+    for (unsigned int l = 0; l < levels.size();++l){
+        const Level& level = levels[l];
+        std::cout << std::setw(6) << l << std::setw(12) << level.nodes << std::setw(12) << level.empty << std::setw(12) << level.solid <<
+                     std::setw(12) << level.leaves << std::setw(12) << level.branching << std::setw(10) << level.refer << std::setw(12) << level.bricks <<
+                     std::setw(14) << (level.nodes > 0? (double)level.spannedPages/level.nodes : 0.0) << std::setw(10) << level.maxSpannedPages << "\n";
+    }
+
+    std::cout << "\nChild offset bits (" << (far? "far" : "refer") << " offset bits):\n";
+    for (unsigned int b = 0; b < 65;++b){
+        if (offsetWidths[b] == 0 && referWidths[b] == 0) continue;
+        std::cout << std::setw(4) << b << ": " << offsetWidths[b] << " (" << referWidths[b] << ")\n";
+    }
+
+    std::cout << "\nPage fan-out, other pages with children of a page: average " << (totalPages > 0? (double)totalFanOut/totalPages : 0.0) <<
+                 ", max " << maxFanOut << "\n";
+    for (unsigned int f = 0; f <= MAX_FAN_OUT;++f){
+        std::cout << std::setw(4) << f << (f == MAX_FAN_OUT? "+: " : ": ") << fanOut[f] << " pages\n";
+    }
+    std::cout << std::defaultfloat << "\nInspected in " << std::chrono::duration<double>(Clock::now() - begin).count() << " s\n";
+}
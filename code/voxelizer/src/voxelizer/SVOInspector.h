@@ -0,0 +1,38 @@
+#ifndef SVOINSPECTOR_H
+#define SVOINSPECTOR_H
+
+#include <vector>
+#include <cstdint>
+
+// Statistics of an SVO file in the 64 bit node format, to find layout and size problems before a
+// model is deployed. The file is memory mapped and the tree is walked once depth first, only the
+// open nodes of the walk, one bit per word and the set of distinct colors are kept in memory, so
+// files of several GB take seconds. The color set stops at 1M colors (about 40 MB). Per level:
+// nodes, empty, solid (childBits 255 without children), other leaves, branching and refer nodes
+// and the pages spanned by the subtrees of the level. For the whole file: the bit widths of the
+// child offsets, the distinct colors and the fan-out of every page, the other pages its nodes
+// have children in. With a far pointer table <svofile>.far next to the file, the refer bits are
+// far pointers.
+class SVOInspector
+{
+public:
+    // with bricks the depth tells the level of the brick pointers, 0 is a file without bricks
+    static void inspect(const char* svoFile, unsigned int pageSize, unsigned int bricksDepth = 0);
+
+private:
+    struct Level{
+        uint64_t nodes = 0;
+        uint64_t empty = 0;
+        uint64_t solid = 0;
+        uint64_t leaves = 0;
+        uint64_t branching = 0;
+        uint64_t refer = 0;
+        uint64_t bricks = 0;
+        uint64_t spannedPages = 0;      // sum over the subtrees of the level
+        uint64_t maxSpannedPages = 0;
+    };
+
+    static unsigned int bitWidth(uint64_t value);
+};
+
+#endif
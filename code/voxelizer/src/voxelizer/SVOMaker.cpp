@@ -1,50 +1,63 @@
 #include "SVOMaker.h"
 
 #include "SVOSaver.h"
-#include "../opengl/texture.h"
+#include "../opengl/texturearray.h"
 #include "voxelizer.h"
 #include "ofcSVO.h"
 #include <iostream>
 #include "NodeWrite.h"
+#include "AsyncWriter.h"
+#include "Profiler.h"
+#include <thread>
 
 const unsigned int MAX_VOXEL_IMAGE_SIZE = 1024;
+const unsigned int MIN_VOXEL_IMAGE_SIZE = 4;    // at least 1 brick
 
-SVOMaker::SVOMaker(unsigned int resolution, bool fill)
+// worst case memory per voxel of the voxel image: the image, the voxel list of the voxelize stage
+// (twice while it grows), a voxelized brick in the queue, the sort stage, a sorted brick in the queue
+// and the build stage, the normal image is added when filling
+const uint64_t IMAGE_VOXEL_BYTES = sizeof(RGBA8) + 4*sizeof(Voxel) + 3*sizeof(OfcSVO::MortonVoxel);
+const uint64_t NORMAL_VOXEL_BYTES = 4*sizeof(float);
+
+SVOMaker::SVOMaker(unsigned int resolution, bool fill, bool bricks, uint64_t maxMemory)
+    : _bricks{bricks}
 {
-    unsigned int voxelImageSize = resolution;
-    if (voxelImageSize > MAX_VOXEL_IMAGE_SIZE) voxelImageSize = MAX_VOXEL_IMAGE_SIZE;
+    _voxelImageSize = resolution;
+    if (_voxelImageSize > MAX_VOXEL_IMAGE_SIZE) _voxelImageSize = MAX_VOXEL_IMAGE_SIZE;
+
+    if (maxMemory > 0){
+        // the model is voxelized in bricks of the voxel image size, shrink the image until it fits
+        const uint64_t voxelBytes = IMAGE_VOXEL_BYTES + (fill? NORMAL_VOXEL_BYTES : 0);
+        while (_voxelImageSize > MIN_VOXEL_IMAGE_SIZE && (uint64_t)_voxelImageSize*_voxelImageSize*_voxelImageSize*voxelBytes > maxMemory){
+            _voxelImageSize /= 2;
+        }
+        std::cout << "Voxel image size " << _voxelImageSize << " for max memory of " << maxMemory/(1024*1024) << " MB\n";
+    }
 
     // create voxelizer
     std::cout << "Creating voxelizer...\n";
-    voxelizer = new Voxelizer(voxelImageSize, voxelImageSize, voxelImageSize, fill);
+    voxelizer = new Voxelizer(_voxelImageSize, _voxelImageSize, _voxelImageSize, fill);
     std::cout << "Voxelizer created\n";
 }
 SVOMaker::~SVOMaker()
 {
     delete voxelizer;
-    deleteTextures();
+    delete _textures;
 }
 
-void SVOMaker::deleteTextures()
+TextureArray* SVOMaker::getTextures(const ModelLoader::Result& model)
 {
-    for (auto it = textures.begin(); it != textures.end(); ++it)
-    {
-        delete it->second;
-    }
-}
-
-Texture* SVOMaker::getTexture(const char* path)
-{
-    if (path == nullptr) return nullptr;
-    if (textures.count(path) > 0) return textures[path];
+    if (_textures && _texturesStore == model.store->generation) return _textures;
 
-    textures[path] = new Texture(path);
-    return textures[path];
+    delete _textures;
+    _textures = new TextureArray(*model.store);
+    _texturesStore = model.store->generation;
+    return _textures;
 }
 
-SVO SVOMaker::modelToSvo(glm::vec3 offset, glm::vec3 size, ModelLoader::Model model, unsigned int depth)
+SVO SVOMaker::modelToSvo(glm::vec3 offset, glm::vec3 size, const ModelLoader::Result& model, unsigned int depth)
 {
-    if ((1 << depth) > MAX_VOXEL_IMAGE_SIZE){
+    if ((1 << depth) > _voxelImageSize){
         std::vector<SVO> children;
         size = size * glm::vec3(2,2,2);
         offset = offset * glm::vec3(2,2,2);
@@ -62,8 +75,9 @@ SVO SVOMaker::modelToSvo(glm::vec3 offset, glm::vec3 size, ModelLoader::Model mo
     glm::mat4 modelMatrix{1.0f};
     modelMatrix = glm::translate(modelMatrix, offset);
     modelMatrix = glm::scale(modelMatrix, size);
-    Texture* tex = getTexture(model.textureFile == ""? nullptr : model.textureFile.c_str());
-    std::vector<Voxel> voxels = voxelizer->voxelize(modelMatrix, model.vertices, tex);
+    TextureArray* textures = getTextures(model);
+    std::vector<Voxel> voxels = voxelizer->voxelize(modelMatrix, model.mesh, textures);
+    MemoryTracker::Block voxelMemory(MemoryTracker::VOXELIZER, MemoryTracker::bytes(voxels));
     std::cout << "Mesh voxelized\n";
 
     std::cout << "Total voxels: " << voxels.size() << "\n";
@@ -76,9 +90,9 @@ SVO SVOMaker::modelToSvo(glm::vec3 offset, glm::vec3 size, ModelLoader::Model mo
     return svo;
 }
 
-void SVOMaker::voxelizeFile(std::ofstream &voxOut, glm::vec3 offset, glm::vec3 size, ModelLoader::Model model, unsigned int depth)
+void SVOMaker::voxelizeFile(std::ofstream &voxOut, glm::vec3 offset, glm::vec3 size, const ModelLoader::Result& model, unsigned int depth)
 {
-    if ((1 << depth) > MAX_VOXEL_IMAGE_SIZE){
+    if ((1 << depth) > _voxelImageSize){
         // depth to large for 1 renders, split it in 8
         size = size * glm::vec3(2,2,2);
         offset = offset * glm::vec3(2,2,2);
@@ -93,82 +107,106 @@ void SVOMaker::voxelizeFile(std::ofstream &voxOut, glm::vec3 offset, glm::vec3 s
     glm::mat4 modelMatrix{1.0f};
     modelMatrix = glm::translate(modelMatrix, offset);
     modelMatrix = glm::scale(modelMatrix, size);
-    Texture* tex = getTexture(model.textureFile == ""? nullptr : model.textureFile.c_str());
-    voxelizer->voxelizeSave(voxOut,modelMatrix, model.vertices, tex);
+    TextureArray* textures = getTextures(model);
+    voxelizer->voxelizeSave(voxOut,modelMatrix, model.mesh, textures);
 }
 
-std::vector<Voxel> SVOMaker::voxelize(glm::vec3 offset, glm::vec3 size, ModelLoader::Model model, unsigned int depth)
+void SVOMaker::create(std::ostream &out, glm::vec3 offset, glm::vec3 size, const ModelLoader::Result& model, unsigned int depth)
 {
-    if ((1 << depth) > MAX_VOXEL_IMAGE_SIZE){
-        std::vector<Voxel> voxels;
+    // the stages run at the same time, a queue holds 1 brick so a stage waits for a slower next stage
+    std::cout << "Constructing SVO\n";
+    SPSCQueue<Chunk> voxelized(1);
+    SPSCQueue<Chunk> sorted(1);
+
+    // sort stage
+    std::thread sorter([&voxelized, &sorted](){
+        Chunk chunk;
+        while (voxelized.pop(chunk)){
+            Profiler::Scope scope("sort");
+            chunk.sortMemory.resize(chunk.voxels.size()*sizeof(OfcSVO::MortonVoxel));
+            chunk.mortonOrderedVoxels = OfcSVO::reorderVoxels(chunk.voxels);
+            chunk.voxels = std::vector<Voxel>();
+            chunk.voxelMemory.resize(0);
+
+            // move the voxels to the morton range of the brick
+            const uint64_t brickCode = chunk.mortonBase << (3*chunk.depth);
+            for (uint64_t i = 0; i < chunk.mortonOrderedVoxels.size();++i){
+                chunk.mortonOrderedVoxels[i].mortonCode += brickCode;
+            }
+            sorted.push(std::move(chunk));
+        }
+        sorted.close();
+    });
+
+    // build stage, the nodes go to the writer thread of the output
+    std::thread builder([this, &sorted, &out, depth](){
+        OfcSVO svoBuilder(out, depth, _bricks);
+        Chunk chunk;
+        while (sorted.pop(chunk)){
+            Profiler::Scope scope("build");
+            svoBuilder.addVoxels(chunk.mortonOrderedVoxels, (chunk.mortonBase + 1) << (3*chunk.depth));
+        }
+        Profiler::Scope scope("build");
+        svoBuilder.finish();
+    });
 
-        // double size and offset for child renders
+    // voxelize stage, on this thread because it has the OpenGL context
+    addChunks(voxelized, offset, size, model, depth, 0);
+    voxelized.close();
+
+    sorter.join();
+    builder.join();
+    std::cout << "SVO constructed\n";
+}
+
+void SVOMaker::addChunks(SPSCQueue<Chunk> &voxelized, glm::vec3 offset, glm::vec3 size, const ModelLoader::Result& model, unsigned int depth, uint64_t mortonBase)
+{
+    // over the memory budget no more bricks are voxelized, the stages finish the queued bricks
+    if (MemoryTracker::exceeded()) return;
+    if ((1 << depth) > _voxelImageSize){
+        // double size and offset for child renders, the children are in morton order
         size = size * glm::vec3(2,2,2);
         offset = offset * glm::vec3(2,2,2);
         const float d = -1;
 
-        unsigned int halfSize = 1 << (depth - 1);
         for (unsigned int i = 0; i < 8;++i){
             glm::vec3 coffset = offset + glm::vec3(((i&1) > 0)*d,((i&2) > 0)*d,((i&4) > 0)*d);
-            std::vector<Voxel> childVoxels = voxelize(coffset, size, model, depth-1);
-
-            if (i > 0){
-                for (unsigned int j = 0; j < childVoxels.size();++j){
-                    childVoxels[j].XYZ[0] += ((i&1) > 0)*halfSize;
-                    childVoxels[j].XYZ[1] += ((i&2) > 0)*halfSize;
-                    childVoxels[j].XYZ[2] += ((i&4) > 0)*halfSize;
-                }
-            }
-            voxels.insert(voxels.end(), childVoxels.begin(), childVoxels.end());
+            addChunks(voxelized, coffset, size, model, depth-1, mortonBase*8 + i);
         }
-        return voxels;
-    } else {
-        glm::mat4 modelMatrix{1.0f};
-        modelMatrix = glm::translate(modelMatrix, offset);
-        modelMatrix = glm::scale(modelMatrix, size);
-        Texture* tex = getTexture(model.textureFile == ""? nullptr : model.textureFile.c_str());
-        return voxelizer->voxelize(modelMatrix, model.vertices, tex);
+        return;
     }
-}
-
-void SVOMaker::create(std::ofstream &out, glm::vec3 offset, glm::vec3 size, ModelLoader::Model model, unsigned int depth)
-{
 
     // voxelize mesh
     std::cout << "Voxelizing mesh...\n";
-    std::vector<Voxel> voxels = voxelize(offset, size, model, depth);
-    std::cout << "Mesh voxelized\n";
-    std::cout << "Total voxels: " << voxels.size() << "\n";
+    glm::mat4 modelMatrix{1.0f};
+    modelMatrix = glm::translate(modelMatrix, offset);
+    modelMatrix = glm::scale(modelMatrix, size);
+    TextureArray* textures = getTextures(model);
 
-    std::cout << "Constructing SVO\n";
-    OfcSVO::create(out, voxels, depth, false);
-    std::cout << "SVO constructed\n";
+    Chunk chunk{voxelizer->voxelize(modelMatrix, model.mesh, textures), {}, mortonBase, depth};
+    chunk.voxelMemory.resize(MemoryTracker::bytes(chunk.voxels));
+    std::cout << "Total voxels: " << chunk.voxels.size() << "\n";
+    voxelized.push(std::move(chunk));
 }
 
-void SVOMaker::modelToSvoFile(std::ofstream &out, glm::vec3 offset, glm::vec3 size, ModelLoader::Model model, unsigned int depth)
+bool SVOMaker::modelToSvoFile(std::ofstream &out, glm::vec3 offset, glm::vec3 size, const ModelLoader::Result& model, unsigned int depth)
 {
-    // open temp output file
-    std::ofstream SVObackwardsOut("tmp/tmp_SVO_backwards", std::ios_base::binary | std::ios::out);
-
-    create(SVObackwardsOut, offset, size, model, depth);
+    // open temp output file, it is written on its own thread
+    {
+        AsyncWriter writer("tmp/tmp_SVO_backwards");
+        std::ostream SVObackwardsOut(&writer);
 
-    SVObackwardsOut.close();
+        create(SVObackwardsOut, offset, size, model, depth);
+        if (!writer.close()){
+            std::cout << "Failed to write tmp/tmp_SVO_backwards\n";
+            return false;
+        }
+    }
+    if (MemoryTracker::exceeded()) return false;
 
     // reverse file order
     std::ifstream SVObackwardsIn("tmp/tmp_SVO_backwards",std::ios::binary | std::ios::ate | std::ios::in);
-    reverseNodeFile(out, SVObackwardsIn);
+    OfcSVO::reverseNodeFile(out, SVObackwardsIn);
     SVObackwardsIn.close();
+    return (bool)out;
 }
-
-void SVOMaker::reverseNodeFile(std::ofstream &out, std::ifstream &in)
-{
-    std::streampos totalNodes = in.tellg()/8;
-    for(int i = 1; i <= totalNodes; ++i){
-        in.seekg(-i*8,std::ios::end);
-        unsigned long long node;
-        in.read((char*)&node, 8);
-        out.write((char*)&node, 8);
-    }
-
-    std::cout << "Total nodes: " << totalNodes << "\n";
-}
\ No newline at end of file
@@ -5,31 +5,47 @@
 #include "../opengl/modelloader.h"
 #include <glm/gtc/matrix_transform.hpp>
 #include <map>
+#include <ostream>
+#include "SPSCQueue.h"
+#include "ofcSVO.h"
+#include "MemoryTracker.h"
 
 class Voxelizer;
-class Texture;
+class TextureArray;
 
 class SVOMaker
 {
 public:
-    SVOMaker(unsigned int resolution, bool fill);
+    // maxMemory limits the memory used by the voxel image in bytes, 0 is no limit
+    SVOMaker(unsigned int resolution, bool fill, bool bricks = false, uint64_t maxMemory = 0);
     ~SVOMaker();
 
-    SVO modelToSvo(glm::vec3 offset, glm::vec3 size, ModelLoader::Model model, unsigned int depth);
-    void modelToSvoFile(std::ofstream &out, glm::vec3 offset, glm::vec3 size, ModelLoader::Model model, unsigned int depth);
+    SVO modelToSvo(glm::vec3 offset, glm::vec3 size, const ModelLoader::Result& model, unsigned int depth);
+    // false if a file couldn't be written
+    bool modelToSvoFile(std::ofstream &out, glm::vec3 offset, glm::vec3 size, const ModelLoader::Result& model, unsigned int depth);
 private:
-    void create(std::ofstream &out, glm::vec3 offset, glm::vec3 size, ModelLoader::Model model, unsigned int depth);
-    void voxelizeFile(std::ofstream &voxOut, glm::vec3 offset, glm::vec3 size, ModelLoader::Model model, unsigned int depth);
-    static void reverseNodeFile(std::ofstream &out, std::ifstream &in);
-
-    Texture* getTexture(const char* path);
-
-    void deleteTextures();
-
-    std::vector<Voxel> voxelize(glm::vec3 offset, glm::vec3 size, ModelLoader::Model model, unsigned int depth);
-
-    std::map<std::string, Texture*> textures;
+    // a voxelized brick of the model, from the voxelize stage to the sort stage to the build stage
+    struct Chunk{
+        std::vector<Voxel> voxels;
+        std::vector<OfcSVO::MortonVoxel> mortonOrderedVoxels;
+        uint64_t mortonBase;
+        unsigned int depth;
+        MemoryTracker::Block voxelMemory{MemoryTracker::VOXELIZER};
+        MemoryTracker::Block sortMemory{MemoryTracker::SORT};
+    };
+
+    void create(std::ostream &out, glm::vec3 offset, glm::vec3 size, const ModelLoader::Result& model, unsigned int depth);
+    void addChunks(SPSCQueue<Chunk> &voxelized, glm::vec3 offset, glm::vec3 size, const ModelLoader::Result& model, unsigned int depth, uint64_t mortonBase);
+    void voxelizeFile(std::ofstream &voxOut, glm::vec3 offset, glm::vec3 size, const ModelLoader::Result& model, unsigned int depth);
+
+    // the textures of all materials of the model
+    TextureArray* getTextures(const ModelLoader::Result& model);
+
+    TextureArray* _textures = nullptr;
+    uint64_t _texturesStore = 0;        // generation of the store of the textures
     Voxelizer* voxelizer;
+    bool _bricks;
+    unsigned int _voxelImageSize;
 };
 
 #endif
\ No newline at end of file
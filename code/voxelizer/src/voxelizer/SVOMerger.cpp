@@ -0,0 +1,176 @@
+#include "SVOMerger.h"
+#include "NodeRead.h"
+#include "Profiler.h"
+#include "ofcSVO.h"
+
+#include <iostream>
+
+#define COPY_BUFFER_NODES (1 << 19)
+
+void SVOMerger::mergeFiles(const char* outputFile, const char* octantFiles[8])
+{
+    std::cout << "Merging octant files in " << outputFile << "...\n";
+
+    std::ifstream octantStreams[8];
+    std::istream* octants[8];
+    for (unsigned int i = 0; i < 8;++i){
+        octantStreams[i].open(octantFiles[i], std::ios::binary | std::ios::ate);
+        octants[i] = octantStreams[i].is_open()? &octantStreams[i] : nullptr;
+        if (!octants[i]){
+            std::cout << " Octant file " << octantFiles[i] << " not found, octant is empty\n";
+        }
+    }
+
+    std::ofstream out(outputFile, std::ios::binary | std::ios::out);
+    if (!out.is_open()){
+        std::cout << "Failed to create output file\n";
+        return;
+    }
+    merge(out, octants);
+
+    std::cout << "Octant files merged, total nodes: " << out.tellp()/8 << "\n";
+}
+
+std::string SVOMerger::octantFile(const char* file, unsigned int octant)
+{
+    // put the octant number in front of the file name, not in front of the directory
+    std::string path(file);
+    const size_t nameStart = path.find_last_of("/\\") + 1;
+    return path.substr(0, nameStart) + std::to_string(octant) + path.substr(nameStart);
+}
+
+SVOMerger::Octant SVOMerger::readOctant(std::istream &in)
+{
+    Octant octant;
+
+    in.seekg(0, std::ios::end);
+    octant.totalNodes = in.tellg()/8;
+    if (octant.totalNodes <= 0) return octant;
+
+    octant.root = NodeRead::decode(NodeRead::readWord(in, 0));
+    if (octant.root.childOffset > 0){
+        octant.children = octant.root.childOffset;
+        if (octant.root.referBit){
+            octant.referPosition = octant.children;
+            octant.children += NodeRead::readWord(in, octant.referPosition);
+        }
+    }
+    return octant;
+}
+
+void SVOMerger::merge(std::ostream &out, std::istream* octants[8])
+{
+    Profiler::Scope scope("merge");
+
+    // read the roots of the octants
+    Octant octant[8];
+    std::vector<Node> roots;
+    for (unsigned int i = 0; i < 8;++i){
+        if (octants[i]) octant[i] = readOctant(*octants[i]);
+        roots.push_back(octant[i].root);
+    }
+
+    // create the new root
+    Node root{Node::mixColors(roots), 0, 0,0};
+    bool allSolid = true;
+    for (unsigned int i = 0; i < 8;++i){
+        if (roots[i].childBits > 0) root.childBits |= 1 << i;
+        if (roots[i].childBits != 255 || roots[i].childOffset > 0 ||
+            roots[i].RGBA.R != roots[0].RGBA.R || roots[i].RGBA.G != roots[0].RGBA.G ||
+            roots[i].RGBA.B != roots[0].RGBA.B || roots[i].RGBA.A != roots[0].RGBA.A){
+            allSolid = false;
+        }
+    }
+    if (allSolid) root.childBits = 255;
+    if (allSolid || root.childBits == 0){
+        // root has no children in the file
+        writeWord(out, NodeRead::encode(root));
+        return;
+    }
+    root.childOffset = 1;
+
+    // find the position of every octant, add refer nodes until all children can reach their octant
+    std::vector<uint64_t> slots(8, 0);
+    std::vector<uint64_t> targets(8, 0);
+    std::vector<bool> refers(8, false);
+    unsigned int totalChildren = 0;
+    for (unsigned int i = 0; i < 8;++i){
+        if (roots[i].childBits > 0){
+            slots[i] = 1 + totalChildren;
+            totalChildren += 1;
+        }
+    }
+    unsigned int totalRefers = 0;
+    bool changed = true;
+    while (changed){
+        changed = false;
+        uint64_t base = 1 + totalChildren + totalRefers;
+        for (unsigned int i = 0; i < 8;++i){
+            if (roots[i].childOffset == 0) continue;
+
+            // the octant is copied without its root
+            const uint64_t target = base + (octant[i].referPosition > 0? octant[i].referPosition : octant[i].children) - 1;
+            targets[i] = target;
+            if (!refers[i] && target - slots[i] >= ((uint64_t)1 << TOTAL_CHILDOFFSET_BITS)){
+                refers[i] = true;
+                totalRefers += 1;
+                changed = true;
+            }
+            base += octant[i].totalNodes - 1;
+        }
+    }
+
+    // write the root and its children
+    writeWord(out, NodeRead::encode(root));
+    uint64_t referPointer = 1 + totalChildren;
+    for (unsigned int i = 0; i < 8;++i){
+        if (roots[i].childBits == 0) continue;
+        Node child = roots[i];
+        if (refers[i]){
+            child.referBit = true;
+            child.childOffset = referPointer - slots[i];
+            referPointer += 1;
+        } else if (child.childOffset > 0){
+            child.childOffset = targets[i] - slots[i];
+        }
+        writeWord(out, NodeRead::encode(child));
+    }
+
+    // write the refer nodes, they point to the children of the octant roots
+    referPointer = 1 + totalChildren;
+    for (unsigned int i = 0; i < 8;++i){
+        if (!refers[i]) continue;
+        const uint64_t children = targets[i] + octant[i].children - (octant[i].referPosition > 0? octant[i].referPosition : octant[i].children);
+        writeWord(out, children - referPointer);
+        referPointer += 1;
+    }
+
+    // stream the octants without their roots
+    uint64_t totalNodes = 1 + totalChildren + totalRefers;
+    for (unsigned int i = 0; i < 8;++i){
+        if (roots[i].childOffset == 0) continue;
+        copyNodes(out, *octants[i], 1, octant[i].totalNodes - 1);
+        totalNodes += octant[i].totalNodes - 1;
+    }
+    Profiler::add(Profiler::REFER_NODES, totalRefers);
+    Profiler::add(Profiler::ALL_BYTES_WRITTEN, totalNodes*8);
+}
+
+void SVOMerger::copyNodes(std::ostream &out, std::istream &in, uint64_t firstNode, uint64_t totalNodes)
+{
+    std::vector<char> buffer(8*COPY_BUFFER_NODES);
+    in.seekg(firstNode*8, std::ios::beg);
+    while (totalNodes > 0){
+        const uint64_t nodes = std::min(totalNodes, (uint64_t)COPY_BUFFER_NODES);
+        in.read(buffer.data(), nodes*8);
+        out.write(buffer.data(), nodes*8);
+        totalNodes -= nodes;
+    }
+}
+
+void SVOMerger::writeWord(std::ostream &out, uint64_t word)
+{
+    uint8_t bytes[8];
+    NodeRead::toBytes(word, bytes);
+    out.write((const char*)bytes, 8);
+}
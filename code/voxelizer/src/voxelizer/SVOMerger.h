@@ -0,0 +1,34 @@
+#ifndef SVOMERGER_H
+#define SVOMERGER_H
+
+#include <fstream>
+#include <string>
+#include <vector>
+#include "structs.h"
+
+// Merges 8 SVO files in the 64 bit node format, one for every octant, in one SVO file with a
+// new root. The octant files are streamed, they are never fully loaded in memory.
+//
+// Merged file: <root><children of the root><refer nodes><octant 0 without root>...<octant 7 without root>
+class SVOMerger
+{
+public:
+    static void merge(std::ostream &out, std::istream* octants[8]);
+    static void mergeFiles(const char* outputFile, const char* octantFiles[8]);
+
+    static std::string octantFile(const char* file, unsigned int octant);
+
+private:
+    struct Octant{
+        Node root{{0,0,0,0}, 0, 0,0};
+        uint64_t totalNodes = 0;
+        uint64_t children = 0;       // position of the children of the root in the octant file
+        uint64_t referPosition = 0;  // refer node used by the root, 0 if none
+    };
+
+    static Octant readOctant(std::istream &in);
+    static void writeWord(std::ostream &out, uint64_t word);
+    static void copyNodes(std::ostream &out, std::istream &in, uint64_t firstNode, uint64_t totalNodes);
+};
+
+#endif
@@ -1,4 +1,6 @@
 #include "SVOSaver.h"
+#include "Profiler.h"
+#include "MemoryTracker.h"
 
 #include <queue>
 #include <iostream>
@@ -6,20 +8,28 @@
 #include <algorithm>
 #include <unordered_map>
 #include <utility>
+#include <thread>
+#include <future>
+#include <cmath>
+
+// boxes with more colors than this are split on a seperate thread
+#define PARALLEL_CUT_SIZE 50000
 
 uint8_t SVOSaver::writeBuffer{0};
 uint8_t SVOSaver::writeBufferIndex{0};
 
-std::vector<SVOSaver::ShaderElement> SVOSaver::toShaderElements(SVO::NestedElement nestedEl)
+std::vector<SVOSaver::ShaderElement> SVOSaver::toShaderElements(const SVO::NestedElement& nestedEl)
 {
     std::cout << " Transforming nested to 1D array...\n";
     std::vector<ShaderElement> shaderNodes;
 
-    std::queue<SVO::NestedElement> nodeStack; // nodes that need adding
-    struct ParentStackEl{SVO::NestedElement parent;unsigned int parentPointer;};
+    // the stacks point in the tree, the elements aren't copied
+    MemoryTracker::Block memory(MemoryTracker::SAVER);
+    std::queue<const SVO::NestedElement*> nodeStack; // nodes that need adding
+    struct ParentStackEl{const SVO::NestedElement* parent;unsigned int parentPointer;};
     std::queue<ParentStackEl> parentStack;   // parents whose children need adding
 
-    nodeStack.push(nestedEl);
+    nodeStack.push(&nestedEl);
 
     unsigned int totalNodes = 0;
 
@@ -27,7 +37,7 @@ std::vector<SVOSaver::ShaderElement> SVOSaver::toShaderElements(SVO::NestedEleme
         // nodeStack needs to be emptied first
         if (nodeStack.size() > 0){
             // take the first element from the node stack
-            SVO::NestedElement node = nodeStack.front();
+            const SVO::NestedElement& node = *nodeStack.front();
             nodeStack.pop();
 
             unsigned int RGBA = (node.R << 24) | (node.G << 16)| (node.B << 8)| node.A;
@@ -43,7 +53,7 @@ std::vector<SVOSaver::ShaderElement> SVOSaver::toShaderElements(SVO::NestedEleme
                     if (!node.children[i].isEmpty)
                         el.children |= (1 << i);
                 }
-                parentStack.push(ParentStackEl{node, totalNodes});
+                parentStack.push(ParentStackEl{&node, totalNodes});
             } else{
                 if (node.isEmpty){
                     el.children = 0;
@@ -54,6 +64,7 @@ std::vector<SVOSaver::ShaderElement> SVOSaver::toShaderElements(SVO::NestedEleme
 
             // add the shadernode
             shaderNodes.push_back(el);
+            if (MemoryTracker::bytes(shaderNodes) > memory.bytes()) memory.resize(MemoryTracker::bytes(shaderNodes));
 
             totalNodes += 1;
         }else{
@@ -63,9 +74,9 @@ std::vector<SVOSaver::ShaderElement> SVOSaver::toShaderElements(SVO::NestedEleme
 
             // add child offset pointer
             shaderNodes[item.parentPointer].childPointer = totalNodes - item.parentPointer;
-            for (unsigned int i = 0; i < item.parent.children.size();++i){
-                if (!item.parent.children[i].isEmpty)
-                    nodeStack.push(item.parent.children[i]);
+            for (unsigned int i = 0; i < item.parent->children.size();++i){
+                if (!item.parent->children[i].isEmpty)
+                    nodeStack.push(&item.parent->children[i]);
             }
         }
     }
@@ -99,13 +110,14 @@ void SVOSaver::calcColorIds(std::vector<ShaderElement>& elements,std::vector<uns
     unsigned int colorIndex = 0;
     std::unordered_map<unsigned int, unsigned int> colorHash;    // map color to colorID
     for (unsigned int i = 0; i < elements.size();++i){
-        try{
-            elements[i].RGBA = colorHash.at(elements[i].RGBA);
-        } catch(const std::out_of_range& oor){
+        auto it = colorHash.find(elements[i].RGBA);
+        if (it != colorHash.end()){
+            elements[i].RGBA = it->second;
+        } else{
             colorHash[elements[i].RGBA] = colorIndex;
             elements[i].RGBA = colorIndex;
             colorIndex += 1;
-        };
+        }
     }
 
     std::vector<std::pair<unsigned int,unsigned int>> values(colorHash.begin(), colorHash.end());
@@ -115,13 +127,154 @@ void SVOSaver::calcColorIds(std::vector<ShaderElement>& elements,std::vector<uns
         colors.push_back(values[i].first);
     }
 
-    maxBits = log2(colors.size()) + 1;
+    maxBits = colorIdBits(colors.size());
 
     std::cout << " Colors replaced with ids, totalColors:" << colors.size() << ", ColorBits:" << maxBits << "\n";
 }
 
-void SVOSaver::saveOpt(const char *output_file, SVO svo)
+unsigned int SVOSaver::colorIdBits(uint64_t totalColors)
+{
+    // bits needed for the ids 0 to totalColors-1
+    unsigned int bits = 1;
+    while (((uint64_t)1 << bits) < totalColors){
+        bits += 1;
+    }
+    return bits;
+}
+
+void SVOSaver::quantizeColors(std::vector<ShaderElement>& elements, unsigned int colorBits, float maxColorError)
+{
+    std::cout << " Quantizing colors...\n";
+
+    // count every distinct color
+    std::unordered_map<unsigned int, uint64_t> colorHash;
+    for (unsigned int i = 0; i < elements.size();++i){
+        colorHash[elements[i].RGBA] += 1;
+    }
+    std::vector<ColorCount> colors;
+    for (auto it = colorHash.begin(); it != colorHash.end(); ++it){
+        colors.push_back({it->first, it->second});
+    }
+
+    // split the colors in boxes, every color is replaced by the average color of its box
+    std::vector<std::pair<unsigned int, unsigned int>> colorMap;
+    medianCut(colors.begin(), colors.end(), colorBits > 0? colorBits : 24, maxColorError, colorMap);
+    const std::unordered_map<unsigned int, unsigned int> quantized(colorMap.begin(), colorMap.end());
+
+    // replace the colors of the elements in parallel
+    const unsigned int totalThreads = std::max(std::thread::hardware_concurrency(), 1u);
+    const uint64_t chunkSize = elements.size()/totalThreads + 1;
+    std::vector<double> squaredErrors(totalThreads, 0);
+    std::vector<unsigned int> maxErrors(totalThreads, 0);
+    std::vector<std::thread> threads;
+    for (unsigned int t = 0; t < totalThreads;++t){
+        threads.emplace_back([&, t](){
+            const uint64_t end = std::min(elements.size(), (t + 1)*chunkSize);
+            for (uint64_t i = t*chunkSize; i < end;++i){
+                const unsigned int q = quantized.at(elements[i].RGBA);
+                for (unsigned int c = 0; c < 4;++c){
+                    const int diff = (int)channel(elements[i].RGBA, c) - (int)channel(q, c);
+                    squaredErrors[t] += diff*diff;
+                    maxErrors[t] = std::max(maxErrors[t], (unsigned int)std::abs(diff));
+                }
+                elements[i].RGBA = q;
+            }
+        });
+    }
+    for (unsigned int t = 0; t < totalThreads;++t){
+        threads[t].join();
+    }
+
+    // report the error and the saved bytes
+    double squaredError = 0;
+    unsigned int maxError = 0;
+    for (unsigned int t = 0; t < totalThreads;++t){
+        squaredError += squaredErrors[t];
+        maxError = std::max(maxError, maxErrors[t]);
+    }
+    const double mse = squaredError/(4.*std::max(elements.size(), (size_t)1));
+    const double psnr = mse > 0? 10*log10(255.*255./mse) : INFINITY;
+
+    std::unordered_map<unsigned int, bool> quantizedColors;
+    for (unsigned int i = 0; i < colorMap.size();++i){
+        quantizedColors[colorMap[i].second] = true;
+    }
+    const unsigned int exactBits = colorIdBits(colors.size());
+    const unsigned int quantizedBits = colorIdBits(quantizedColors.size());
+    const int64_t savedBytes = (elements.size()*(exactBits - quantizedBits))/8 + 4*(colors.size() - quantizedColors.size());
+
+    std::cout << " Colors quantized, totalColors: " << colors.size() << " -> " << quantizedColors.size()
+              << ", ColorBits: " << exactBits << " -> " << quantizedBits
+              << ", max error: " << maxError << ", PSNR: " << psnr << " dB"
+              << ", saved: " << savedBytes << " bytes\n";
+}
+
+void SVOSaver::medianCut(std::vector<ColorCount>::iterator begin, std::vector<ColorCount>::iterator end, unsigned int bitsLeft, float maxColorError, std::vector<std::pair<unsigned int, unsigned int>>& colorMap)
 {
+    // find the average color and the range of every channel in the box
+    double sum[4] = {0,0,0,0};
+    uint8_t minC[4] = {255,255,255,255};
+    uint8_t maxC[4] = {0,0,0,0};
+    uint64_t total = 0;
+    for (auto it = begin; it != end; ++it){
+        for (unsigned int c = 0; c < 4;++c){
+            const uint8_t v = channel(it->RGBA, c);
+            sum[c] += (double)v*it->count;
+            minC[c] = std::min(minC[c], v);
+            maxC[c] = std::max(maxC[c], v);
+        }
+        total += it->count;
+    }
+
+    unsigned int average = 0;
+    float boxError = 0;
+    unsigned int splitChannel = 0;
+    for (unsigned int c = 0; c < 4;++c){
+        const double avg = std::round(sum[c]/total);
+        average = (average << 8) | (unsigned int)avg;
+        boxError = std::max(boxError, (float)std::max(avg - minC[c], maxC[c] - avg));
+        if (maxC[c] - minC[c] > maxC[splitChannel] - minC[splitChannel]){
+            splitChannel = c;
+        }
+    }
+
+    if (bitsLeft == 0 || end - begin <= 1 || (maxColorError > 0 && boxError <= maxColorError)){
+        // box is final, replace its colors by the average
+        for (auto it = begin; it != end; ++it){
+            colorMap.push_back({it->RGBA, average});
+        }
+        return;
+    }
+
+    // split the box on the weighted median of the channel with the largest range
+    std::sort(begin, end, [splitChannel](const ColorCount& l, const ColorCount& r){
+        return channel(l.RGBA, splitChannel) < channel(r.RGBA, splitChannel);
+    });
+    auto mid = begin;
+    uint64_t count = 0;
+    while (mid + 1 != end && count + mid->count <= total/2){
+        count += mid->count;
+        ++mid;
+    }
+    if (mid == begin) ++mid;
+
+    if (end - begin > PARALLEL_CUT_SIZE){
+        std::vector<std::pair<unsigned int, unsigned int>> firstMap;
+        std::future<void> first = std::async(std::launch::async, [&](){
+            medianCut(begin, mid, bitsLeft - 1, maxColorError, firstMap);
+        });
+        medianCut(mid, end, bitsLeft - 1, maxColorError, colorMap);
+        first.get();
+        colorMap.insert(colorMap.end(), firstMap.begin(), firstMap.end());
+    } else{
+        medianCut(begin, mid, bitsLeft - 1, maxColorError, colorMap);
+        medianCut(mid, end, bitsLeft - 1, maxColorError, colorMap);
+    }
+}
+
+void SVOSaver::saveOpt(const char *output_file, const SVO& svo, unsigned int colorBits, float maxColorError)
+{
+    Profiler::Scope scope("save");
     std::ofstream out;
 
     out.open(output_file, std::ios::binary | std::ios::out);
@@ -133,6 +286,7 @@ void SVOSaver::saveOpt(const char *output_file, SVO svo)
     }
 
     std::vector<ShaderElement> elements = toShaderElements(svo.getRoot());
+    MemoryTracker::Block elementMemory(MemoryTracker::SAVER, MemoryTracker::bytes(elements));
 
     std::vector<unsigned int> childPSizeUpdates;
     unsigned int maxChildPBits;
@@ -140,6 +294,9 @@ void SVOSaver::saveOpt(const char *output_file, SVO svo)
     unsigned int maxColorBits;
 
     calcChildPSizeRanges(elements, childPSizeUpdates, maxChildPBits);
+    if (colorBits > 0 || maxColorError > 0){
+        quantizeColors(elements, colorBits, maxColorError);
+    }
     calcColorIds(elements, colors, maxColorBits);
 
     // write child pointer size update list
@@ -179,11 +336,13 @@ void SVOSaver::saveOpt(const char *output_file, SVO svo)
     flush(out);
 
     std::cout << " File size: " << out.tellp() << " bytes\n";
+    Profiler::add(Profiler::ALL_BYTES_WRITTEN, out.tellp());
 
     out.close();
 }
-void SVOSaver::save(const char *output_file, SVO svo)
+void SVOSaver::save(const char *output_file, const SVO& svo)
 {
+    Profiler::Scope scope("save");
     std::ofstream out;
 
     out.open(output_file, std::ios::binary | std::ios::out);
@@ -195,6 +354,7 @@ void SVOSaver::save(const char *output_file, SVO svo)
     }
 
     std::vector<ShaderElement> elements = toShaderElements(svo.getRoot());
+    MemoryTracker::Block elementMemory(MemoryTracker::SAVER, MemoryTracker::bytes(elements));
 
     for (unsigned int i = 0; i < elements.size();++i){
 
@@ -204,6 +364,7 @@ void SVOSaver::save(const char *output_file, SVO svo)
     flush(out);
 
     std::cout << " File size: " << out.tellp() << " bytes\n";
+    Profiler::add(Profiler::ALL_BYTES_WRITTEN, out.tellp());
 
     out.close();
 }
@@ -12,17 +12,26 @@ public:
         unsigned int RGBA: 32;
     };
 
-    static void save(const char* output_file, SVO svo);
-    static void saveOpt(const char* output_file, SVO svo);
+    static void save(const char* output_file, const SVO& svo);
+    static void saveOpt(const char* output_file, const SVO& svo, unsigned int colorBits = 0, float maxColorError = 0);
 
 private:
 
-    static std::vector<ShaderElement> toShaderElements(SVO::NestedElement nestedEl);
+    static std::vector<ShaderElement> toShaderElements(const SVO::NestedElement& nestedEl);
 
     static void saveElement(std::ofstream &out, ShaderElement el, unsigned int childPointerSize, unsigned int colorSize);
 
     static void calcChildPSizeRanges(const std::vector<ShaderElement> elements, std::vector<unsigned int>& childPSizeUpdates, unsigned int& maxBits);
     static void calcColorIds(std::vector<ShaderElement>& elements,std::vector<unsigned int>& colors, unsigned int& maxBits);
+
+    struct ColorCount{
+        unsigned int RGBA;
+        uint64_t count;
+    };
+    static void quantizeColors(std::vector<ShaderElement>& elements, unsigned int colorBits, float maxColorError);
+    static void medianCut(std::vector<ColorCount>::iterator begin, std::vector<ColorCount>::iterator end, unsigned int bitsLeft, float maxColorError, std::vector<std::pair<unsigned int, unsigned int>>& colorMap);
+    static uint8_t channel(unsigned int RGBA, unsigned int c){ return (RGBA >> (24 - 8*c)) & 0xFF;}
+    static unsigned int colorIdBits(uint64_t totalColors);
     
 
     static uint8_t writeBuffer;
@@ -0,0 +1,95 @@
+#include "TaskScheduler.h"
+
+#include <chrono>
+#include <algorithm>
+
+#define IDLE_SPINS 64   // failed steals before an idle worker sleeps
+
+thread_local unsigned int TaskScheduler::_workerIndex{0};
+
+TaskScheduler::TaskScheduler(unsigned int totalThreads)
+{
+    if (totalThreads == 0) totalThreads = std::max(std::thread::hardware_concurrency(), 1u);
+
+    for (unsigned int i = 0; i < totalThreads;++i){
+        _workers.push_back(std::unique_ptr<Worker>(new Worker()));
+    }
+    _workerIndex = 0;
+    for (unsigned int i = 1; i < totalThreads;++i){
+        _threads.push_back(std::thread(&TaskScheduler::workerLoop, this, i));
+    }
+}
+
+TaskScheduler::~TaskScheduler()
+{
+    _stop.store(true);
+    for (unsigned int i = 0; i < _threads.size();++i){
+        _threads[i].join();
+    }
+}
+
+void TaskScheduler::spawn(TaskGroup &group, std::function<void()> task)
+{
+    group._pending.fetch_add(1);
+
+    Worker& worker = *_workers[_workerIndex];
+    std::lock_guard<std::mutex> lock(worker.mutex);
+    worker.tasks.push_back({std::move(task), &group});
+}
+
+void TaskScheduler::wait(TaskGroup &group)
+{
+    while (group._pending.load() > 0){
+        if (!runTask(_workerIndex)){
+            std::this_thread::yield();
+        }
+    }
+}
+
+bool TaskScheduler::runTask(unsigned int worker)
+{
+    Task task;
+    bool found = false;
+    {
+        // newest task of the own deque
+        Worker& own = *_workers[worker];
+        std::lock_guard<std::mutex> lock(own.mutex);
+        if (!own.tasks.empty()){
+            task = std::move(own.tasks.back());
+            own.tasks.pop_back();
+            found = true;
+        }
+    }
+
+    // steal the oldest task of another worker
+    for (unsigned int i = 1; !found && i < _workers.size();++i){
+        Worker& victim = *_workers[(worker + i) % _workers.size()];
+        std::lock_guard<std::mutex> lock(victim.mutex);
+        if (!victim.tasks.empty()){
+            task = std::move(victim.tasks.front());
+            victim.tasks.pop_front();
+            found = true;
+        }
+    }
+    if (!found) return false;
+
+    task.function();
+    task.group->_pending.fetch_sub(1);
+    return true;
+}
+
+void TaskScheduler::workerLoop(unsigned int worker)
+{
+    _workerIndex = worker;
+
+    unsigned int spins = 0;
+    while (!_stop.load()){
+        if (runTask(worker)){
+            spins = 0;
+        } else if (++spins < IDLE_SPINS){
+            std::this_thread::yield();
+        } else{
+            std::this_thread::sleep_for(std::chrono::microseconds(200));
+        }
+    }
+}
@@ -0,0 +1,54 @@
+#ifndef TASKSCHEDULER_H
+#define TASKSCHEDULER_H
+
+#include <atomic>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// Work-stealing task scheduler. Every worker has its own deque: a worker runs the newest task of
+// its own deque first and steals the oldest task of another worker when its deque is empty, so
+// large subtrees are stolen and small ones stay local. The thread that created the scheduler is
+// worker 0, it runs tasks while it waits.
+// A task can spawn tasks and wait for them, waiting runs other tasks instead of blocking.
+class TaskScheduler
+{
+public:
+    class TaskGroup{
+        friend class TaskScheduler;
+        std::atomic<unsigned int> _pending{0};
+    };
+
+    // 0 threads uses all cores
+    TaskScheduler(unsigned int totalThreads = 0);
+    ~TaskScheduler();
+
+    void spawn(TaskGroup &group, std::function<void()> task);
+    void wait(TaskGroup &group);
+
+    unsigned int totalThreads() const { return _workers.size(); }
+
+private:
+    struct Task{
+        std::function<void()> function;
+        TaskGroup* group;
+    };
+    struct Worker{
+        std::mutex mutex;
+        std::deque<Task> tasks;
+    };
+
+    bool runTask(unsigned int worker);
+    void workerLoop(unsigned int worker);
+
+    std::vector<std::unique_ptr<Worker>> _workers;
+    std::vector<std::thread> _threads;
+    std::atomic<bool> _stop{false};
+
+    static thread_local unsigned int _workerIndex;
+};
+
+#endif
@@ -0,0 +1,171 @@
+#include "TexelCache.h"
+#include "TaskScheduler.h"
+#include "Profiler.h"
+
+#include <iostream>
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+
+#define STB_IMAGE_IMPLEMENTATION
+#include <stb_image.h>
+
+#define TILE_SIZE 8     // texels per tile side, a tile of RGBA8 texels is 4 cache lines
+
+// decodes one image, the rows are flipped here because the flip setting of stb_image is shared by all threads
+static TexelCache::Image decodeImage(const std::string& file)
+{
+    TexelCache::Image image;
+    int channels;
+    uint8_t* data = stbi_load(file.c_str(), &image.width, &image.height, &channels, 4);
+    if (!data){
+        std::cout << "Failed to load texture " << file << "\n";
+        image.width = 0;
+        image.height = 0;
+        return image;
+    }
+
+    const uint64_t rowBytes = 4*(uint64_t)image.width;
+    image.rgba.resize(rowBytes*image.height);
+    for (int y = 0; y < image.height;++y){
+        memcpy(&image.rgba[rowBytes*y], data + rowBytes*(image.height - 1 - y), rowBytes);
+    }
+    stbi_image_free(data);
+    return image;
+}
+
+std::vector<TexelCache::Image> TexelCache::decode(const std::vector<std::string>& files)
+{
+    Profiler::Scope scope("textures");
+    std::vector<Image> images(files.size());
+    TaskScheduler scheduler;
+    TaskScheduler::TaskGroup group;
+    for (unsigned int i = 0; i < files.size();++i){
+        scheduler.spawn(group, [&images, &files, i](){
+            images[i] = decodeImage(files[i]);
+        });
+    }
+    scheduler.wait(group);
+    return images;
+}
+
+TexelCache::TexelCache(const std::vector<std::string>& files)
+{
+    // decode the textures and build their mip levels on all cores
+    Profiler::Scope scope("textures");
+    _textures.resize(files.size());
+    TaskScheduler scheduler;
+    TaskScheduler::TaskGroup group;
+    for (unsigned int i = 0; i < files.size();++i){
+        scheduler.spawn(group, [this, &files, i](){
+            const Image image = decodeImage(files[i]);
+            if (image.width > 0 && image.height > 0) _textures[i] = buildMips(image);
+        });
+    }
+    scheduler.wait(group);
+}
+
+glm::ivec2 TexelCache::size(unsigned int texture) const
+{
+    const Level& level = _textures[texture].levels[0];
+    return glm::ivec2(level.width, level.height);
+}
+
+TexelCache::Texture TexelCache::buildMips(const Image& image)
+{
+    Texture texture;
+    texture.levels.push_back(tile(image));
+
+    Image level = image;
+    while (level.width > 1 || level.height > 1){
+        level = halve(level);
+        texture.levels.push_back(tile(level));
+    }
+    return texture;
+}
+
+TexelCache::Level TexelCache::tile(const Image& image)
+{
+    Level level;
+    level.width = image.width;
+    level.height = image.height;
+    level.tilesX = (image.width + TILE_SIZE - 1)/TILE_SIZE;
+    const int tilesY = (image.height + TILE_SIZE - 1)/TILE_SIZE;
+    level.texels.resize(4*(uint64_t)level.tilesX*tilesY*TILE_SIZE*TILE_SIZE, 0);
+
+    for (int y = 0; y < image.height;++y){
+        for (int x = 0; x < image.width;++x){
+            const uint64_t tileIndex = (uint64_t)(y/TILE_SIZE)*level.tilesX + x/TILE_SIZE;
+            const uint64_t index = tileIndex*TILE_SIZE*TILE_SIZE + (y%TILE_SIZE)*TILE_SIZE + x%TILE_SIZE;
+            memcpy(&level.texels[4*index], &image.rgba[4*((uint64_t)y*image.width + x)], 4);
+        }
+    }
+    return level;
+}
+
+TexelCache::Image TexelCache::halve(const Image& image)
+{
+    // box filter of 2x2 texels, the last row or column is repeated for odd sizes
+    Image result;
+    result.width = std::max(image.width/2, 1);
+    result.height = std::max(image.height/2, 1);
+    result.rgba.resize(4*(uint64_t)result.width*result.height);
+    for (int y = 0; y < result.height;++y){
+        const int y0 = std::min(2*y, image.height - 1);
+        const int y1 = std::min(2*y + 1, image.height - 1);
+        for (int x = 0; x < result.width;++x){
+            const int x0 = std::min(2*x, image.width - 1);
+            const int x1 = std::min(2*x + 1, image.width - 1);
+            for (int c = 0; c < 4;++c){
+                const unsigned int sum = image.rgba[4*((uint64_t)y0*image.width + x0) + c] + image.rgba[4*((uint64_t)y0*image.width + x1) + c] +
+                                         image.rgba[4*((uint64_t)y1*image.width + x0) + c] + image.rgba[4*((uint64_t)y1*image.width + x1) + c];
+                result.rgba[4*((uint64_t)y*result.width + x) + c] = (sum + 2)/4;
+            }
+        }
+    }
+    return result;
+}
+
+glm::vec4 TexelCache::texel(const Level& level, int x, int y) const
+{
+    // repeat the texture
+    x %= level.width;
+    y %= level.height;
+    if (x < 0) x += level.width;
+    if (y < 0) y += level.height;
+
+    const uint64_t tileIndex = (uint64_t)(y/TILE_SIZE)*level.tilesX + x/TILE_SIZE;
+    const uint8_t* t = &level.texels[4*(tileIndex*TILE_SIZE*TILE_SIZE + (y%TILE_SIZE)*TILE_SIZE + x%TILE_SIZE)];
+    return glm::vec4(t[0], t[1], t[2], t[3]);
+}
+
+glm::vec4 TexelCache::bilinear(unsigned int texture, unsigned int level, glm::vec2 uv) const
+{
+    const Level& l = _textures[texture].levels[level];
+    const float x = uv.x*l.width - 0.5f;
+    const float y = uv.y*l.height - 0.5f;
+    const float fx = std::floor(x);
+    const float fy = std::floor(y);
+    const int x0 = (int)fx;
+    const int y0 = (int)fy;
+    const float wx = x - fx;
+    const float wy = y - fy;
+
+    return (texel(l, x0, y0)*(1 - wx) + texel(l, x0 + 1, y0)*wx)*(1 - wy) +
+           (texel(l, x0, y0 + 1)*(1 - wx) + texel(l, x0 + 1, y0 + 1)*wx)*wy;
+}
+
+RGBA8 TexelCache::samplePatch(unsigned int texture, glm::vec2 uv, float footprint) const
+{
+    // the mip level where the patch is 1 texel wide, blended with the next level
+    const Texture& t = _textures[texture];
+    uv = uv - glm::floor(uv);
+    const float level = glm::clamp(std::log2(std::max(footprint, 1.f)), 0.f, (float)(t.levels.size() - 1));
+    const unsigned int level0 = (unsigned int)level;
+    const unsigned int level1 = std::min(level0 + 1, (unsigned int)t.levels.size() - 1);
+    const float blend = level - level0;
+
+    glm::vec4 color = bilinear(texture, level0, uv);
+    if (blend > 0) color = color*(1 - blend) + bilinear(texture, level1, uv)*blend;
+    return {(uint8_t)(color.r + 0.5f), (uint8_t)(color.g + 0.5f), (uint8_t)(color.b + 0.5f), (uint8_t)(color.a + 0.5f)};
+}
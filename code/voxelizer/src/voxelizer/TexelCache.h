@@ -0,0 +1,56 @@
+#ifndef TEXELCACHE_H
+#define TEXELCACHE_H
+
+#include <string>
+#include <vector>
+#include <glm/glm.hpp>
+#include "structs.h"
+
+// Decoded textures for coloring voxels on the CPU. The textures are decoded on all cores when the
+// cache is created. Every mip level is stored in tiles of TILE_SIZE x TILE_SIZE texels, so the
+// 4 texels of a bilinear lookup and the texels of a patch are in a few cache lines, also in 8K
+// textures. The textures repeat like the OpenGL textures.
+class TexelCache
+{
+public:
+    struct Image{
+        int width = 0;
+        int height = 0;
+        std::vector<uint8_t> rgba;
+    };
+
+    // decodes the image files on all cores, the rows are flipped like OpenGL textures,
+    // a file that can't be decoded is an empty image
+    static std::vector<Image> decode(const std::vector<std::string>& files);
+
+    TexelCache(const std::vector<std::string>& files);
+
+    unsigned int totalTextures() const { return _textures.size(); }
+    bool valid(unsigned int texture) const { return !_textures[texture].levels.empty(); }
+    glm::ivec2 size(unsigned int texture) const;
+
+    // bilinear lookup in a mip level
+    glm::vec4 bilinear(unsigned int texture, unsigned int level, glm::vec2 uv) const;
+    // average color of the texels of a patch around uv, footprint is the width of the patch in texels
+    RGBA8 samplePatch(unsigned int texture, glm::vec2 uv, float footprint) const;
+
+private:
+    struct Level{
+        int width = 0;
+        int height = 0;
+        int tilesX = 0;
+        std::vector<uint8_t> texels;    // RGBA of the tiles in row order, the texels of a tile in row order
+    };
+    struct Texture{
+        std::vector<Level> levels;
+    };
+
+    static Texture buildMips(const Image& image);
+    static Level tile(const Image& image);
+    static Image halve(const Image& image);
+    glm::vec4 texel(const Level& level, int x, int y) const;
+
+    std::vector<Texture> _textures;
+};
+
+#endif
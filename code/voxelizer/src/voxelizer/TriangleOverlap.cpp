@@ -0,0 +1,371 @@
+#include "TriangleOverlap.h"
+#include "../opengl/modelloader.h"
+
+#include <iostream>
+#include <fstream>
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define OVERLAP_X86
+#include <immintrin.h>
+#endif
+
+#define ROW_CELLS 16        // voxels of a row tested by one call of a kernel
+#define MAX_TESTS 8         // plane, 3 uv edges, 3 wu edges
+
+// the tests of a row of voxels, voxel u of the row passes test i when a[i]*u + c[i] >= 0
+struct RowTests{
+    float a[MAX_TESTS];
+    float c[MAX_TESTS];
+    unsigned int totalTests;
+};
+
+// the kernels return a bit for every voxel u, u + 1, ... u + count - 1 of the row that passes all tests,
+// they all use separate multiplies and adds so every instruction set gives the same voxels
+typedef uint32_t (*RowKernel)(const RowTests& row, float u, unsigned int count);
+
+static uint32_t rowScalar(const RowTests& row, float u, unsigned int count)
+{
+    uint32_t mask = 0;
+    for (unsigned int i = 0; i < count;++i){
+        const float x = u + i;
+        bool inside = true;
+        for (unsigned int t = 0; t < row.totalTests && inside;++t){
+            inside = row.a[t]*x + row.c[t] >= 0;
+        }
+        if (inside) mask |= 1u << i;
+    }
+    return mask;
+}
+
+#ifdef OVERLAP_X86
+__attribute__((target("sse2")))
+static uint32_t rowSSE(const RowTests& row, float u, unsigned int count)
+{
+    uint32_t mask = 0;
+    const __m128 zero = _mm_setzero_ps();
+    for (unsigned int i = 0; i < count; i += 4){
+        const __m128 x = _mm_add_ps(_mm_set1_ps(u + i), _mm_setr_ps(0, 1, 2, 3));
+        __m128 inside = _mm_castsi128_ps(_mm_set1_epi32(-1));
+        for (unsigned int t = 0; t < row.totalTests;++t){
+            const __m128 f = _mm_add_ps(_mm_mul_ps(_mm_set1_ps(row.a[t]), x), _mm_set1_ps(row.c[t]));
+            inside = _mm_and_ps(inside, _mm_cmpge_ps(f, zero));
+        }
+        mask |= (uint32_t)_mm_movemask_ps(inside) << i;
+    }
+    return mask & ((1u << count) - 1);
+}
+
+__attribute__((target("avx2")))
+static uint32_t rowAVX2(const RowTests& row, float u, unsigned int count)
+{
+    uint32_t mask = 0;
+    const __m256 zero = _mm256_setzero_ps();
+    for (unsigned int i = 0; i < count; i += 8){
+        const __m256 x = _mm256_add_ps(_mm256_set1_ps(u + i), _mm256_setr_ps(0, 1, 2, 3, 4, 5, 6, 7));
+        __m256 inside = _mm256_castsi256_ps(_mm256_set1_epi32(-1));
+        for (unsigned int t = 0; t < row.totalTests;++t){
+            const __m256 f = _mm256_add_ps(_mm256_mul_ps(_mm256_set1_ps(row.a[t]), x), _mm256_set1_ps(row.c[t]));
+            inside = _mm256_and_ps(inside, _mm256_cmp_ps(f, zero, _CMP_GE_OQ));
+        }
+        mask |= (uint32_t)_mm256_movemask_ps(inside) << i;
+    }
+    return mask & ((1u << count) - 1);
+}
+#endif
+
+struct KernelInfo{
+    const char* name;
+    RowKernel kernel;
+};
+
+// the kernels this CPU supports, the fastest first
+static std::vector<KernelInfo> supportedKernels()
+{
+    std::vector<KernelInfo> kernels;
+#ifdef OVERLAP_X86
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("avx2")) kernels.push_back({"avx2", rowAVX2});
+    if (__builtin_cpu_supports("sse2")) kernels.push_back({"sse", rowSSE});
+#endif
+    kernels.push_back({"scalar", rowScalar});
+    return kernels;
+}
+
+static KernelInfo selectedKernel = supportedKernels()[0];
+
+std::vector<std::string> TriangleOverlap::instructionSets()
+{
+    std::vector<std::string> names{selectedKernel.name};
+    const std::vector<KernelInfo> kernels = supportedKernels();
+    for (unsigned int i = 0; i < kernels.size();++i){
+        if (kernels[i].name != names[0]) names.push_back(kernels[i].name);
+    }
+    return names;
+}
+
+bool TriangleOverlap::selectInstructionSet(const std::string& name)
+{
+    const std::vector<KernelInfo> kernels = supportedKernels();
+    for (unsigned int i = 0; i < kernels.size();++i){
+        if (kernels[i].name == name){
+            selectedKernel = kernels[i];
+            return true;
+        }
+    }
+    return false;
+}
+
+TriangleOverlap::TriangleOverlap(const glm::vec3 triangle[3])
+{
+    // the dominant axis of the normal is w, like swizzle() in voxelization.gs
+    const glm::vec3 n = glm::abs(glm::cross(triangle[1] - triangle[0], triangle[2] - triangle[0]));
+    if (n.x >= n.y && n.x >= n.z){
+        _axes = glm::ivec3(1, 2, 0);        // YZ plane
+    } else if (n.y >= n.x && n.y >= n.z){
+        _axes = glm::ivec3(2, 0, 1);        // ZX plane
+    } else{
+        _axes = glm::ivec3(0, 1, 2);        // XY plane
+    }
+    glm::vec3 v[3];
+    for (unsigned int i = 0; i < 3;++i){
+        v[i] = glm::vec3(triangle[i][_axes[0]], triangle[i][_axes[1]], triangle[i][_axes[2]]);
+    }
+    _min = glm::min(glm::min(v[0], v[1]), v[2]);
+    _max = glm::max(glm::max(v[0], v[1]), v[2]);
+
+    // plane, the voxel is between the planes through its nearest and farthest corner
+    _normal = glm::cross(v[1] - v[0], v[2] - v[0]);
+    // the plane of a triangle without area is rounding noise, it is tested as a line by the projections
+    const float e0 = glm::dot(v[1] - v[0], v[1] - v[0]);
+    const float e1 = glm::dot(v[2] - v[0], v[2] - v[0]);
+    if (glm::dot(_normal, _normal) <= 1e-10f*e0*e1) _normal = glm::vec3(0);
+    _planeMin = -glm::dot(_normal, v[0]);
+    _planeMax = -glm::dot(_normal, v[0]);
+    for (unsigned int a = 0; a < 3;++a){
+        _planeMin += std::min(_normal[a], 0.f);
+        _planeMax += std::max(_normal[a], 0.f);
+    }
+
+    // edges of the projections, the edge normals point inside for both windings
+    const auto projectEdges = [&](Edge* edges, unsigned int a, unsigned int b, unsigned int c){
+        const float side = _normal[c] >= 0? 1.f : -1.f;
+        for (unsigned int i = 0; i < 3;++i){
+            const glm::vec3 e = v[(i + 1) % 3] - v[i];
+            edges[i].a = -e[b]*side;
+            edges[i].b = e[a]*side;
+            edges[i].d = -(edges[i].a*v[i][a] + edges[i].b*v[i][b]) + std::max(edges[i].a, 0.f) + std::max(edges[i].b, 0.f);
+        }
+    };
+    projectEdges(_uv, 0, 1, 2);
+    projectEdges(_vw, 1, 2, 0);
+    projectEdges(_wu, 2, 0, 1);
+
+    // a triangle inside one layer of voxels overlaps the voxels its projection overlaps
+    _thin = std::ceil(_min.z) - 1 == std::floor(_max.z);
+}
+
+void TriangleOverlap::voxels(glm::uvec3 origin, unsigned int size, std::vector<glm::uvec3>& result) const
+{
+    // voxels of the bounding box in the brick
+    int begin[3], end[3];
+    for (unsigned int a = 0; a < 3;++a){
+        const float first = (float)origin[_axes[a]];
+        begin[a] = (int)std::max(std::ceil(_min[a]) - 1, first);
+        end[a] = (int)std::min(std::floor(_max[a]), first + size - 1);
+        if (begin[a] > end[a]) return;
+    }
+
+    const RowKernel kernel = selectedKernel.kernel;
+    RowTests row;
+    const auto addVoxels = [&](int u, unsigned int v, unsigned int w, uint32_t mask){
+        for (; mask != 0; mask &= mask - 1){
+            glm::uvec3 voxel;
+            voxel[_axes[0]] = u + __builtin_ctz(mask);
+            voxel[_axes[1]] = v;
+            voxel[_axes[2]] = w;
+            result.push_back(voxel);
+        }
+    };
+
+    if (_thin){
+        // 2D test of the uv projection in the layer of the triangle
+        row.totalTests = 3;
+        for (int v = begin[1]; v <= end[1];++v){
+            for (unsigned int i = 0; i < 3;++i){
+                row.a[i] = _uv[i].a;
+                row.c[i] = _uv[i].b*v + _uv[i].d;
+            }
+            for (int u = begin[0]; u <= end[0]; u += ROW_CELLS){
+                const unsigned int count = std::min(end[0] - u + 1, ROW_CELLS);
+                addVoxels(u, v, begin[2], kernel(row, (float)u, count));
+            }
+        }
+        return;
+    }
+
+    row.totalTests = MAX_TESTS;
+    for (int v = begin[1]; v <= end[1];++v){
+        for (int u = begin[0]; u <= end[0]; u += ROW_CELLS){
+            const unsigned int count = std::min(end[0] - u + 1, ROW_CELLS);
+
+            // layers where the plane can pass the voxels of the row, with a margin as the kernel tests exactly
+            int wBegin = begin[2], wEnd = end[2];
+            if (_normal.z != 0){
+                float low = INFINITY, high = -INFINITY;
+                for (unsigned int corner = 0; corner < 2;++corner){
+                    const float uv = _normal.x*(u + corner*(count - 1.f)) + _normal.y*v;
+                    const float w0 = -(uv + _planeMax)/_normal.z;
+                    const float w1 = -(uv + _planeMin)/_normal.z;
+                    low = std::min(low, std::min(w0, w1));
+                    high = std::max(high, std::max(w0, w1));
+                }
+                const float margin = 1e-3f*(std::abs(low) + std::abs(high) + 1);
+                wBegin = (int)std::max(std::ceil(low - margin) - 1, (float)begin[2]);
+                wEnd = (int)std::min(std::floor(high + margin) + 1, (float)end[2]);
+            }
+
+            for (int w = wBegin; w <= wEnd;++w){
+                // the vw projection is the same for the whole row
+                bool inside = true;
+                for (unsigned int i = 0; i < 3 && inside;++i){
+                    inside = _vw[i].a*v + _vw[i].b*w + _vw[i].d >= 0;
+                }
+                if (!inside) continue;
+
+                const float planeUV = _normal.y*v + _normal.z*w;
+                row.a[0] = _normal.x;
+                row.c[0] = planeUV + _planeMax;
+                row.a[1] = -_normal.x;
+                row.c[1] = -(planeUV + _planeMin);
+                for (unsigned int i = 0; i < 3;++i){
+                    row.a[2 + i] = _uv[i].a;
+                    row.c[2 + i] = _uv[i].b*v + _uv[i].d;
+                    row.a[5 + i] = _wu[i].b;
+                    row.c[5 + i] = _wu[i].a*w + _wu[i].d;
+                }
+                addVoxels(u, v, w, kernel(row, (float)u, count));
+            }
+        }
+    }
+}
+
+bool TriangleOverlap::overlaps(const glm::vec3 triangle[3], glm::vec3 center, float halfSize)
+{
+    // separating axis test of a triangle and a cube (Akenine-Moller)
+    const glm::vec3 v[3] = {triangle[0] - center, triangle[1] - center, triangle[2] - center};
+
+    // axes of the cube
+    for (unsigned int a = 0; a < 3;++a){
+        if (std::min(std::min(v[0][a], v[1][a]), v[2][a]) > halfSize) return false;
+        if (std::max(std::max(v[0][a], v[1][a]), v[2][a]) < -halfSize) return false;
+    }
+
+    // normal of the triangle
+    const glm::vec3 e[3] = {v[1] - v[0], v[2] - v[1], v[0] - v[2]};
+    const glm::vec3 normal = glm::cross(e[0], e[1]);
+    const float r = halfSize*(std::abs(normal.x) + std::abs(normal.y) + std::abs(normal.z));
+    if (std::abs(glm::dot(normal, v[0])) > r) return false;
+
+    // cross products of the edges and the axes of the cube
+    for (unsigned int i = 0; i < 3;++i){
+        for (unsigned int a = 0; a < 3;++a){
+            glm::vec3 unit(0);
+            unit[a] = 1;
+            const glm::vec3 axis = glm::cross(unit, e[i]);
+            const float p0 = glm::dot(axis, v[0]);
+            const float p1 = glm::dot(axis, v[1]);
+            const float p2 = glm::dot(axis, v[2]);
+            const float radius = halfSize*(std::abs(axis.x) + std::abs(axis.y) + std::abs(axis.z));
+            if (std::min(std::min(p0, p1), p2) > radius || std::max(std::max(p0, p1), p2) < -radius) return false;
+        }
+    }
+    return true;
+}
+
+void TriangleOverlap::benchmark(const std::vector<std::string>& files, unsigned int depth)
+{
+    typedef std::chrono::steady_clock Clock;
+    const auto seconds = [](Clock::time_point begin){
+        return std::chrono::duration<double>(Clock::now() - begin).count();
+    };
+    const unsigned int resolution = 1 << depth;
+    const std::vector<std::string> instructionSets = TriangleOverlap::instructionSets();
+    std::cout << "Overlap kernels at depth " << depth << ", selected instruction set: " << instructionSets[0] << "\n";
+
+    for (unsigned int f = 0; f < files.size();++f){
+        if (!std::ifstream(files[f])){
+            std::cout << "\n" << files[f] << " not found, skipped\n";
+            continue;
+        }
+        const size_t slash = files[f].find_last_of("/\\");
+        const std::string path = slash == std::string::npos? "" : files[f].substr(0, slash + 1);
+        const std::string filename = files[f].substr(path.size());
+        const ModelLoader::Result model = ModelLoader::loadModel(path.c_str(), filename.c_str());
+        const TriangleStore& store = *model.store;
+
+        // triangles in voxel coordinates and the distribution of their sizes
+        std::vector<glm::vec3> triangles(3*store.triangles.size());
+        unsigned int sizes[6] = {0,0,0,0,0,0};
+        unsigned int thin = 0;
+        for (unsigned int t = 0; t < store.triangles.size();++t){
+            for (unsigned int c = 0; c < 3;++c){
+                const float* p = &store.positions[3*(uint64_t)store.triangles[t].position[c]];
+                triangles[3*t + c] = glm::vec3(p[0], p[1], p[2])*(float)resolution;
+            }
+            const glm::vec3 extent = glm::max(glm::max(triangles[3*t], triangles[3*t + 1]), triangles[3*t + 2]) -
+                                     glm::min(glm::min(triangles[3*t], triangles[3*t + 1]), triangles[3*t + 2]);
+            const float longest = std::max(std::max(extent.x, extent.y), extent.z);
+            unsigned int bucket = 0;
+            while (bucket < 5 && longest >= (float)(1 << (2*bucket))) bucket += 1;
+            sizes[bucket] += 1;
+            thin += TriangleOverlap(&triangles[3*t]).thin();
+        }
+        std::cout << "\n" << files[f] << ": " << store.triangles.size() << " triangles, " << thin << " in one voxel layer\n";
+        std::cout << " Longest side in voxels: <1: " << sizes[0] << ", 1-4: " << sizes[1] << ", 4-16: " << sizes[2] <<
+                     ", 16-64: " << sizes[3] << ", 64-256: " << sizes[4] << ", >=256: " << sizes[5] << "\n";
+
+        // reference: separating axis test of every voxel of the bounding box
+        Clock::time_point begin = Clock::now();
+        uint64_t referenceVoxels = 0, testedVoxels = 0;
+        for (unsigned int t = 0; t < store.triangles.size();++t){
+            const glm::vec3* v = &triangles[3*t];
+            const glm::vec3 vmin = glm::min(glm::min(v[0], v[1]), v[2]);
+            const glm::vec3 vmax = glm::max(glm::max(v[0], v[1]), v[2]);
+            glm::uvec3 first, last;
+            for (unsigned int a = 0; a < 3;++a){
+                first[a] = (unsigned int)std::max(std::ceil(vmin[a]) - 1, 0.f);
+                last[a] = (unsigned int)std::min(std::floor(vmax[a]), resolution - 1.f);
+            }
+            for (unsigned int z = first.z; z <= last.z;++z){
+                for (unsigned int y = first.y; y <= last.y;++y){
+                    for (unsigned int x = first.x; x <= last.x;++x){
+                        testedVoxels += 1;
+                        referenceVoxels += overlaps(v, glm::vec3(x + 0.5f, y + 0.5f, z + 0.5f), 0.5f);
+                    }
+                }
+            }
+        }
+        const double referenceTime = seconds(begin);
+        std::cout << " reference: " << referenceTime*1000 << " ms, " << store.triangles.size()/referenceTime/1e6 << " M triangles/s, " <<
+                     testedVoxels/referenceTime/1e6 << " M voxel tests/s, " << referenceVoxels << " voxels\n";
+
+        for (unsigned int k = 0; k < instructionSets.size();++k){
+            selectInstructionSet(instructionSets[k]);
+            std::vector<glm::uvec3> voxels;
+            uint64_t totalVoxels = 0;
+            begin = Clock::now();
+            for (unsigned int t = 0; t < store.triangles.size();++t){
+                voxels.clear();
+                TriangleOverlap(&triangles[3*t]).voxels(glm::uvec3(0), resolution, voxels);
+                totalVoxels += voxels.size();
+            }
+            const double time = seconds(begin);
+            std::cout << " " << instructionSets[k] << ": " << time*1000 << " ms, " << store.triangles.size()/time/1e6 << " M triangles/s, " <<
+                         referenceTime/time << "x the reference, " << totalVoxels << " voxels\n";
+        }
+        selectInstructionSet(instructionSets[0]);
+    }
+}
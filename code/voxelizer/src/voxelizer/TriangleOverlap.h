@@ -0,0 +1,50 @@
+#ifndef TRIANGLEOVERLAP_H
+#define TRIANGLEOVERLAP_H
+
+#include <vector>
+#include <string>
+#include <glm/glm.hpp>
+
+// Finds the voxels of a grid that a triangle overlaps, for the CPU voxelizer. The separating axis
+// test is split in a test of the plane of the triangle and tests of its projections on the 3 axis
+// planes (Schwarz and Seidel), the constants of these tests are computed once per triangle. The
+// triangle is swizzled like in voxelization.gs, so w is the dominant axis of its normal and only
+// the voxels near the plane are tested. The voxels are tested in rows along u by a SIMD kernel
+// (AVX2 or SSE, selected at runtime). A triangle inside one voxel layer along w is tested in 2D
+// with its projection on the uv plane.
+class TriangleOverlap
+{
+public:
+    // triangle in voxel coordinates, voxel (x,y,z) is the cube from (x,y,z) to (x+1,y+1,z+1)
+    TriangleOverlap(const glm::vec3 v[3]);
+
+    // adds the voxels of the brick of size^3 voxels at origin that the triangle overlaps, voxels that
+    // only touch the triangle are included. The voxels don't depend on how the grid is split in bricks.
+    void voxels(glm::uvec3 origin, unsigned int size, std::vector<glm::uvec3>& result) const;
+    // true for the triangles that are tested in 2D
+    bool thin() const { return _thin; }
+
+    // separating axis test of a triangle and a cube (Akenine-Moller), reference for the kernels
+    static bool overlaps(const glm::vec3 v[3], glm::vec3 center, float halfSize);
+
+    // the instruction sets of the kernels this CPU supports, the selected one is first
+    static std::vector<std::string> instructionSets();
+    static bool selectInstructionSet(const std::string& name);
+
+    // tests the kernels with the triangles of OBJ files voxelized at depth
+    static void benchmark(const std::vector<std::string>& files, unsigned int depth);
+
+private:
+    struct Edge{
+        float a, b, d;      // a voxel is inside the edge when a*p.a + b*p.b + d >= 0 for its corner p
+    };
+
+    glm::ivec3 _axes;       // x, y and z axis of u, v and w
+    glm::vec3 _min, _max;   // bounding box in uvw
+    glm::vec3 _normal;
+    float _planeMin, _planeMax;
+    Edge _uv[3], _vw[3], _wu[3];
+    bool _thin;
+};
+
+#endif
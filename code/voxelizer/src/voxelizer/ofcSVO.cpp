@@ -5,84 +5,163 @@
 #include "SVO.h"
 #include "SVOSaver.h"
 #include "NodeWrite.h"
+#include "Profiler.h"
+#include "MemoryTracker.h"
 
-#define TOTAL_CHILDOFFSET_BITS 23
+#define REVERSE_BLOCK_NODES (1 << 19)
 
-void OfcSVO::create(std::ofstream &SVOout, std::vector<Voxel> voxels, unsigned int depth, bool optimized)
+OfcSVO::OfcSVO(std::ostream &SVOout, unsigned int depth, bool bricks, bool showProgress)
+    : _SVOout{SVOout}, _bricks{bricks}, _showProgress{showProgress}
 {
-    // init queues
-    std::vector<std::vector<Node>> depthQueues;
-    std::vector<uint8_t> emptypostQueues;     // total empty elements at the end of each queue
-    depthQueues.resize(depth + 1);
-    emptypostQueues.resize(depth + 1, 0);
+    if (_bricks && depth < BRICK_LEVELS){
+        std::cout << "Depth too small for bricks, creating SVO without bricks\n";
+        _bricks = false;
+    }
 
-    uint64_t outPointer = 1;
-    const uint64_t res = (uint64_t)1 << (uint64_t)depth;
+    // the tree stops early when the last levels are stored in bricks
+    _treeDepth = _bricks? depth - BRICK_LEVELS : depth;
+    _leafVoxels = _bricks? BRICK_VOXELS : 1;
+    _totalVoxels = (uint64_t)1 << (uint64_t)(3*depth);
 
+    // init queues
+    _depthQueues.resize(_treeDepth + 1);
+    _emptypostQueues.resize(_treeDepth + 1, 0);
+}
+
+void OfcSVO::create(std::ostream &SVOout, const std::vector<Voxel>& voxels, unsigned int depth, bool optimized, bool bricks)
+{
     // reorder voxels in morton order
-    std::vector<MortonVoxel> mortonOrderedVoxels = reorderVoxels(voxels);
+    std::vector<MortonVoxel> mortonOrderedVoxels;
+    MemoryTracker::Block sortMemory(MemoryTracker::SORT, voxels.size()*sizeof(MortonVoxel));
+    {
+        Profiler::Scope scope("sort");
+        mortonOrderedVoxels = reorderVoxels(voxels);
+    }
+
+    Profiler::Scope scope("build");
+    OfcSVO builder(SVOout, depth, bricks);
+    builder.addVoxels(mortonOrderedVoxels, builder._totalVoxels);
+    builder.finish();
+}
+
+void OfcSVO::addVoxels(const std::vector<MortonVoxel>& mortonOrderedVoxels, uint64_t endCode)
+{
+    endCode = std::min(endCode, _totalVoxels);
 
     uint64_t mortonPos = 0;
-    for (uint64_t pos = 0; pos < (res*res*res); ++pos){
+    while (_position < endCode){
+        // skip voxels in front of the position, this also skips duplicates
+        while (mortonPos < mortonOrderedVoxels.size() && mortonOrderedVoxels[mortonPos].mortonCode < _position){
+            mortonPos += 1;
+        }
 
-        // add voxel to queue
-        addVoxelToQueue(mortonOrderedVoxels, mortonPos, pos, depthQueues, emptypostQueues);
+        // skip the empty leaves up to the leaf of the next voxel
+        uint64_t nextCode = endCode;
+        if (mortonPos < mortonOrderedVoxels.size()){
+            nextCode = std::min(endCode, mortonOrderedVoxels[mortonPos].mortonCode / _leafVoxels * _leafVoxels);
+        }
+        if (_position < nextCode){
+            addEmpty(nextCode);
+            continue;
+        }
+
+        // add voxel or brick to queue
+        if (_bricks){
+            addBrickToQueue(mortonOrderedVoxels, mortonPos);
+        } else{
+            addVoxelToQueue(mortonOrderedVoxels, mortonPos);
+        }
+        _position += _leafVoxels;
 
         // process all full queues
-        processFullQueues(SVOout, outPointer, depthQueues, emptypostQueues);
+        processFullQueues(_treeDepth);
+
+        printProgress();
+    }
+}
 
-        // write status to console
-        if (pos % uint64_t((res*res*res)/100.) == 0){
-            std::cout << ((float)pos/(float)(res*res*res))*100 << "%\n";
+void OfcSVO::addEmpty(uint64_t endCode)
+{
+    while (_position < endCode){
+        // add the largest aligned empty node that ends before endCode, the queues below it are empty
+        unsigned int level = 0;
+        uint64_t size = _leafVoxels;
+        while (level < _treeDepth && _position % (size*8) == 0 && _position + size*8 <= endCode){
+            size *= 8;
+            level += 1;
         }
+
+        const int d = _treeDepth - level;
+        _emptypostQueues[d] += 1;
+        _position += size;
+
+        processFullQueues(d);
     }
+    printProgress();
+}
+
+void OfcSVO::finish()
+{
+    addEmpty(_totalVoxels);
 
-    writeRoot(SVOout, outPointer, depthQueues, emptypostQueues);
+    writeRoot();
 
-    NodeWrite::flush(SVOout);
+    NodeWrite::flush(_SVOout);
+
+    Profiler::add(Profiler::VOXELS, _addedVoxels);
+    Profiler::add(Profiler::REFER_NODES, _referNodes);
 }
 
-void OfcSVO::processFullQueues(std::ofstream &SVOout, uint64_t& outPointer, std::vector<std::vector<Node>>& depthQueues, std::vector<uint8_t>& emptypostQueues)
+void OfcSVO::printProgress()
 {
-    int d = depthQueues.size()-1;
+    // write status to console
+    if (!_showProgress) return;
+    const unsigned int progress = ((double)_position/(double)_totalVoxels)*100;
+    if (progress > _progress){
+        _progress = progress;
+        std::cout << _progress << "%\n";
+    }
+}
 
+void OfcSVO::processFullQueues(int d)
+{
     // process full queues
-    while(d > 0 && (depthQueues[d].size() + emptypostQueues[d]) >= 8){
-        if (emptypostQueues[d] >= 8){
+    while(d > 0 && (_depthQueues[d].size() + _emptypostQueues[d]) >= 8){
+        if (_emptypostQueues[d] >= 8){
             // empty queue is full, add to the bigger empty queue
-            emptypostQueues[d] = 0; // clear queue
-            emptypostQueues[d-1] += 1; // add to next queue
+            _emptypostQueues[d] = 0; // clear queue
+            _emptypostQueues[d-1] += 1; // add to next queue
     
         } else{
             // first add the empty nodes in the empty postfix queue
-            for (unsigned int i = 0; i < emptypostQueues[d];++i){
-                depthQueues[d].push_back({{0,0,0,0},0, 0,0});
+            for (unsigned int i = 0; i < _emptypostQueues[d];++i){
+                _depthQueues[d].push_back({{0,0,0,0},0, 0,0});
             }
-            emptypostQueues[d] = 0; // clear empty queue
+            _emptypostQueues[d] = 0; // clear empty queue
 
-            Node parent = processFullQueue(SVOout, &depthQueues[d], outPointer);
+            Node parent = processFullQueue(&_depthQueues[d]);
 
             // add the empty nodes to the bigger queue
-            for (unsigned int i = 0; i < emptypostQueues[d-1];++i){
-                depthQueues[d-1].push_back({{0,0,0,0},0, 0,0});
+            for (unsigned int i = 0; i < _emptypostQueues[d-1];++i){
+                _depthQueues[d-1].push_back({{0,0,0,0},0, 0,0});
             }
-            emptypostQueues[d-1] = 0;
-            depthQueues[d-1].push_back(parent); // add parent to bigger queue
+            _emptypostQueues[d-1] = 0;
+            _depthQueues[d-1].push_back(parent); // add parent to bigger queue
         }
         d -= 1; // process next queue
     }
 }
 
-std::vector<OfcSVO::MortonVoxel> OfcSVO::reorderVoxels(std::vector<Voxel> voxels)
+std::vector<OfcSVO::MortonVoxel> OfcSVO::reorderVoxels(const std::vector<Voxel>& voxels)
 {
     // reorder voxels in morton order
     std::cout << "Reordering voxels in morton order...\n";
 
     std::vector<MortonVoxel> mortonOrderedVoxels;
+    mortonOrderedVoxels.reserve(voxels.size());
 
     // calculate morton code for every voxel
     for (uint64_t i = 0; i < voxels.size();++i){
-        Voxel* vox = &voxels[i];
         mortonOrderedVoxels.push_back({voxels[i].RGBA, mortonEncode_magicbits(voxels[i].XYZ[0],voxels[i].XYZ[1],voxels[i].XYZ[2])});
     }
 
@@ -114,51 +193,108 @@ bool OfcSVO::mortonCompare(MortonVoxel a, MortonVoxel b){
     return a.mortonCode < b.mortonCode;
 }
 
-void OfcSVO::addVoxelToQueue(std::vector<MortonVoxel>& mortonOrderedVoxels, uint64_t& mortonPos, uint64_t currentCode, std::vector<std::vector<Node>>& depthQueues, std::vector<uint8_t>& emptypostQueues)
+void OfcSVO::addVoxelToQueue(const std::vector<MortonVoxel>& mortonOrderedVoxels, uint64_t& mortonPos)
 {
-    unsigned int lastQIndex = depthQueues.size() - 1;
-    if (mortonPos >= mortonOrderedVoxels.size() || mortonOrderedVoxels[mortonPos].mortonCode != currentCode){
+    unsigned int lastQIndex = _treeDepth;
+    if (mortonPos >= mortonOrderedVoxels.size() || mortonOrderedVoxels[mortonPos].mortonCode != _position){
         // empty node, add to empty queue
-        emptypostQueues[lastQIndex] += 1;
+        _emptypostQueues[lastQIndex] += 1;
     } else{
         // solid node, first add the empty nodes in the empty postfix queue
-        for (unsigned int i = 0; i < emptypostQueues[lastQIndex];++i){
-            depthQueues[lastQIndex].push_back({{0,0,0,0},0, 0,0});
+        for (unsigned int i = 0; i < _emptypostQueues[lastQIndex];++i){
+            _depthQueues[lastQIndex].push_back({{0,0,0,0},0, 0,0});
         }
-        emptypostQueues[lastQIndex] = 0;
+        _emptypostQueues[lastQIndex] = 0;
 
         // add leaf to the queue
         Node leaf{mortonOrderedVoxels[mortonPos].voxel, 0,0,0};
         leaf.childBits = 255;
-        depthQueues[lastQIndex].push_back(leaf);
+        _depthQueues[lastQIndex].push_back(leaf);
+        _addedVoxels += 1;
 
         mortonPos += 1;
     }
 }
 
-void OfcSVO::writeRoot(std::ofstream &SVOout, uint64_t& outPointer, std::vector<std::vector<Node>>& depthQueues, std::vector<uint8_t>& emptypostQueues)
+void OfcSVO::addBrickToQueue(const std::vector<MortonVoxel>& mortonOrderedVoxels, uint64_t& mortonPos)
 {
-    if (emptypostQueues[0] > 0){
+    unsigned int lastQIndex = _treeDepth;
+    const uint64_t brickCode = _position;
+
+    // collect the voxels inside the brick, they are consecutive in morton order
+    uint64_t mask = 0;
+    std::vector<RGBA8> colors;
+    std::vector<Node> leaves(BRICK_VOXELS, {{0,0,0,0},0, 0,0});
+    while (mortonPos < mortonOrderedVoxels.size() && mortonOrderedVoxels[mortonPos].mortonCode < brickCode + BRICK_VOXELS){
+        const uint64_t localCode = mortonOrderedVoxels[mortonPos].mortonCode - brickCode;
+        if (mask & ((uint64_t)1 << localCode)){
+            // duplicate voxel
+            mortonPos += 1;
+            continue;
+        }
+        mask |= (uint64_t)1 << localCode;
+        colors.push_back(mortonOrderedVoxels[mortonPos].voxel);
+        leaves[localCode] = {mortonOrderedVoxels[mortonPos].voxel, 255, 0,0};
+        _addedVoxels += 1;
+        mortonPos += 1;
+    }
+
+    if (mask == 0){
+        // empty brick, add to empty queue
+        _emptypostQueues[lastQIndex] += 1;
+        return;
+    }
+
+    // mix the colors the same way as the levels above the brick
+    std::vector<Node> subNodes;
+    for (unsigned int i = 0; i < 8;++i){
+        std::vector<Node> subLeaves(leaves.begin() + 8*i, leaves.begin() + 8*i + 8);
+        subNodes.push_back({Node::mixColors(subLeaves), createChildBits(subLeaves), 0,0});
+    }
+
+    Node node{Node::mixColors(subNodes), 0, 0,0};
+    if (mask == ~(uint64_t)0 && allEqual(leaves)){
+        // all voxels equal, set node to a solid node
+        node.childBits = 255;
+    } else{
+        // write the brick, the node points to the occupancy mask
+        _outPointer += NodeWrite::writeBrick(_SVOout, mask, colors);
+        node.childPointer = _outPointer - 1;
+        node.childBits = createChildBits(subNodes);
+    }
+
+    // first add the empty nodes in the empty postfix queue
+    for (unsigned int i = 0; i < _emptypostQueues[lastQIndex];++i){
+        _depthQueues[lastQIndex].push_back({{0,0,0,0},0, 0,0});
+    }
+    _emptypostQueues[lastQIndex] = 0;
+
+    _depthQueues[lastQIndex].push_back(node);
+}
+
+void OfcSVO::writeRoot()
+{
+    if (_emptypostQueues[0] > 0){
         // root is empty
         Node root = {{0,0,0,0}, 0,0,0};
-        NodeWrite::writeNode(SVOout,root);
+        NodeWrite::writeNode(_SVOout,root);
         return;
     }
 
-    if (depthQueues[0].size() <= 0){
+    if (_depthQueues[0].size() <= 0){
         std::cout << "Error creating SVO root not found\n";
         throw;
     }
 
-    if (depthQueues[0][0].childPointer > 0){
-        depthQueues[0][0].childOffset = 1;
+    if (_depthQueues[0][0].childPointer > 0){
+        _depthQueues[0][0].childOffset = 1;
     }
-    Node root = depthQueues[0][0];
+    Node root = _depthQueues[0][0];
 
-    NodeWrite::writeNode(SVOout,root);
+    NodeWrite::writeNode(_SVOout,root);
 }
 
-Node OfcSVO::processFullQueue(std::ofstream &SVOout, std::vector<Node>* children, uint64_t& outPointer)
+Node OfcSVO::processFullQueue(std::vector<Node>* children)
 {
     Node parent;
     parent.RGBA = Node::mixColors(*children);
@@ -174,9 +310,9 @@ Node OfcSVO::processFullQueue(std::ofstream &SVOout, std::vector<Node>* children
         parent.childPointer = 0;
     } else {
         // write the children
-        writeChildren(SVOout, *children, outPointer);
+        writeChildren(*children);
 
-        parent.childPointer = outPointer - 1;
+        parent.childPointer = _outPointer - 1;
         parent.childBits = createChildBits(*children);
     }
     children->clear();
@@ -188,8 +324,8 @@ bool OfcSVO::allEqual(std::vector<Node> children)
     RGBA8 rgba{0,0,0,0};
     bool allEqual = true;
     for (int i = 0; i < children.size();++i){
-        // check if any missing children
-        if (children[i].childBits != 255) return false;
+        // check if any missing children or children with their own children
+        if (children[i].childBits != 255 || children[i].childPointer > 0) return false;
 
         if (rgba.A == 0){
             // first node with a color
@@ -225,19 +361,20 @@ uint64_t OfcSVO::offsetOfPointers(uint64_t pointer1, uint64_t pointer2)
     return pointer2 - pointer1;
 }
 
-void OfcSVO::writeChildren(std::ofstream &SVOout, std::vector<Node> children, uint64_t& outPointer)
+void OfcSVO::writeChildren(std::vector<Node> children)
 {
     // write referrals for offsets that are too large
     for (int i = 7; i >= 0;--i){
         if (children[i].childBits > 0 && children[i].childPointer > 0){
-            uint64_t offset = offsetOfPointers(children[i].childPointer, outPointer);
+            uint64_t offset = offsetOfPointers(children[i].childPointer, _outPointer);
 
             if (offset >= (1 << TOTAL_CHILDOFFSET_BITS)){
                 // write referral because the offset is too large
-                NodeWrite::writeRefer(SVOout, offset);
-                children[i].childPointer = outPointer;
+                NodeWrite::writeRefer(_SVOout, offset);
+                children[i].childPointer = _outPointer;
                 children[i].referBit = true;
-                outPointer += 1;
+                _outPointer += 1;
+                _referNodes += 1;
             }
         }
     }
@@ -247,10 +384,30 @@ void OfcSVO::writeChildren(std::ofstream &SVOout, std::vector<Node> children, ui
         // test if child exists
         if (children[i].childBits > 0){
             if (children[i].childPointer > 0){
-                children[i].childOffset = offsetOfPointers(children[i].childPointer, outPointer);
+                children[i].childOffset = offsetOfPointers(children[i].childPointer, _outPointer);
             }
-            NodeWrite::writeNode(SVOout, children[i]);
-            outPointer += 1;
+            NodeWrite::writeNode(_SVOout, children[i]);
+            _outPointer += 1;
         }
     }
-}
\ No newline at end of file
+}
+
+void OfcSVO::reverseNodeFile(std::ostream &out, std::ifstream &in)
+{
+    Profiler::Scope scope("reverse");
+    const uint64_t totalNodes = in.tellg()/8;
+    std::vector<uint64_t> block(REVERSE_BLOCK_NODES);
+    uint64_t end = totalNodes;
+    while (end > 0){
+        // read a block from the end and write it in reverse node order
+        const uint64_t nodes = std::min(end, (uint64_t)REVERSE_BLOCK_NODES);
+        in.seekg((end - nodes)*8, std::ios::beg);
+        in.read((char*)block.data(), nodes*8);
+        std::reverse(block.begin(), block.begin() + nodes);
+        out.write((const char*)block.data(), nodes*8);
+        end -= nodes;
+    }
+    Profiler::add(Profiler::ALL_BYTES_WRITTEN, totalNodes*8);
+
+    std::cout << "Total nodes: " << totalNodes << "\n";
+}
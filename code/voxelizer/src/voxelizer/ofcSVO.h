@@ -5,30 +5,72 @@
 #include <vector>
 #include "structs.h"
 
+// Nodes are 64 bits: <childBits:8><referBit:1><childOffset:23><RGBA:32>.
+// With bricks enabled the tree stops BRICK_LEVELS levels early, the nodes on the last level
+// point to a brick: a 64 bit occupancy mask for 4x4x4 voxels (bit n is the voxel with
+// local morton code n) followed by the colors of the occupied voxels, 2 per 64 bits.
+#define BRICK_LEVELS 2
+#define BRICK_VOXELS 64
+#define TOTAL_CHILDOFFSET_BITS 23
+
+// The SVO is built bottom-up from voxels in morton order. Only the open queues of every level
+// are kept in memory, so the voxels can be added in consecutive morton ranges, e.g. one
+// voxelized brick of the model at a time.
 class OfcSVO
 {
 public:
-    static void create(std::ofstream &SVOout, std::vector<Voxel> voxels, unsigned int depth, bool optimized);
-private:
     struct MortonVoxel{
         RGBA8 voxel;
         uint64_t mortonCode;
     };
 
-    static void writeChildren(std::ofstream &SVOout, std::vector<Node> children, uint64_t& outPointer);
-    static void processFullQueues(std::ofstream &SVOout, uint64_t& outPointer, std::vector<std::vector<Node>>& depthQueues, std::vector<uint8_t>& emptypostQueues);
-    static Node processFullQueue(std::ofstream &SVOout, std::vector<Node>* children, uint64_t& outPointer);
-    static void writeRoot(std::ofstream &SVOout, uint64_t& outPointer, std::vector<std::vector<Node>>& depthQueues, std::vector<uint8_t>& emptypostQueues);
+    // showProgress prints the progress in percent, off for SVOs built as parts of a larger SVO
+    OfcSVO(std::ostream &SVOout, unsigned int depth, bool bricks = false, bool showProgress = true);
+
+    // adds the voxels in [position, endCode), the voxels must be sorted in morton order,
+    // voxels in front of the current position and duplicates are skipped,
+    // with bricks endCode must be a multiple of BRICK_VOXELS
+    void addVoxels(const std::vector<MortonVoxel>& mortonOrderedVoxels, uint64_t endCode);
+    // ends the SVO, the remaining positions are empty
+    void finish();
+
+    uint64_t position() const { return _position; }
+
+    static void create(std::ostream &SVOout, const std::vector<Voxel>& voxels, unsigned int depth, bool optimized, bool bricks = false);
+    static std::vector<MortonVoxel> reorderVoxels(const std::vector<Voxel>& voxels);
+    static uint64_t mortonEncode_magicbits(uint32_t x, uint32_t y, uint32_t z);
+    // the builder writes the nodes backwards, the file is reversed afterwards
+    static void reverseNodeFile(std::ostream &out, std::ifstream &in);
+private:
+    void addEmpty(uint64_t endCode);
+    void writeChildren(std::vector<Node> children);
+    void processFullQueues(int d);
+    Node processFullQueue(std::vector<Node>* children);
+    void writeRoot();
+    void addBrickToQueue(const std::vector<MortonVoxel>& mortonOrderedVoxels, uint64_t& mortonPos);
+    void addVoxelToQueue(const std::vector<MortonVoxel>& mortonOrderedVoxels, uint64_t& mortonPos);
+    void printProgress();
+
     static uint64_t offsetOfPointers(uint64_t pointer1, uint64_t pointer2);
-    static void addVoxelToQueue(std::vector<MortonVoxel>& mortonOrderedVoxels, uint64_t& mortonPos, uint64_t currentCode, std::vector<std::vector<Node>>& depthQueues, std::vector<uint8_t>& emptypostQueues);
     static bool allEqual(std::vector<Node> children);
-    static Node readLeaf(std::ifstream &zorderVox);
     static uint8_t createChildBits(std::vector<Node> children);
-
-    static std::vector<MortonVoxel> reorderVoxels(std::vector<Voxel> voxels);
     static bool mortonCompare(MortonVoxel a, MortonVoxel b);
-    static uint64_t mortonEncode_magicbits(uint32_t x, uint32_t y, uint32_t z);
     static uint64_t splitBy3(unsigned int a);
+
+    std::ostream& _SVOout;
+    bool _bricks;
+    bool _showProgress;
+    unsigned int _treeDepth;
+    uint64_t _leafVoxels;
+    uint64_t _totalVoxels;
+
+    std::vector<std::vector<Node>> _depthQueues;
+    std::vector<uint8_t> _emptypostQueues;     // total empty elements at the end of each queue
+    uint64_t _outPointer = 1;
+    uint64_t _position = 0;                   // morton code of the next leaf
+    unsigned int _progress = 0;
+    uint64_t _addedVoxels = 0;
+    uint64_t _referNodes = 0;
 };
 
 #endif
\ No newline at end of file
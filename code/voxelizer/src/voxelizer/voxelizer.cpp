@@ -1,10 +1,14 @@
 #include "voxelizer.h"
 #include "../opengl/shader.h"
-#include "../opengl/texture.h"
+#include "../opengl/texturearray.h"
+#include "Profiler.h"
 
 #include <GL/glew.h>
 #include <iostream>
 #include <glm/gtc/type_ptr.hpp>
+#include <algorithm>
+
+#define UPLOAD_BLOCK_TRIANGLES (1 << 16)
 
 Voxelizer::Voxelizer(int width, int height, int depth, bool fill)
     : _resolution{width, height, depth}, _fill{fill}
@@ -42,32 +46,67 @@ Voxelizer::~Voxelizer()
     glDeleteTextures(1, &_colorTex);
 }
 
-void Voxelizer::createVAO(std::vector<Vertex> vertices)
+void Voxelizer::createVAO(const MeshView& mesh, TextureArray* textures)
 {
+    // the model is rendered once for every brick, upload it only once
+    const uint64_t texturesGeneration = textures? textures->generation() : 0;
+    if (_vao != 0 && _vaoStore == mesh.store->generation && _vaoFirst == mesh.firstTriangle &&
+        _vaoTriangles == mesh.totalTriangles && _vaoTextures == texturesGeneration){
+        return;
+    }
+    _vaoStore = mesh.store->generation;
+    _vaoFirst = mesh.firstTriangle;
+    _vaoTriangles = mesh.totalTriangles;
+    _vaoTextures = texturesGeneration;
+
     const size_t VertexSize = sizeof(Vertex);
-    const size_t BufferSize = vertices.size() * VertexSize;
-    const size_t RgbOffset = sizeof(vertices[0].XYZ);
-    const size_t TexCoordOffset = RgbOffset + sizeof(vertices[0].RGBA);
-    const size_t normalOffset = TexCoordOffset + sizeof(vertices[0].Texcoord);
+    const size_t BufferSize = 3 * mesh.totalTriangles * VertexSize;
+    const size_t RgbOffset = sizeof(Vertex::XYZ);
+    const size_t TexCoordOffset = RgbOffset + sizeof(Vertex::RGBA);
+    const size_t normalOffset = TexCoordOffset + sizeof(Vertex::Texcoord);
+    const size_t layerOffset = normalOffset + sizeof(Vertex::normal);
+
+    // delete the array of the previous render
+    if (_vao != 0){
+        glDeleteBuffers(1, &_vbo);
+        glDeleteVertexArrays(1, &_vao);
+    }
 
     // create array
     glGenVertexArrays(1, &_vao);
     glBindVertexArray(_vao);
 
-    // create buffer
+    // create buffer, the vertices are expanded from the triangle store in blocks
     glGenBuffers(1, &_vbo);
     glBindBuffer(GL_ARRAY_BUFFER, _vbo);
-    glBufferData(GL_ARRAY_BUFFER, BufferSize, vertices.data(), GL_STATIC_DRAW);
+    glBufferData(GL_ARRAY_BUFFER, BufferSize, nullptr, GL_STATIC_DRAW);
+    std::vector<Vertex> block(3*UPLOAD_BLOCK_TRIANGLES);
+    for (uint64_t first = 0; first < mesh.totalTriangles; first += UPLOAD_BLOCK_TRIANGLES){
+        const uint64_t count = std::min(mesh.totalTriangles - first, (uint64_t)UPLOAD_BLOCK_TRIANGLES);
+        mesh.vertices(first, count, block.data());
+        if (textures){
+            // the texture of the material of every triangle
+            for (uint64_t i = 0; i < count;++i){
+                const float layer = textures->materialLayers()[mesh.triangle(first + i).material];
+                block[3*i].textureLayer = layer;
+                block[3*i + 1].textureLayer = layer;
+                block[3*i + 2].textureLayer = layer;
+            }
+        }
+        glBufferSubData(GL_ARRAY_BUFFER, 3*first*VertexSize, 3*count*VertexSize, block.data());
+    }
 
     // set data pointers
     glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, VertexSize, 0);
     glVertexAttribPointer(1, 4, GL_FLOAT, GL_FALSE, VertexSize, (GLvoid *)RgbOffset);
     glVertexAttribPointer(2, 2, GL_FLOAT, GL_FALSE, VertexSize, (GLvoid *)TexCoordOffset);
     glVertexAttribPointer(3, 3, GL_FLOAT, GL_FALSE, VertexSize, (GLvoid *)normalOffset);
+    glVertexAttribPointer(4, 1, GL_FLOAT, GL_FALSE, VertexSize, (GLvoid *)layerOffset);
     glEnableVertexAttribArray(0);
     glEnableVertexAttribArray(1);
     glEnableVertexAttribArray(2);
     glEnableVertexAttribArray(3);
+    glEnableVertexAttribArray(4);
 
     glBindBuffer(GL_ARRAY_BUFFER, 0);
 }
@@ -100,6 +139,7 @@ void Voxelizer::createFramebuffer(int width, int height)
 
 void Voxelizer::createVoxTexture(int width, int height, int depth)
 {
+    _imageMemory.resize((uint64_t)width*height*depth*sizeof(RGBA8));
     _image.resize(width * height * depth, {0, 0, 0, 0});
 
     glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
@@ -112,6 +152,7 @@ void Voxelizer::createVoxTexture(int width, int height, int depth)
 
 void Voxelizer::createNormalTexture(int width, int height, int depth)
 {
+    _normalImageMemory.resize((uint64_t)width*height*depth*sizeof(XYZW32F));
     _normalImage.resize(width * height * depth, {0, 0, 0, 0});
 
     glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
@@ -122,14 +163,14 @@ void Voxelizer::createNormalTexture(int width, int height, int depth)
     glTexSubImage3D(GL_TEXTURE_3D, 0, 0, 0, 0, width, height, depth, GL_RGBA, GL_FLOAT, _normalImage.data());
 }
 
-void Voxelizer::fillImage(glm::mat4 modelMat,std::vector<Vertex> vertices, Texture* tex)
+void Voxelizer::fillImage(glm::mat4 modelMat,const MeshView& mesh, TextureArray* textures)
 {
     // clear image
     glClearTexSubImage(_voxtex, 0, 0, 0, 0, _resolution[0], _resolution[1], _resolution[2], GL_RGBA, GL_UNSIGNED_BYTE, 0);
     glClearTexSubImage(_normalTex, 0, 0, 0, 0, _resolution[0], _resolution[1], _resolution[2], GL_RGBA, GL_FLOAT, 0);
 
     // create vertex array object
-    createVAO(vertices);
+    createVAO(mesh, textures);
 
     glBindFramebuffer(GL_FRAMEBUFFER, _framebuffer);
     glDisable(GL_CULL_FACE);
@@ -147,14 +188,11 @@ void Voxelizer::fillImage(glm::mat4 modelMat,std::vector<Vertex> vertices, Textu
     // bind model matrix
     glUniformMatrix4fv(glGetUniformLocation(_shader->program(), "uModel"), 1, false, glm::value_ptr(modelMat));
 
-    // bind texture
-    if (tex){
-        tex->bind(1);
-        glUniform1i(glGetUniformLocation(_shader->program(), "uTex"), 1);
-        glUniform1i(glGetUniformLocation(_shader->program(), "uHasTex"), 1);
-    } else{
-        glUniform1i(glGetUniformLocation(_shader->program(), "uHasTex"), 0);
+    // bind the textures of all materials
+    if (textures){
+        textures->bind(1);
     }
+    glUniform1i(glGetUniformLocation(_shader->program(), "uTextures"), 1);
 
     // bind vertex array
     glBindVertexArray(_vao);
@@ -174,47 +212,54 @@ void Voxelizer::fillImage(glm::mat4 modelMat,std::vector<Vertex> vertices, Textu
     glUniform1i(glGetUniformLocation(_shader->program(), "outNormals"), 1);
 
     std::cout << " Filling texture..." << std::endl;
-
-    glUniform1i(glGetUniformLocation(_shader->program(), "uSwizzle"), 0);
-    glDrawArrays(GL_TRIANGLES, 0, vertices.size());
-    glMemoryBarrier(GL_SHADER_IMAGE_ACCESS_BARRIER_BIT);
-    glUniform1i(glGetUniformLocation(_shader->program(), "uSwizzle"), 1);
-    glDrawArrays(GL_TRIANGLES, 0, vertices.size());
-    glMemoryBarrier(GL_SHADER_IMAGE_ACCESS_BARRIER_BIT);
-    glUniform1i(glGetUniformLocation(_shader->program(), "uSwizzle"), 2);
-    glDrawArrays(GL_TRIANGLES, 0, vertices.size());
-    glMemoryBarrier(GL_SHADER_IMAGE_ACCESS_BARRIER_BIT);
-    glUniform1i(glGetUniformLocation(_shader->program(), "uSwizzle"), 3);
-    glDrawArrays(GL_TRIANGLES, 0, vertices.size());
-
-
-    // wait for drawing to be complete
-    glMemoryBarrier(GL_ALL_BARRIER_BITS);
+    {
+        // the draws are asynchronous, the profiler waits for them to time the stage
+        Profiler::Scope scope("raster");
+        glUniform1i(glGetUniformLocation(_shader->program(), "uSwizzle"), 0);
+        glDrawArrays(GL_TRIANGLES, 0, 3*mesh.totalTriangles);
+        glMemoryBarrier(GL_SHADER_IMAGE_ACCESS_BARRIER_BIT);
+        glUniform1i(glGetUniformLocation(_shader->program(), "uSwizzle"), 1);
+        glDrawArrays(GL_TRIANGLES, 0, 3*mesh.totalTriangles);
+        glMemoryBarrier(GL_SHADER_IMAGE_ACCESS_BARRIER_BIT);
+        glUniform1i(glGetUniformLocation(_shader->program(), "uSwizzle"), 2);
+        glDrawArrays(GL_TRIANGLES, 0, 3*mesh.totalTriangles);
+        glMemoryBarrier(GL_SHADER_IMAGE_ACCESS_BARRIER_BIT);
+        glUniform1i(glGetUniformLocation(_shader->program(), "uSwizzle"), 3);
+        glDrawArrays(GL_TRIANGLES, 0, 3*mesh.totalTriangles);
+
+        // wait for drawing to be complete
+        glMemoryBarrier(GL_ALL_BARRIER_BITS);
+        if (Profiler::enabled()) glFinish();
+    }
 
     std::cout << " Texture fill complete\n";
 
     // fill image width texture data
     std::cout << " Transferring texture data to memory...\n";
-    glPixelStorei(GL_PACK_ALIGNMENT, 1);
-    glActiveTexture(GL_TEXTURE0);
-    glBindTexture(GL_TEXTURE_3D, _voxtex);
-    glGetTexImage(GL_TEXTURE_3D, 0, GL_RGBA, GL_UNSIGNED_BYTE, _image.data());
-    if (_fill){
-        glBindTexture(GL_TEXTURE_3D, _normalTex);
-        glGetTexImage(GL_TEXTURE_3D, 0, GL_RGBA, GL_FLOAT, _normalImage.data());
-    }
+    {
+        Profiler::Scope scope("readback");
+        glPixelStorei(GL_PACK_ALIGNMENT, 1);
+        glActiveTexture(GL_TEXTURE0);
+        glBindTexture(GL_TEXTURE_3D, _voxtex);
+        glGetTexImage(GL_TEXTURE_3D, 0, GL_RGBA, GL_UNSIGNED_BYTE, _image.data());
+        if (_fill){
+            glBindTexture(GL_TEXTURE_3D, _normalTex);
+            glGetTexImage(GL_TEXTURE_3D, 0, GL_RGBA, GL_FLOAT, _normalImage.data());
+        }
 
-    // wait for get tex image to be completed
-    glMemoryBarrier(GL_ALL_BARRIER_BITS);
+        // wait for get tex image to be completed
+        glMemoryBarrier(GL_ALL_BARRIER_BITS);
+    }
 
     std::cout << " Transfer complete\n";
 }
 
-std::vector<Voxel> Voxelizer::voxelize(glm::mat4 modelMat, std::vector<Vertex> vertices, Texture* tex)
+std::vector<Voxel> Voxelizer::voxelize(glm::mat4 modelMat, const MeshView& mesh, TextureArray* textures)
 {
-    fillImage(modelMat, vertices , tex);
+    fillImage(modelMat, mesh, textures);
 
     std::cout << " Filling array with voxels from 3D texture...\n";
+    Profiler::Scope scope("scan");
 
     std::vector<Voxel> output;
 
@@ -296,11 +341,12 @@ Voxelizer::XYZW32F Voxelizer::getNormalImageElement(unsigned int x, unsigned int
     return _normalImage[imageIndex(x,y,z)];
 }
 
-void Voxelizer::voxelizeSave(std::ofstream &out, glm::mat4 modelMat,std::vector<Vertex> vertices, Texture* tex)
+void Voxelizer::voxelizeSave(std::ofstream &out, glm::mat4 modelMat,const MeshView& mesh, TextureArray* textures)
 {
-    fillImage(modelMat, vertices , tex);
+    fillImage(modelMat, mesh, textures);
 
     std::cout << " Saving voxels to file in z-order\n";
+    Profiler::Scope scope("save voxels");
 
     for (uint64_t pos = 0; pos < _resolution[0]*_resolution[1]*_resolution[2];++pos){
         // get the voxel in z-order
@@ -328,9 +374,9 @@ void Voxelizer::voxelizeSave(std::ofstream &out, glm::mat4 modelMat,std::vector<
     std::cout << " Voxels saved filled\n";
 }
 
-std::vector<RGBA8> Voxelizer::voxelizeMap(glm::mat4 modelMat,std::vector<Vertex> vertices, Texture* tex)
+std::vector<RGBA8> Voxelizer::voxelizeMap(glm::mat4 modelMat,const MeshView& mesh, TextureArray* textures)
 {
-    fillImage(modelMat, vertices , tex);
+    fillImage(modelMat, mesh, textures);
 
     return _image;
 }
\ No newline at end of file
@@ -4,23 +4,25 @@
 #include <vector>
 #include <stdint.h>
 #include "../opengl/vertex.h"
+#include "../opengl/trianglestore.h"
 
 #include "structs.h"
+#include "MemoryTracker.h"
 #include <glm/mat4x4.hpp>
 #include <fstream>
 
 
 class Shader;
-class Texture;
+class TextureArray;
 
 class Voxelizer{
 public:
     Voxelizer(int width, int height, int depth, bool fill);
     ~Voxelizer();
 
-    std::vector<Voxel> voxelize(glm::mat4 modelMat,std::vector<Vertex> vertices, Texture* tex = nullptr);
-    void voxelizeSave(std::ofstream &out, glm::mat4 modelMat,std::vector<Vertex> vertices, Texture* tex = nullptr);
-    std::vector<RGBA8> voxelizeMap(glm::mat4 modelMat,std::vector<Vertex> vertices, Texture* tex);
+    std::vector<Voxel> voxelize(glm::mat4 modelMat,const MeshView& mesh, TextureArray* textures = nullptr);
+    void voxelizeSave(std::ofstream &out, glm::mat4 modelMat,const MeshView& mesh, TextureArray* textures = nullptr);
+    std::vector<RGBA8> voxelizeMap(glm::mat4 modelMat,const MeshView& mesh, TextureArray* textures);
 private:
     struct XYZW32F{
         float X = 0;
@@ -32,9 +34,9 @@ private:
     void createFramebuffer(int width, int height);
     void createVoxTexture(int width, int height, int depth);
     void createNormalTexture(int width, int height, int depth);
-    void createVAO(std::vector<Vertex> vertices);
+    void createVAO(const MeshView& mesh, TextureArray* textures);
 
-    void fillImage(glm::mat4 modelMat,std::vector<Vertex> vertices, Texture* tex = nullptr);
+    void fillImage(glm::mat4 modelMat,const MeshView& mesh, TextureArray* textures = nullptr);
 
     unsigned int imageIndex(unsigned int x, unsigned int y, unsigned int z);
     RGBA8 getImageElement(unsigned int x, unsigned int y, unsigned int z);
@@ -43,11 +45,15 @@ private:
     Shader* _shader;
 
     std::vector<RGBA8> _image;
+    MemoryTracker::Block _imageMemory{MemoryTracker::VOXELIZER};
     unsigned int _voxtex = 0;
 
-    unsigned int _vbo,_vao;
+    unsigned int _vbo = 0,_vao = 0;
+    // mesh in the vertex buffer, the store and the textures by generation
+    uint64_t _vaoStore = 0, _vaoFirst = 0, _vaoTriangles = 0, _vaoTextures = 0;
 
     std::vector<XYZW32F> _normalImage;
+    MemoryTracker::Block _normalImageMemory{MemoryTracker::VOXELIZER};
     unsigned int _normalTex = 0;
 
     unsigned int _framebuffer = 0;